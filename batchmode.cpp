@@ -0,0 +1,316 @@
+#include "batchmode.h"
+#include "compressedstream.h"
+#include "profiler.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+QString translate(const char *text) {
+    return QCoreApplication::translate("batch", text);
+}
+
+QString edit(const QString &text, const BatchMode::Job &job, qint64 &replacements) { // every replacement works on the result of the one before
+    QString current = text;
+    for (const BatchMode::Replacement &replacement : job.replacements) {
+        const QVector<SearchMatch> matches = replacement.engine.findAll(current, 0, current.size());
+        if (matches.isEmpty()) {
+            continue;
+        }
+        QString replaced;
+        replaced.reserve(current.size());
+        qsizetype position = 0;
+        for (const SearchMatch &match : matches) {
+            replaced += QStringView(current).sliced(position, match.position - position);
+            replaced += replacement.engine.replacement(current, match, replacement.replaceWith);
+            position = match.end();
+        }
+        replaced += QStringView(current).sliced(position);
+        replacements += matches.size();
+        current = replaced;
+    }
+    return current;
+}
+
+bool parseEncoding(const QString &name, BatchMode::Job &job) { // the same choices as the encoding menu, utf-16 always with a byte order mark
+    const QString key = name.toLower().remove(QLatin1Char('-')).remove(QLatin1Char(' '));
+    job.setEncoding = true;
+    job.bom = false;
+    if (key == QLatin1String("utf8")) {
+        job.encoding = TextCodec::Encoding::Utf8;
+    } else if (key == QLatin1String("utf8bom")) {
+        job.encoding = TextCodec::Encoding::Utf8;
+        job.bom = true;
+    } else if (key == QLatin1String("utf16le")) {
+        job.encoding = TextCodec::Encoding::Utf16LE;
+        job.bom = true;
+    } else if (key == QLatin1String("utf16be")) {
+        job.encoding = TextCodec::Encoding::Utf16BE;
+        job.bom = true;
+    } else if (key == QLatin1String("latin1")) {
+        job.encoding = TextCodec::Encoding::Latin1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool BatchMode::isRequested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int BatchMode::run(int argc, char *argv[]) { // a core application only, the gui is never set up, so no display is needed
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(translate("Bearbeitet Dateien ohne Fenster. Beispiel: --batch --find alt --replace neu --line-endings lf src/"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("paths"), translate("Dateien und Ordner, Ordner werden mit allen Dateien darunter bearbeitet, außer versteckten und .git, .svn, .hg. Binärdateien werden übersprungen."), QStringLiteral("paths..."));
+    QCommandLineOption batchOption(QStringLiteral("batch"), translate("Bearbeitet die Dateien ohne Fenster."));
+    QCommandLineOption findOption(QStringLiteral("find"), translate("Gesuchter Text, kann mehrfach angegeben werden, ohne --replace werden die Treffer entfernt."), QStringLiteral("text"));
+    QCommandLineOption replaceOption(QStringLiteral("replace"), translate("Ersatz für das --find an derselben Stelle, \\0 bis \\9 setzen Gruppen eines regulären Ausdrucks ein."), QStringLiteral("text"));
+    QCommandLineOption regexOption(QStringLiteral("regex"), translate("Die gesuchten Texte sind reguläre Ausdrücke."));
+    QCommandLineOption caseOption(QStringLiteral("case-sensitive"), translate("Groß- und Kleinschreibung beachten."));
+    QCommandLineOption lineEndingOption(QStringLiteral("line-endings"), translate("Zeilenende der geschriebenen Dateien: lf oder crlf."), QStringLiteral("lf|crlf"));
+    QCommandLineOption encodingOption(QStringLiteral("encoding"), translate("Kodierung der geschriebenen Dateien: utf-8, utf-8-bom, utf-16le, utf-16be oder latin-1."), QStringLiteral("name"));
+    QCommandLineOption jobsOption(QStringLiteral("jobs"), translate("Dateien, die gleichzeitig bearbeitet werden."), QStringLiteral("count"), QString::number(QThread::idealThreadCount()));
+    QCommandLineOption dryRunOption(QStringLiteral("dry-run"), translate("Nur zählen, die Dateien bleiben unverändert."));
+    parser.addOptions({batchOption, findOption, replaceOption, regexOption, caseOption, lineEndingOption, encodingOption, jobsOption, dryRunOption});
+    parser.process(application);
+
+    Job job;
+    job.dryRun = parser.isSet(dryRunOption);
+    const QStringList finds = parser.values(findOption);
+    const QStringList replaces = parser.values(replaceOption);
+    if (replaces.size() > finds.size()) {
+        std::fprintf(stderr, "%s\n", qPrintable(translate("Jedes --replace braucht ein --find davor")));
+        return 1;
+    }
+    for (qsizetype i = 0; i < finds.size(); ++i) {
+        SearchOptions options;
+        options.pattern = finds.at(i);
+        options.regex = parser.isSet(regexOption);
+        options.caseSensitive = parser.isSet(caseOption);
+        SearchEngine engine(options);
+        if (!engine.isValid()) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(translate("Ungültiger Suchtext")), qPrintable(engine.errorString()));
+            return 1;
+        }
+        job.replacements.push_back({engine, i < replaces.size() ? replaces.at(i) : QString()}); // without a replacement the matches are removed
+    }
+    if (parser.isSet(lineEndingOption)) {
+        const QString lineEnding = parser.value(lineEndingOption).toLower();
+        if (lineEnding != QLatin1String("lf") && lineEnding != QLatin1String("crlf")) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(translate("Unbekanntes Zeilenende")), qPrintable(lineEnding));
+            return 1;
+        }
+        job.setLineEnding = true;
+        job.lineEnding = lineEnding == QLatin1String("crlf") ? TextCodec::LineEnding::CrLf : TextCodec::LineEnding::Lf;
+    }
+    if (parser.isSet(encodingOption) && !parseEncoding(parser.value(encodingOption), job)) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(translate("Unbekannte Kodierung")), qPrintable(parser.value(encodingOption)));
+        return 1;
+    }
+    if (job.replacements.empty() && !job.setLineEnding && !job.setEncoding) {
+        std::fprintf(stderr, "%s\n", qPrintable(translate("Nichts zu tun, --find, --line-endings oder --encoding fehlt")));
+        return 1;
+    }
+
+    QStringList files = collect(parser.positionalArguments());
+    if (files.isEmpty()) {
+        std::fprintf(stderr, "%s\n", qPrintable(translate("Keine Dateien angegeben")));
+        return 1;
+    }
+    QVector<qint64> sizes(files.size());
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        sizes[i] = QFileInfo(files.at(i)).size();
+    }
+    QVector<qsizetype> order(files.size()); // biggest first, so no big file starts last and keeps one thread busy alone at the end
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](qsizetype a, qsizetype b) {
+        return sizes.at(a) > sizes.at(b);
+    });
+
+    QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+    QMutex outputMutex;
+    QElapsedTimer timer;
+    timer.start();
+    const QList<Result> results = QtConcurrent::blockingMapped<QList<Result>>(order, [&files, &job, &outputMutex](qsizetype index) { // idle threads take the next file, a thread with a big one is never waited for
+        Result result = process(files.at(index), job);
+        QMutexLocker locker(&outputMutex); // one line per file as soon as it is done, the lines of two threads never mix
+        if (result.skipped) {
+            std::printf("%s: %s\n", qPrintable(QDir::toNativeSeparators(result.fileName)), qPrintable(translate("übersprungen, keine Textdatei")));
+        } else if (result.error.isEmpty()) {
+            std::printf("%s: %lld %s, %s, %.1f ms\n", qPrintable(QDir::toNativeSeparators(result.fileName)), static_cast<long long>(result.replacements), qPrintable(translate("Ersetzungen")), qPrintable(result.changed ? (job.dryRun ? translate("würde geändert") : translate("geändert")) : translate("unverändert")), result.elapsed / 1e6);
+        } else {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(QDir::toNativeSeparators(result.fileName)), qPrintable(result.error));
+        }
+        std::fflush(stdout);
+        return result;
+    });
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    qint64 bytes = 0;
+    qint64 replacements = 0;
+    int changed = 0;
+    int skipped = 0;
+    int failed = 0;
+    for (const Result &result : results) {
+        bytes += result.bytesRead;
+        replacements += result.replacements;
+        changed += result.changed ? 1 : 0;
+        skipped += result.skipped ? 1 : 0;
+        failed += result.error.isEmpty() ? 0 : 1;
+    }
+    const double seconds = qMax<qint64>(elapsed, 1) / 1e9;
+    std::printf("%s\n", qPrintable(translate("%1 Dateien, %2 geändert, %3 übersprungen, %4 Fehler, %5 Ersetzungen, %6 MB in %7 s (%8 MB/s)").arg(results.size()).arg(changed).arg(skipped).arg(failed).arg(replacements).arg(bytes / 1e6, 0, 'f', 1).arg(seconds, 0, 'f', 2).arg(bytes / 1e6 / seconds, 0, 'f', 1)));
+    return failed > 0 ? 1 : 0;
+}
+
+QStringList BatchMode::collect(const QStringList &paths) {
+    static const QStringList versionControl = {QStringLiteral(".git"), QStringLiteral(".svn"), QStringLiteral(".hg")}; // not hidden on windows, skipped by name as well
+    QStringList files;
+    for (const QString &path : paths) {
+        if (!QFileInfo(path).isDir()) {
+            files.append(path); // missing files are reported by process like any other error
+            continue;
+        }
+        QStringList directories = {path};
+        while (!directories.isEmpty()) {
+            const QFileInfoList entries = QDir(directories.takeLast()).entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks, QDir::Name); // hidden ones are left out, links could lead in circles
+            for (const QFileInfo &info : entries) {
+                if (!info.isDir()) {
+                    files.append(info.filePath());
+                } else if (!versionControl.contains(info.fileName())) {
+                    directories.append(info.filePath());
+                }
+            }
+        }
+    }
+    files.removeDuplicates();
+    return files;
+}
+
+BatchMode::Result BatchMode::process(const QString &fileName, const Job &job) { // read, edited and written chunk by chunk, at most a few mb of the file are in memory
+    ScopedTimer profile("batchFile");
+    QElapsedTimer timer;
+    timer.start();
+    Result result;
+    result.fileName = fileName;
+    QFile file(fileName);
+    QSaveFile output(fileName); // the file is only replaced once everything was written
+    try {
+        if (!file.open(QIODevice::ReadOnly)) {
+            throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+        }
+        const Compression::Format compression = Compression::detect(file); // a compressed file is written compressed again
+        CompressedReader reader(&file, compression);
+        std::unique_ptr<CompressedWriter> writer;
+        if (!job.dryRun) {
+            if (!output.open(QIODevice::WriteOnly)) {
+                throw std::runtime_error("Kann nicht speichern: " + output.errorString().toStdString());
+            }
+            writer = std::make_unique<CompressedWriter>(&output, compression);
+        }
+        std::unique_ptr<TextDecoder> decoder;
+        std::unique_ptr<TextEncoder> encoder;
+        TextCodec::Format target;
+        auto write = [&](const QString &text) {
+            const TextCodec::Format source = decoder->format();
+            if (!encoder || (!job.setEncoding && source.encoding != target.encoding)) { // ascii up to here may still turn out to be latin-1, both encode ascii alike, so the encoder can be replaced
+                if (!encoder) { // the line ending is fixed by the first chunk, like in the loader
+                    target.lineEnding = job.setLineEnding ? job.lineEnding : source.lineEnding;
+                }
+                target.encoding = job.setEncoding ? job.encoding : source.encoding;
+                target.bom = job.setEncoding ? job.bom : source.bom;
+                encoder = std::make_unique<TextEncoder>(target);
+            }
+            const QByteArray bytes = encoder->encode(edit(text, job, result.replacements));
+            if (encoder->hasError()) { // only latin-1 lacks characters, the file stays as it was rather than losing them
+                throw std::runtime_error("Kann nicht speichern: der Text enthält Zeichen, die es in Latin-1 nicht gibt");
+            }
+            result.bytesWritten += bytes.size();
+            if (writer) {
+                writer->write(bytes);
+            }
+        };
+
+        QString pending; // the start of a line whose end wasn't read yet, matches never cross the end of a chunk
+        while (!reader.atEnd()) {
+            const QByteArray bytes = reader.read(chunkSize);
+            result.bytesRead += bytes.size();
+            if (!decoder) {
+                const TextCodec::Format format = TextCodec::detect(bytes.constData(), bytes.size());
+                const bool utf16 = format.encoding == TextCodec::Encoding::Utf16LE || format.encoding == TextCodec::Encoding::Utf16BE;
+                if (!utf16 && std::memchr(bytes.constData(), 0, size_t(qMin<qsizetype>(bytes.size(), binaryProbe)))) { // images, archives, .git/index and the like are never rewritten
+                    output.cancelWriting();
+                    result.skipped = true;
+                    result.elapsed = timer.nsecsElapsed();
+                    return result;
+                }
+                decoder = std::make_unique<TextDecoder>(bytes);
+            }
+            pending += decoder->decode(bytes);
+            qsizetype cut = pending.lastIndexOf(QLatin1Char('\n')) + 1;
+            if (cut == 0 && pending.size() >= maxPending) { // a line this long is cut, a match across the cut is missed
+                cut = pending.size();
+            }
+            if (cut > 0) {
+                write(pending.left(cut));
+                pending.remove(0, cut);
+            }
+        }
+        if (decoder) {
+            write(pending + decoder->finish());
+            const QByteArray rest = encoder->finish();
+            result.bytesWritten += rest.size();
+            if (writer) {
+                writer->write(rest);
+            }
+            const TextCodec::Format source = decoder->format(); // final only now, the encoding may settle late and lines of the other ending may come anywhere
+            const bool otherLineEnds = target.lineEnding == TextCodec::LineEnding::Lf ? decoder->crLfCount() > 0 : decoder->crLfCount() < decoder->lineFeedCount();
+            result.changed = source.encoding != target.encoding || source.bom != target.bom || otherLineEnds;
+        }
+        result.changed = result.changed || result.replacements > 0;
+        if (result.changed && decoder->hasError()) { // the invalid bytes were decoded as U+FFFD, the file stays as it was rather than losing them
+            throw std::runtime_error("Kann nicht speichern: die Datei enthält Bytes, die in ihrer Kodierung ungültig sind");
+        }
+        if (writer) {
+            writer->finish();
+            writer.reset();
+            file.close(); // windows can't replace a file that is still open
+            if (!result.changed) {
+                output.cancelWriting(); // the file keeps its time stamp
+            } else if (!output.commit()) {
+                throw std::runtime_error("Kann nicht speichern: " + output.errorString().toStdString());
+            }
+        }
+    } catch (const std::exception &e) {
+        output.cancelWriting(); // the file stays untouched, the temporary file is removed
+        result.error = QString::fromUtf8(e.what());
+    }
+    result.elapsed = timer.nsecsElapsed();
+    return result;
+}
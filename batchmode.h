@@ -0,0 +1,52 @@
+#ifndef BATCHMODE_H
+#define BATCHMODE_H
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include "searchengine.h"
+#include "textcodec.h"
+
+// edits many files from the command line without any widget: find/replace, line ends and encoding with the same search
+// engine, decoder and encoder as the editor, every file is streamed in chunks of whole lines and the files are spread
+// over the thread pool
+namespace BatchMode {
+
+constexpr qint64 chunkSize = 1024 * 1024; // decompressed bytes read per step
+constexpr qsizetype maxPending = 16 * 1024 * 1024; // characters of one line held back at most, longer lines are cut
+constexpr qsizetype binaryProbe = 8192; // a zero byte in the first bytes marks a binary file, like in the folder index
+
+struct Replacement {
+    SearchEngine engine;
+    QString replaceWith;
+};
+
+struct Job {
+    std::vector<Replacement> replacements; // applied one after the other to every chunk
+    bool setEncoding = false;
+    TextCodec::Encoding encoding = TextCodec::Encoding::Utf8;
+    bool bom = false;
+    bool setLineEnding = false;
+    TextCodec::LineEnding lineEnding = TextCodec::defaultLineEnding;
+    bool dryRun = false; // everything is done but the files stay as they are
+};
+
+struct Result {
+    QString fileName;
+    qint64 bytesRead = 0; // decompressed
+    qint64 bytesWritten = 0; // before compression
+    qint64 replacements = 0;
+    bool changed = false;
+    bool skipped = false; // binary, left as it is
+    qint64 elapsed = 0; // nanoseconds
+    QString error;
+};
+
+bool isRequested(int argc, char *argv[]); // --batch is looked for before any application object exists
+int run(int argc, char *argv[]); // parses the options, edits the files and prints a line per file and the totals
+QStringList collect(const QStringList &paths); // files as they are, directories with all files below them except hidden ones and version control data
+Result process(const QString &fileName, const Job &job);
+
+}
+
+#endif // BATCHMODE_H
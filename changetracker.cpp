@@ -0,0 +1,84 @@
+#include "changetracker.h"
+#include <QTextCursor>
+
+ChangeTracker::ChangeTracker(QTextDocument *document, QObject *parent): QObject(parent), document(document), mirror(document->toPlainText()), revisionCount(0) { // constructor
+    connect(document, &QTextDocument::contentsChange, this, &ChangeTracker::contentsChanged); // every change of the document runs through contentsChanged
+}
+
+const PieceTable &ChangeTracker::table() const { // plain text of the document, kept up to date edit by edit, copy it for a snapshot
+    return mirror;
+}
+
+QString ChangeTracker::text() const { // the mirror as one string, only built once between two edits
+    if (flatText.size() != mirror.size()) {
+        flatText = mirror.toString();
+    }
+    return flatText;
+}
+
+qsizetype ChangeTracker::size() const {
+    return mirror.size();
+}
+
+qint64 ChangeTracker::revision() const { // counts the edits, used to find out if the document changed in the meantime
+    return revisionCount;
+}
+
+void ChangeTracker::contentsChanged(int position, int charsRemoved, int charsAdded) {
+    Q_UNUSED(charsAdded) // the added count is derived from the length difference, qt sometimes reports it off by one
+    const int oldLength = int(mirror.size());
+    const int newLength = document->characterCount() - 1; // characterCount includes the final paragraph separator
+
+    position = qBound(0, position, oldLength);
+    int removedLength = qMin(charsRemoved, oldLength - position); // qt may report the final paragraph separator as removed
+    int addedLength = removedLength + newLength - oldLength;
+    if (addedLength < 0 || position + addedLength > newLength) { // reported range doesn't fit, fall back to everything behind position
+        position = qMin(position, newLength);
+        removedLength = oldLength - position;
+        addedLength = newLength - position;
+    }
+
+    QString removed = mirror.mid(position, removedLength); // the mirror still holds the text from before the change
+    QString inserted = insertedText(position, addedLength);
+
+    const int common = qMin(removed.length(), inserted.length());
+    int prefix = 0;
+    while (prefix < common && removed.at(prefix) == inserted.at(prefix)) { // strips what didn't really change at the front
+        ++prefix;
+    }
+    if (prefix == removed.length() && prefix == inserted.length()) { // only the formatting changed, the text is the same
+        return;
+    }
+    int suffix = 0;
+    while (suffix < common - prefix && removed.at(removed.length() - 1 - suffix) == inserted.at(inserted.length() - 1 - suffix)) { // same at the back
+        ++suffix;
+    }
+    if (prefix > 0 || suffix > 0) {
+        removed = removed.mid(prefix, removed.length() - prefix - suffix);
+        inserted = inserted.mid(prefix, inserted.length() - prefix - suffix);
+        position += prefix;
+    }
+
+    mirror.replace(position, removed.length(), inserted); // o(log n), snapshots held by other threads stay untouched
+    flatText.clear();
+    ++revisionCount;
+    emit textEdited(position, removed, inserted);
+}
+
+QString ChangeTracker::insertedText(int position, int length) const { // reads only the changed range out of the document
+    if (length <= 0) {
+        return QString();
+    }
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+    toPlainText(text);
+    return text;
+}
+
+void ChangeTracker::toPlainText(QString &text) { // same characters as QTextDocument::toPlainText, so the mirror matches the document
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n')); // selectedText uses U+2029 for line breaks, toPlainText uses \n
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+    text.replace(QChar::Nbsp, QLatin1Char(' '));
+}
@@ -0,0 +1,38 @@
+#ifndef CHANGETRACKER_H
+#define CHANGETRACKER_H
+
+#include <QObject>
+#include <QString>
+#include <QTextDocument>
+#include "piecetable.h"
+
+// turns QTextDocument::contentsChange(pos, removed, added) into real edits (position, removed text, inserted text),
+// the plain text is kept in a piece table, so copies of it are cheap snapshots for the worker threads
+class ChangeTracker : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit ChangeTracker(QTextDocument *document, QObject *parent = nullptr);
+
+        const PieceTable &table() const;
+        QString text() const;
+        qsizetype size() const;
+        qint64 revision() const;
+        static void toPlainText(QString &text);
+
+    signals:
+        void textEdited(int position, const QString &removed, const QString &inserted);
+
+    private slots:
+        void contentsChanged(int position, int charsRemoved, int charsAdded);
+
+    private:
+        QString insertedText(int position, int length) const;
+
+        QTextDocument *document;
+        PieceTable mirror;
+        mutable QString flatText; // built by text() on demand, dropped with the next edit
+        qint64 revisionCount;
+};
+
+#endif // CHANGETRACKER_H
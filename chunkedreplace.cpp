@@ -0,0 +1,78 @@
+#include "chunkedreplace.h"
+#include "profiler.h"
+#include <QTextCursor>
+
+ChunkedReplace::ChunkedReplace(QTextDocument *document, UndoEngine *undoEngine, IdleScheduler *scheduler, QObject *parent): QObject(parent), document(document), undoEngine(undoEngine), scheduler(scheduler), position(0), removing(0), sourcePosition(0), sourceLength(0), inserted(0), total(0), running(false) { // constructor
+}
+
+void ChunkedReplace::start(qsizetype from, qsizetype length, const PieceTable &text, qsizetype textPosition, qsizetype textLength) { // text is a snapshot, the clipboard may change meanwhile
+    stop();
+    source = text;
+    position = from;
+    removing = length;
+    sourcePosition = textPosition;
+    sourceLength = textLength;
+    inserted = 0;
+    total = length + textLength;
+    running = true;
+    undoEngine->breakGroup();
+    undoEngine->beginTransaction(); // ends in stop, the user can't type in between
+    scheduler->schedule(QStringLiteral("chunkedReplace"), IdleScheduler::Urgent, [this](const IdleScheduler::Budget &budget) {
+        return step(budget);
+    });
+}
+
+void ChunkedReplace::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    scheduler->cancel(QStringLiteral("chunkedReplace"));
+    source.clear();
+    undoEngine->endTransaction();
+}
+
+bool ChunkedReplace::isRunning() const {
+    return running;
+}
+
+void ChunkedReplace::replace(qsizetype from, qsizetype to, const QString &text) {
+    QTextCursor cursor(document);
+    cursor.setPosition(int(from));
+    cursor.setPosition(int(to), QTextCursor::KeepAnchor);
+    if (text.isEmpty()) {
+        cursor.removeSelectedText();
+    } else {
+        cursor.insertText(text);
+    }
+}
+
+bool ChunkedReplace::step(const IdleScheduler::Budget &budget) { // returns true once everything is done
+    ScopedTimer timer("chunkedReplace");
+    while (!budget.expired()) {
+        if (removing > 0) {
+            qsizetype length = qMin(removing, chunkSize);
+            qsizetype from = position + removing - length;
+            if (from > position && document->characterAt(int(from)).isLowSurrogate()) { // a surrogate pair stays in one chunk
+                --from;
+            }
+            replace(from, position + removing, QString());
+            removing = from - position;
+        } else if (inserted < sourceLength) {
+            qsizetype length = qMin(sourceLength - inserted, chunkSize);
+            QString chunk = source.mid(sourcePosition + inserted, length);
+            if (inserted + length < sourceLength && chunk.back().isHighSurrogate()) {
+                chunk += source.at(sourcePosition + inserted + length);
+            }
+            replace(position + inserted, position + inserted, chunk);
+            inserted += chunk.size();
+        } else {
+            const qsizetype end = position + inserted;
+            stop();
+            emit finished(end);
+            return true;
+        }
+    }
+    emit progress(total - removing - (sourceLength - inserted), total);
+    return false;
+}
@@ -0,0 +1,46 @@
+#ifndef CHUNKEDREPLACE_H
+#define CHUNKEDREPLACE_H
+
+#include <QObject>
+#include <QTextDocument>
+#include "piecetable.h"
+#include "undoengine.h"
+#include "idlescheduler.h"
+
+// replaces a range of the document with text from a piece table chunk by chunk in idle time, so pasting or cutting
+// hundreds of mb neither blocks the gui nor needs the whole text as one string, all chunks together are one undo step
+class ChunkedReplace : public QObject {
+    Q_OBJECT
+
+    public:
+        ChunkedReplace(QTextDocument *document, UndoEngine *undoEngine, IdleScheduler *scheduler, QObject *parent = nullptr);
+
+        static constexpr qsizetype chunkSize = 64 * 1024; // characters removed or inserted at once, each one is laid out by qt
+        static constexpr qsizetype threshold = 1024 * 1024; // smaller edits are done in one go, the callers check this
+
+        void start(qsizetype position, qsizetype length, const PieceTable &text, qsizetype textPosition, qsizetype textLength);
+        void stop(); // keeps what was done so far as the undo step
+        bool isRunning() const;
+
+    signals:
+        void progress(qint64 done, qint64 total);
+        void finished(qsizetype end); // position behind the inserted text
+
+    private:
+        bool step(const IdleScheduler::Budget &budget);
+        void replace(qsizetype from, qsizetype to, const QString &text);
+
+        QTextDocument *document;
+        UndoEngine *undoEngine;
+        IdleScheduler *scheduler;
+        PieceTable source;
+        qsizetype position;
+        qsizetype removing; // characters behind position that are still to be removed, from the back so position stays valid
+        qsizetype sourcePosition;
+        qsizetype sourceLength;
+        qsizetype inserted;
+        qint64 total; // characters to remove and insert together, for the progress
+        bool running;
+};
+
+#endif // CHUNKEDREPLACE_H
@@ -0,0 +1,306 @@
+#include "comparedialog.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+#include "profiler.h"
+#include <QVBoxLayout>
+#include <QGridLayout>
+#include <QSplitter>
+#include <QPushButton>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QFontDatabase>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QFileInfo>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QMessageBox>
+#include <QMetaObject>
+#include <QtConcurrent>
+#include <stdexcept>
+
+namespace {
+
+QString lineRange(qsizetype start, qsizetype count) { // 1-based for the list, an insertion shows the line it comes after
+    if (count == 0) {
+        return QObject::tr("nach %1").arg(start);
+    }
+    return count == 1 ? QString::number(start + 1) : QStringLiteral("%1-%2").arg(start + 1).arg(start + count);
+}
+
+}
+
+CompareDialog::CompareDialog(QWidget *parent): QDialog(parent), statusLabel(new QLabel(this)), hunkList(new QTreeWidget(this)), documentLabel(new QLabel(this)), fileLabel(new QLabel(this)), documentPane(new QPlainTextEdit(this)), filePane(new QPlainTextEdit(this)), worker(nullptr), canceledFlag(false), currentGeneration(0) { // constructor
+    setModal(false); // the editor stays usable while the dialog is open
+    resize(900, 600);
+
+    hunkList->setColumnCount(3);
+    hunkList->setHeaderLabels({tr("Dokument"), tr("Datei"), tr("Art")});
+    hunkList->setRootIsDecorated(false);
+    hunkList->setUniformRowHeights(true); // a million lines can differ in many places
+    hunkList->header()->setSectionResizeMode(QHeaderView::ResizeToContents); // measured on the visible rows only
+    const QFont fixed = QFontDatabase::systemFont(QFontDatabase::FixedFont); // the columns of both sides line up
+    for (QPlainTextEdit *pane : {documentPane, filePane}) {
+        pane->setReadOnly(true);
+        pane->setLineWrapMode(QPlainTextEdit::NoWrap);
+        pane->setFont(fixed);
+    }
+
+    auto *panes = new QWidget(this);
+    auto *paneLayout = new QGridLayout(panes);
+    paneLayout->setContentsMargins(0, 0, 0, 0);
+    auto *sides = new QSplitter(Qt::Horizontal, panes);
+    auto *left = new QWidget(sides);
+    auto *leftLayout = new QVBoxLayout(left);
+    leftLayout->setContentsMargins(0, 0, 0, 0);
+    leftLayout->addWidget(documentLabel);
+    leftLayout->addWidget(documentPane);
+    auto *right = new QWidget(sides);
+    auto *rightLayout = new QVBoxLayout(right);
+    rightLayout->setContentsMargins(0, 0, 0, 0);
+    rightLayout->addWidget(fileLabel);
+    rightLayout->addWidget(filePane);
+    paneLayout->addWidget(sides, 0, 0);
+
+    auto *splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(hunkList);
+    splitter->addWidget(panes);
+    splitter->setStretchFactor(1, 2);
+
+    auto *layout = new QVBoxLayout(this);
+    layout->addWidget(statusLabel);
+    layout->addWidget(splitter, 1);
+    QPushButton *closeButton = new QPushButton(tr("Schließen"), this);
+    layout->addWidget(closeButton, 0, Qt::AlignRight);
+
+    connect(closeButton, &QPushButton::clicked, this, &CompareDialog::hide);
+    connect(hunkList, &QTreeWidget::currentItemChanged, this, &CompareDialog::showHunk);
+    connect(hunkList, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem *item) { // the hunk is shown in the editor as well
+        if (comparison) {
+            const LineDiff::Hunk &hunk = comparison->hunks.at(item->data(0, Qt::UserRole).toLongLong());
+            emit lineActivated(qMax<qint64>(1, qMin<qint64>(hunk.oldStart + 1, comparison->document.starts.size())));
+        }
+    });
+    connect(documentPane->verticalScrollBar(), &QScrollBar::valueChanged, filePane->verticalScrollBar(), &QScrollBar::setValue); // both sides scroll together
+    connect(filePane->verticalScrollBar(), &QScrollBar::valueChanged, documentPane->verticalScrollBar(), &QScrollBar::setValue);
+}
+
+CompareDialog::~CompareDialog() {
+    stop(); // the worker must not outlive the dialog
+}
+
+void CompareDialog::compare(const PieceTable &document, const QString &documentName, const QString &fileName) { // the piece table is an o(1) snapshot, typing goes on meanwhile
+    stop(); // a running comparison is dropped
+    comparison.reset();
+    hunkList->clear();
+    documentPane->clear();
+    filePane->clear();
+    const QString otherName = QFileInfo(fileName).fileName();
+    setWindowTitle(tr("Vergleich: %1 und %2").arg(documentName, otherName));
+    documentLabel->setText(documentName);
+    fileLabel->setText(otherName);
+    statusLabel->setText(tr("Vergleiche..."));
+    canceledFlag = false;
+    const quint64 generation = ++currentGeneration;
+    worker = QThread::create([this, document, fileName, generation]() {
+        run(document, fileName, generation);
+    });
+    worker->start();
+    show();
+    raise();
+    activateWindow();
+}
+
+void CompareDialog::stop() { // drops a running comparison and waits for the worker
+    canceledFlag = true;
+    if (worker) {
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+    ++currentGeneration;
+}
+
+void CompareDialog::hideEvent(QHideEvent *event) { // both texts are dropped together with the dialog
+    QDialog::hideEvent(event);
+    stop();
+    comparison.reset();
+    hunkList->clear();
+    documentPane->clear();
+    filePane->clear();
+}
+
+void CompareDialog::run(const PieceTable &document, const QString &fileName, quint64 generation) { // runs on the worker thread
+    ScopedTimer timer("compare");
+    QElapsedTimer elapsed;
+    elapsed.start();
+    auto result = std::make_shared<Comparison>();
+    QString error;
+    try {
+        result->document = split(document.toString()); // flattened here, not on the gui thread
+        result->file = split(readText(fileName, &canceledFlag));
+        if (!canceledFlag) {
+            const QList<LineDiff::Region> regions = LineDiff::regions(result->document.hashes, result->file.hashes);
+            const QList<QList<LineDiff::Hunk>> parts = QtConcurrent::blockingMapped<QList<QList<LineDiff::Hunk>>>(regions, [&result](const LineDiff::Region &region) { // the regions between the anchors don't depend on each other
+                return LineDiff::diff(region, result->document.hashes, result->file.hashes);
+            });
+            for (const QList<LineDiff::Hunk> &part : parts) {
+                result->hunks += part;
+            }
+        }
+    } catch (const std::exception &e) {
+        error = QString::fromUtf8(e.what());
+    }
+    if (canceledFlag) {
+        return;
+    }
+    const qint64 milliseconds = elapsed.elapsed();
+    std::shared_ptr<const Comparison> finished = result;
+    QMetaObject::invokeMethod(this, [this, finished, error, milliseconds, generation]() {
+        if (generation != currentGeneration) { // a newer comparison was started in the meantime
+            return;
+        }
+        if (!error.isEmpty()) {
+            statusLabel->setText(error);
+            QMessageBox::warning(this, tr("Fehler"), error);
+            return;
+        }
+        showComparison(finished, milliseconds);
+    }, Qt::QueuedConnection);
+}
+
+QString CompareDialog::readText(const QString &fileName, const std::atomic<bool> *canceled) { // same detection and line ends as the file loader, compressed files by their content
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    std::unique_ptr<TextDecoder> decoder;
+    QString text;
+    text.reserve(file.size());
+    CompressedReader reader(&file, Compression::detect(file));
+    while (!*canceled && !reader.atEnd()) {
+        QByteArray bytes = reader.read(1024 * 1024);
+        if (!decoder) {
+            decoder = std::make_unique<TextDecoder>(bytes);
+        }
+        text += decoder->decode(bytes);
+    }
+    if (decoder) {
+        text += decoder->finish();
+    }
+    return text;
+}
+
+CompareDialog::Side CompareDialog::split(QString text) { // the lines are hashed in blocks on the thread pool, every block ends behind a line end
+    struct Block {
+        qsizetype begin;
+        qsizetype end;
+    };
+    struct Lines {
+        QVector<qsizetype> starts;
+        QVector<quint64> hashes;
+    };
+    QVector<Block> blocks;
+    for (qsizetype begin = 0; begin < text.size(); ) {
+        qsizetype newline = begin + blockSize < text.size() ? text.indexOf(QLatin1Char('\n'), begin + blockSize) : -1;
+        qsizetype end = newline < 0 ? text.size() : newline + 1;
+        blocks.append({begin, end});
+        begin = end;
+    }
+    const QStringView view(text);
+    const QList<Lines> hashed = QtConcurrent::blockingMapped<QList<Lines>>(blocks, [view](const Block &block) {
+        Lines lines;
+        for (qsizetype position = block.begin; position < block.end; ) {
+            qsizetype newline = view.indexOf(u'\n', position);
+            qsizetype end = newline < 0 || newline >= block.end ? block.end : newline;
+            lines.starts.append(position);
+            lines.hashes.append(quint64(qHash(view.mid(position, end - position))));
+            position = end + 1;
+        }
+        return lines;
+    });
+
+    Side side;
+    for (const Lines &lines : hashed) {
+        side.starts += lines.starts;
+        side.hashes += lines.hashes;
+    }
+    side.text = std::move(text);
+    return side;
+}
+
+QStringView CompareDialog::line(const Side &side, qsizetype index) { // without its line end
+    const qsizetype begin = side.starts.at(index);
+    qsizetype end = index + 1 < side.starts.size() ? side.starts.at(index + 1) - 1 : side.text.size();
+    if (index + 1 == side.starts.size() && side.text.endsWith(QLatin1Char('\n'))) {
+        --end;
+    }
+    return QStringView(side.text).mid(begin, end - begin);
+}
+
+void CompareDialog::showComparison(const std::shared_ptr<const Comparison> &result, qint64 elapsed) {
+    comparison = result;
+    hunkList->setUpdatesEnabled(false); // one repaint for all rows
+    QList<QTreeWidgetItem *> items;
+    items.reserve(result->hunks.size());
+    qsizetype removed = 0;
+    qsizetype inserted = 0;
+    for (qsizetype i = 0; i < result->hunks.size(); ++i) {
+        const LineDiff::Hunk &hunk = result->hunks.at(i);
+        removed += hunk.oldCount;
+        inserted += hunk.newCount;
+        const QString kind = hunk.oldCount == 0 ? tr("eingefügt") : hunk.newCount == 0 ? tr("entfernt") : tr("geändert");
+        auto *item = new QTreeWidgetItem(QStringList{lineRange(hunk.oldStart, hunk.oldCount), lineRange(hunk.newStart, hunk.newCount), kind});
+        item->setData(0, Qt::UserRole, qint64(i));
+        items.append(item);
+    }
+    hunkList->addTopLevelItems(items);
+    hunkList->setUpdatesEnabled(true);
+    if (items.isEmpty()) {
+        statusLabel->setText(tr("Keine Unterschiede (%1 ms)").arg(elapsed));
+        return;
+    }
+    statusLabel->setText(tr("%1 Unterschiede, %2 Zeilen entfernt, %3 Zeilen eingefügt (%4 ms)").arg(items.size()).arg(removed).arg(inserted).arg(elapsed));
+    hunkList->setCurrentItem(items.first());
+}
+
+void CompareDialog::showHunk(QTreeWidgetItem *item) {
+    if (!item || !comparison) {
+        return;
+    }
+    const LineDiff::Hunk &hunk = comparison->hunks.at(item->data(0, Qt::UserRole).toLongLong());
+    fill(documentPane, comparison->document, hunk.oldStart, hunk.oldCount, QColor(255, 0, 0, 60)); // readable on both the light and the dark palette
+    fill(filePane, comparison->file, hunk.newStart, hunk.newCount, QColor(0, 200, 0, 60));
+}
+
+void CompareDialog::fill(QPlainTextEdit *pane, const Side &side, qsizetype start, qsizetype count, const QColor &color) { // the lines of the hunk with some context, only the hunk is marked
+    const qsizetype first = qMax<qsizetype>(0, start - contextLines);
+    const qsizetype shown = qMin(count, maxShownLines);
+    const qsizetype last = qMin(side.starts.size(), start + count + contextLines);
+    auto numbered = [&side](qsizetype index) {
+        QString text = QString::number(index + 1).rightJustified(7) + QLatin1String("  ");
+        return text.append(line(side, index));
+    };
+    QStringList lines;
+    for (qsizetype i = first; i < start + shown; ++i) {
+        lines.append(numbered(i));
+    }
+    if (count > shown) {
+        lines.append(tr("... %1 weitere Zeilen").arg(count - shown));
+    }
+    for (qsizetype i = start + count; i < last; ++i) {
+        lines.append(numbered(i));
+    }
+    pane->setPlainText(lines.join(QLatin1Char('\n')));
+
+    QList<QTextEdit::ExtraSelection> selections;
+    QTextEdit::ExtraSelection selection;
+    selection.format.setBackground(color);
+    selection.format.setProperty(QTextFormat::FullWidthSelection, true); // the whole line, not only its text
+    const int marked = int(start - first);
+    for (int block = marked; block < marked + int(shown) + (count > shown ? 1 : 0); ++block) {
+        selection.cursor = QTextCursor(pane->document()->findBlockByNumber(block));
+        selections.append(selection);
+    }
+    pane->setExtraSelections(selections);
+}
@@ -0,0 +1,70 @@
+#ifndef COMPAREDIALOG_H
+#define COMPAREDIALOG_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QTreeWidget>
+#include <QThread>
+#include <QColor>
+#include <atomic>
+#include <memory>
+#include "piecetable.h"
+#include "linediff.h"
+
+// compares the document with a file line by line on a worker thread, lists the differing hunks and shows the selected one
+// side by side, the document on the left and the file on the right
+class CompareDialog : public QDialog {
+    Q_OBJECT
+
+    public:
+        explicit CompareDialog(QWidget *parent = nullptr);
+        ~CompareDialog();
+
+        static constexpr int contextLines = 3; // unchanged lines shown around a hunk
+        static constexpr qsizetype maxShownLines = 2000; // of one side of a hunk, the rest is only counted
+        static constexpr qsizetype blockSize = 1024 * 1024; // characters hashed per task on the thread pool
+
+        void compare(const PieceTable &document, const QString &documentName, const QString &fileName);
+
+    signals:
+        void lineActivated(qint64 line); // 1-based line of the document
+
+    protected:
+        void hideEvent(QHideEvent *event) override;
+
+    private:
+        struct Side {
+            QString text;
+            QVector<qsizetype> starts; // of every line
+            QVector<quint64> hashes;
+        };
+
+        struct Comparison {
+            Side document;
+            Side file;
+            QList<LineDiff::Hunk> hunks;
+        };
+
+        static Side split(QString text);
+        static QString readText(const QString &fileName, const std::atomic<bool> *canceled);
+        static QStringView line(const Side &side, qsizetype index);
+        void run(const PieceTable &document, const QString &fileName, quint64 generation);
+        void stop();
+        void showComparison(const std::shared_ptr<const Comparison> &result, qint64 elapsed);
+        void showHunk(QTreeWidgetItem *item);
+        void fill(QPlainTextEdit *pane, const Side &side, qsizetype start, qsizetype count, const QColor &color);
+
+        QLabel *statusLabel;
+        QTreeWidget *hunkList;
+        QLabel *documentLabel;
+        QLabel *fileLabel;
+        QPlainTextEdit *documentPane;
+        QPlainTextEdit *filePane;
+        std::shared_ptr<const Comparison> comparison;
+        QThread *worker;
+        std::atomic<bool> canceledFlag;
+        quint64 currentGeneration;
+};
+
+#endif // COMPAREDIALOG_H
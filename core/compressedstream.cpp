@@ -0,0 +1,310 @@
+#include "compressedstream.h"
+#include <QFile>
+#include <QFileDevice>
+#include <QFileInfo>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+#ifdef EDITOR_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+std::runtime_error broken(const std::string &detail) {
+    return std::runtime_error("Kann nicht entpacken: " + detail);
+}
+
+void checkDevice(QIODevice *device) { // an empty read is the end of a file, unless the file reports an error
+    auto *file = qobject_cast<QFileDevice *>(device);
+    if (file && file->error() != QFileDevice::NoError) {
+        throw std::runtime_error("Kann nicht einlesen: " + file->errorString().toStdString());
+    }
+}
+
+}
+
+Compression::Format Compression::fromFileName(const QString &fileName) {
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == QLatin1String("gz") || suffix == QLatin1String("gzip")) {
+        return Format::Gzip;
+    }
+    if (suffix == QLatin1String("zst") || suffix == QLatin1String("zstd")) {
+        return Format::Zstd;
+    }
+    return Format::None;
+}
+
+Compression::Format Compression::fromHeader(const QByteArray &head) {
+    if (head.size() >= 2 && uchar(head[0]) == 0x1f && uchar(head[1]) == 0x8b) {
+        return Format::Gzip;
+    }
+    if (head.size() >= 4 && uchar(head[0]) == 0x28 && uchar(head[1]) == 0xb5 && uchar(head[2]) == 0x2f && uchar(head[3]) == 0xfd) {
+        return Format::Zstd;
+    }
+    return Format::None;
+}
+
+Compression::Format Compression::detect(QIODevice &device) {
+    return fromHeader(device.peek(4));
+}
+
+Compression::Format Compression::detect(const QString &fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return fromFileName(fileName);
+    }
+    return detect(file);
+}
+
+bool Compression::isAvailable(Format format) {
+#ifdef EDITOR_HAVE_ZSTD
+    Q_UNUSED(format);
+    return true;
+#else
+    return format != Format::Zstd;
+#endif
+}
+
+QString Compression::name(Format format) {
+    switch (format) {
+        case Format::Gzip:
+            return QStringLiteral("gzip");
+        case Format::Zstd:
+            return QStringLiteral("zstd");
+        default:
+            return QString();
+    }
+}
+
+struct CompressedReader::Codec {
+    z_stream zlib = {};
+    bool zlibReady = false;
+#ifdef EDITOR_HAVE_ZSTD
+    ZSTD_DStream *zstd = nullptr;
+#endif
+    bool streamEnded = true; // false while a gzip member or a zstd frame is only partly read
+
+    ~Codec() {
+        if (zlibReady) {
+            inflateEnd(&zlib);
+        }
+#ifdef EDITOR_HAVE_ZSTD
+        ZSTD_freeDStream(zstd);
+#endif
+    }
+};
+
+CompressedReader::CompressedReader(QIODevice *source, Compression::Format format): source(source), format(format), codec(new Codec), inputPosition(0), pending(false), finished(false) { // constructor
+    if (format == Compression::Format::Gzip) {
+        if (inflateInit2(&codec->zlib, 15 + 32) != Z_OK) { // 32 accepts gzip and zlib headers
+            throw broken("zlib");
+        }
+        codec->zlibReady = true;
+    } else if (format == Compression::Format::Zstd) {
+#ifdef EDITOR_HAVE_ZSTD
+        codec->zstd = ZSTD_createDStream();
+        if (!codec->zstd) {
+            throw broken("zstd");
+        }
+#else
+        throw broken("zstd wird nicht unterstützt");
+#endif
+    }
+}
+
+CompressedReader::~CompressedReader() = default;
+
+bool CompressedReader::atEnd() const {
+    return finished || (format == Compression::Format::None && source->atEnd());
+}
+
+bool CompressedReader::refill() { // false at the end of the device
+    input = source->read(Compression::inputSize);
+    inputPosition = 0;
+    if (!input.isEmpty()) {
+        return true;
+    }
+    checkDevice(source);
+    if (!codec->streamEnded) {
+        throw broken("die Datei ist unvollständig");
+    }
+    finished = true;
+    return false;
+}
+
+QByteArray CompressedReader::read(qint64 maxSize) {
+    if (format == Compression::Format::None) {
+        QByteArray bytes = source->read(maxSize);
+        if (bytes.isEmpty()) {
+            checkDevice(source);
+            finished = true;
+        }
+        return bytes;
+    }
+
+    QByteArray output(maxSize, Qt::Uninitialized);
+    qint64 produced = 0;
+    while (produced < maxSize && !finished) {
+        if (inputPosition == input.size() && !pending && !refill()) {
+            break;
+        }
+        const qsizetype available = input.size() - inputPosition;
+        const qint64 producedBefore = produced;
+        if (format == Compression::Format::Gzip) {
+            if (codec->streamEnded) { // the next member of a concatenated file, e.g. from appending with gzip >>
+                if (available == 0) {
+                    pending = false;
+                    continue;
+                }
+                inflateReset(&codec->zlib);
+                codec->streamEnded = false;
+            }
+            z_stream &zlib = codec->zlib;
+            zlib.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData() + inputPosition));
+            zlib.avail_in = uInt(available);
+            zlib.next_out = reinterpret_cast<Bytef *>(output.data() + produced);
+            zlib.avail_out = uInt(maxSize - produced);
+            int result = inflate(&zlib, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                codec->streamEnded = true;
+            } else if (result != Z_OK && result != Z_BUF_ERROR) {
+                throw broken(zlib.msg ? zlib.msg : "gzip");
+            }
+            inputPosition += available - qsizetype(zlib.avail_in);
+            produced = maxSize - qint64(zlib.avail_out);
+        } else {
+#ifdef EDITOR_HAVE_ZSTD
+            ZSTD_inBuffer in = {input.constData() + inputPosition, size_t(available), 0};
+            ZSTD_outBuffer out = {output.data() + produced, size_t(maxSize - produced), 0};
+            size_t result = ZSTD_decompressStream(codec->zstd, &out, &in); // runs from one frame into the next on its own
+            if (ZSTD_isError(result)) {
+                throw broken(ZSTD_getErrorName(result));
+            }
+            codec->streamEnded = result == 0;
+            inputPosition += qsizetype(in.pos);
+            produced += qint64(out.pos);
+#endif
+        }
+        if (produced == producedBefore && available > 0 && inputPosition == input.size() - available) { // neither input taken nor output given
+            throw broken("die Daten sind beschädigt");
+        }
+        pending = produced == maxSize;
+    }
+    output.resize(produced);
+    return output;
+}
+
+struct CompressedWriter::Codec {
+    z_stream zlib = {};
+    bool zlibReady = false;
+#ifdef EDITOR_HAVE_ZSTD
+    ZSTD_CStream *zstd = nullptr;
+#endif
+
+    ~Codec() {
+        if (zlibReady) {
+            deflateEnd(&zlib);
+        }
+#ifdef EDITOR_HAVE_ZSTD
+        ZSTD_freeCStream(zstd);
+#endif
+    }
+};
+
+CompressedWriter::CompressedWriter(QIODevice *target, Compression::Format format): target(target), format(format), codec(new Codec) { // constructor
+    if (format == Compression::Format::None) {
+        return;
+    }
+    output.resize(outputSize);
+    if (format == Compression::Format::Gzip) {
+        if (deflateInit2(&codec->zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { // 16 writes a gzip header instead of zlib
+            throw std::runtime_error("Kann nicht packen: zlib");
+        }
+        codec->zlibReady = true;
+    } else {
+#ifdef EDITOR_HAVE_ZSTD
+        codec->zstd = ZSTD_createCStream();
+        if (!codec->zstd) {
+            throw std::runtime_error("Kann nicht packen: zstd");
+        }
+        ZSTD_CCtx_setParameter(codec->zstd, ZSTD_c_compressionLevel, 3); // the zstd default, fast enough to keep up with the disk
+        ZSTD_CCtx_setParameter(codec->zstd, ZSTD_c_checksumFlag, 1);
+#else
+        throw std::runtime_error("Kann nicht packen: zstd wird nicht unterstützt");
+#endif
+    }
+}
+
+CompressedWriter::~CompressedWriter() = default;
+
+void CompressedWriter::flush(qsizetype size) {
+    if (size > 0 && target->write(output.constData(), size) != size) {
+        throw std::runtime_error("Kann nicht speichern: " + target->errorString().toStdString());
+    }
+}
+
+void CompressedWriter::write(const QByteArray &bytes) {
+    if (format == Compression::Format::None) {
+        if (target->write(bytes) != bytes.size()) {
+            throw std::runtime_error("Kann nicht speichern: " + target->errorString().toStdString());
+        }
+        return;
+    }
+    if (format == Compression::Format::Gzip) {
+        z_stream &zlib = codec->zlib;
+        zlib.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(bytes.constData()));
+        zlib.avail_in = uInt(bytes.size());
+        while (zlib.avail_in > 0) {
+            zlib.next_out = reinterpret_cast<Bytef *>(output.data());
+            zlib.avail_out = uInt(outputSize);
+            if (deflate(&zlib, Z_NO_FLUSH) == Z_STREAM_ERROR) {
+                throw std::runtime_error("Kann nicht packen: zlib");
+            }
+            flush(outputSize - qsizetype(zlib.avail_out));
+        }
+        return;
+    }
+#ifdef EDITOR_HAVE_ZSTD
+    ZSTD_inBuffer in = {bytes.constData(), size_t(bytes.size()), 0};
+    while (in.pos < in.size) {
+        ZSTD_outBuffer out = {output.data(), size_t(outputSize), 0};
+        size_t result = ZSTD_compressStream2(codec->zstd, &out, &in, ZSTD_e_continue);
+        if (ZSTD_isError(result)) {
+            throw std::runtime_error(std::string("Kann nicht packen: ") + ZSTD_getErrorName(result));
+        }
+        flush(qsizetype(out.pos));
+    }
+#endif
+}
+
+void CompressedWriter::finish() {
+    if (format == Compression::Format::Gzip) {
+        z_stream &zlib = codec->zlib;
+        zlib.next_in = nullptr;
+        zlib.avail_in = 0;
+        int result = Z_OK;
+        while (result != Z_STREAM_END) {
+            zlib.next_out = reinterpret_cast<Bytef *>(output.data());
+            zlib.avail_out = uInt(outputSize);
+            result = deflate(&zlib, Z_FINISH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                throw std::runtime_error("Kann nicht packen: zlib");
+            }
+            flush(outputSize - qsizetype(zlib.avail_out));
+        }
+    } else if (format == Compression::Format::Zstd) {
+#ifdef EDITOR_HAVE_ZSTD
+        size_t remaining = 1;
+        while (remaining > 0) { // the end of the frame may need more than one buffer
+            ZSTD_inBuffer in = {nullptr, 0, 0};
+            ZSTD_outBuffer out = {output.data(), size_t(outputSize), 0};
+            remaining = ZSTD_compressStream2(codec->zstd, &out, &in, ZSTD_e_end);
+            if (ZSTD_isError(remaining)) {
+                throw std::runtime_error(std::string("Kann nicht packen: ") + ZSTD_getErrorName(remaining));
+            }
+            flush(qsizetype(out.pos));
+        }
+#endif
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef COMPRESSEDSTREAM_H
+#define COMPRESSEDSTREAM_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <memory>
+
+// gzip and zstd streams that are read and written in chunks, so neither the compressed nor the decompressed file is ever held as a whole
+namespace Compression {
+
+enum class Format { None, Gzip, Zstd };
+
+Format fromFileName(const QString &fileName); // by extension, used when saving under a new name
+Format fromHeader(const QByteArray &head); // by magic bytes, files without the usual extension are found as well
+Format detect(QIODevice &device); // peeks at the start of an open device, the magic bytes decide what is read
+Format detect(const QString &fileName); // a file that doesn't exist yet or is empty goes by its extension
+bool isAvailable(Format format); // zstd is optional at build time
+QString name(Format format);
+
+constexpr qint64 inputSize = 256 * 1024; // compressed bytes read from the device per step
+
+}
+
+class CompressedReader {
+    public:
+        CompressedReader(QIODevice *source, Compression::Format format); // throws if the format isn't available
+        ~CompressedReader();
+        CompressedReader(const CompressedReader &) = delete;
+        CompressedReader &operator=(const CompressedReader &) = delete;
+
+        QByteArray read(qint64 maxSize); // at most maxSize decompressed bytes, throws on broken or truncated data
+        bool atEnd() const;
+
+        struct Codec;
+
+    private:
+        bool refill();
+
+        QIODevice *source;
+        Compression::Format format;
+        std::unique_ptr<Codec> codec;
+        QByteArray input;
+        qsizetype inputPosition;
+        bool pending; // the codec filled the whole output last time and may hold more
+        bool finished;
+};
+
+class CompressedWriter {
+    public:
+        CompressedWriter(QIODevice *target, Compression::Format format); // throws if the format isn't available
+        ~CompressedWriter();
+        CompressedWriter(const CompressedWriter &) = delete;
+        CompressedWriter &operator=(const CompressedWriter &) = delete;
+
+        static constexpr qsizetype outputSize = 256 * 1024; // compressed bytes collected before they are written
+
+        void write(const QByteArray &bytes); // throws if the device fails
+        void finish(); // writes the end of the stream, nothing may be written afterwards
+
+        struct Codec;
+
+    private:
+        void flush(qsizetype size);
+
+        QIODevice *target;
+        Compression::Format format;
+        std::unique_ptr<Codec> codec;
+        QByteArray output;
+};
+
+#endif // COMPRESSEDSTREAM_H
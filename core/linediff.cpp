@@ -0,0 +1,198 @@
+#include "linediff.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Occurrence {
+    qsizetype oldLine = -1; // -2 once the line occurs more than once
+    qsizetype newLine = -1;
+};
+
+class Myers {
+    public:
+        Myers(const quint64 *oldLines, const quint64 *newLines): a(oldLines), b(newLines) { // constructor
+        }
+
+        QList<LineDiff::Hunk> run(const LineDiff::Region &region) {
+            compare(region.oldBegin, region.oldEnd, region.newBegin, region.newEnd);
+            return hunks;
+        }
+
+    private:
+        struct Snake {
+            qsizetype x0; // start, relative to the range
+            qsizetype y0;
+            qsizetype x1; // end
+            qsizetype y1;
+            qsizetype cost; // edits of the whole path through the snake
+        };
+
+        void compare(qsizetype a0, qsizetype a1, qsizetype b0, qsizetype b1) {
+            while (a0 < a1 && b0 < b1 && a[a0] == b[b0]) {
+                ++a0;
+                ++b0;
+            }
+            while (a1 > a0 && b1 > b0 && a[a1 - 1] == b[b1 - 1]) {
+                --a1;
+                --b1;
+            }
+            if (a0 == a1 || b0 == b1) {
+                add(a0, a1 - a0, b0, b1 - b0);
+                return;
+            }
+            Snake snake;
+            if (!middleSnake(a0, a1, b0, b1, snake)) { // too far apart for the shortest script, replaced as a whole
+                add(a0, a1 - a0, b0, b1 - b0);
+                return;
+            }
+            // both ends differ, so the cost is at least 2 and both halves are cheaper than the whole range
+            compare(a0, a0 + snake.x0, b0, b0 + snake.y0);
+            compare(a0 + snake.x1, a1, b0 + snake.y1, b1);
+        }
+
+        bool middleSnake(qsizetype a0, qsizetype a1, qsizetype b0, qsizetype b1, Snake &snake) { // the snake in the middle of a shortest edit path, the paths from both ends meet there
+            const qsizetype n = a1 - a0;
+            const qsizetype m = b1 - b0;
+            const qsizetype delta = n - m;
+            const bool odd = delta & 1;
+            const qsizetype limit = std::min<qsizetype>((n + m + 1) / 2, LineDiff::maxEditCost);
+            const qsizetype offset = limit + 1;
+            forward.assign(size_t(2 * limit + 3), 0); // furthest x on every diagonal k = x - y, indexed by k + offset
+            backward.assign(size_t(2 * limit + 3), 0); // the same from the end, in coordinates counted backwards
+            for (qsizetype d = 0; d <= limit; ++d) {
+                for (qsizetype k = -d; k <= d; k += 2) {
+                    qsizetype x = k == -d || (k != d && forward[size_t(offset + k - 1)] < forward[size_t(offset + k + 1)]) ? forward[size_t(offset + k + 1)] : forward[size_t(offset + k - 1)] + 1;
+                    qsizetype y = x - k;
+                    const qsizetype x0 = x;
+                    const qsizetype y0 = y;
+                    while (x < n && y < m && a[a0 + x] == b[b0 + y]) {
+                        ++x;
+                        ++y;
+                    }
+                    forward[size_t(offset + k)] = x;
+                    const qsizetype reverse = delta - k; // the same diagonal as seen from the end
+                    if (odd && reverse >= -(d - 1) && reverse <= d - 1 && x + backward[size_t(offset + reverse)] >= n) {
+                        snake = {x0, y0, x, y, 2 * d - 1};
+                        return true;
+                    }
+                }
+                for (qsizetype k = -d; k <= d; k += 2) {
+                    qsizetype x = k == -d || (k != d && backward[size_t(offset + k - 1)] < backward[size_t(offset + k + 1)]) ? backward[size_t(offset + k + 1)] : backward[size_t(offset + k - 1)] + 1;
+                    qsizetype y = x - k;
+                    const qsizetype x0 = x;
+                    const qsizetype y0 = y;
+                    while (x < n && y < m && a[a1 - 1 - x] == b[b1 - 1 - y]) {
+                        ++x;
+                        ++y;
+                    }
+                    backward[size_t(offset + k)] = x;
+                    const qsizetype reverse = delta - k;
+                    if (!odd && reverse >= -d && reverse <= d && x + forward[size_t(offset + reverse)] >= n) {
+                        snake = {n - x, m - y, n - x0, m - y0, 2 * d};
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void add(qsizetype oldStart, qsizetype oldCount, qsizetype newStart, qsizetype newCount) { // touching hunks are merged, the halves of a split often meet
+            if (oldCount == 0 && newCount == 0) {
+                return;
+            }
+            if (!hunks.isEmpty()) {
+                LineDiff::Hunk &last = hunks.last();
+                if (last.oldStart + last.oldCount == oldStart && last.newStart + last.newCount == newStart) {
+                    last.oldCount += oldCount;
+                    last.newCount += newCount;
+                    return;
+                }
+            }
+            hunks.append({oldStart, oldCount, newStart, newCount});
+        }
+
+        const quint64 *a;
+        const quint64 *b;
+        std::vector<qsizetype> forward;
+        std::vector<qsizetype> backward;
+        QList<LineDiff::Hunk> hunks;
+};
+
+}
+
+QList<LineDiff::Region> LineDiff::regions(const QVector<quint64> &oldLines, const QVector<quint64> &newLines) {
+    qsizetype a0 = 0;
+    qsizetype b0 = 0;
+    qsizetype a1 = oldLines.size();
+    qsizetype b1 = newLines.size();
+    while (a0 < a1 && b0 < b1 && oldLines.at(a0) == newLines.at(b0)) { // most compares are between versions of the same file
+        ++a0;
+        ++b0;
+    }
+    while (a1 > a0 && b1 > b0 && oldLines.at(a1 - 1) == newLines.at(b1 - 1)) {
+        --a1;
+        --b1;
+    }
+    QList<Region> result;
+    if (a0 == a1 && b0 == b1) {
+        return result;
+    }
+
+    std::unordered_map<quint64, Occurrence> occurrences;
+    occurrences.reserve(size_t((a1 - a0) + (b1 - b0)));
+    for (qsizetype i = a0; i < a1; ++i) {
+        Occurrence &occurrence = occurrences[oldLines.at(i)];
+        occurrence.oldLine = occurrence.oldLine == -1 ? i : -2;
+    }
+    for (qsizetype j = b0; j < b1; ++j) {
+        Occurrence &occurrence = occurrences[newLines.at(j)];
+        occurrence.newLine = occurrence.newLine == -1 ? j : -2;
+    }
+    std::vector<std::pair<qsizetype, qsizetype>> pairs; // lines unique on both sides, sorted by the old line
+    for (qsizetype i = a0; i < a1; ++i) {
+        const Occurrence &occurrence = occurrences.at(oldLines.at(i));
+        if (occurrence.oldLine == i && occurrence.newLine >= 0) {
+            pairs.emplace_back(i, occurrence.newLine);
+        }
+    }
+
+    // the longest run of pairs that is increasing in the new line as well, lines that moved don't become anchors
+    std::vector<qsizetype> tails;
+    std::vector<qsizetype> previous(pairs.size(), -1);
+    for (qsizetype k = 0; k < qsizetype(pairs.size()); ++k) {
+        auto slot = std::lower_bound(tails.begin(), tails.end(), pairs[size_t(k)].second, [&pairs](qsizetype index, qsizetype value) {
+            return pairs[size_t(index)].second < value;
+        });
+        if (slot != tails.begin()) {
+            previous[size_t(k)] = *(slot - 1);
+        }
+        if (slot == tails.end()) {
+            tails.push_back(k);
+        } else {
+            *slot = k;
+        }
+    }
+    std::vector<std::pair<qsizetype, qsizetype>> anchors;
+    for (qsizetype k = tails.empty() ? -1 : tails.back(); k >= 0; k = previous[size_t(k)]) {
+        anchors.push_back(pairs[size_t(k)]);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+
+    for (const auto &anchor : anchors) { // anchors next to each other leave nothing in between
+        if (anchor.first > a0 || anchor.second > b0) {
+            result.append({a0, anchor.first, b0, anchor.second});
+        }
+        a0 = anchor.first + 1;
+        b0 = anchor.second + 1;
+    }
+    if (a1 > a0 || b1 > b0) {
+        result.append({a0, a1, b0, b1});
+    }
+    return result;
+}
+
+QList<LineDiff::Hunk> LineDiff::diff(const Region &region, const QVector<quint64> &oldLines, const QVector<quint64> &newLines) {
+    return Myers(oldLines.constData(), newLines.constData()).run(region);
+}
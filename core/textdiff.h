@@ -0,0 +1,25 @@
+#ifndef TEXTDIFF_H
+#define TEXTDIFF_H
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+// finds the ranges in which two versions of a text differ, the texts are cut into chunks at line ends where the content says so,
+// so an insertion only shifts the chunks behind it instead of changing all of them, equal chunks are matched by their hashes
+namespace TextDiff {
+
+struct Edit {
+    qsizetype position; // in the old text
+    qsizetype removed;
+    QString inserted;
+};
+
+constexpr quint32 boundaryMask = 63; // a line whose hash has these bits clear ends a chunk, 64 lines per chunk on average
+constexpr qsizetype maxChunkLines = 1024;
+
+QList<Edit> diff(QStringView oldText, QStringView newText); // sorted by position, applied from the back they turn the old text into the new one
+
+}
+
+#endif // TEXTDIFF_H
@@ -0,0 +1,126 @@
+#include "documentstatistics.h"
+#include <QTextCursor>
+#include <QTextBlock>
+#include "linescanner.h"
+
+DocumentStatistics::DocumentStatistics(QPlainTextEdit *textEdit, ChangeTracker *tracker, IdleScheduler *scheduler, QObject *parent): QObject(parent), textEdit(textEdit), tracker(tracker), scheduler(scheduler), pendingPart(0), pendingOffset(0), characterCount(0), wordCount(0), newlineCount(0), selectionCharacters(0), selectionLines(0) { // constructor
+    connect(tracker, &ChangeTracker::textEdited, this, &DocumentStatistics::textEdited); // counts follow every edit
+    connect(textEdit, &QPlainTextEdit::selectionChanged, this, &DocumentStatistics::selectionChanged);
+    recount();
+}
+
+qint64 DocumentStatistics::characters() const {
+    return characterCount;
+}
+
+qint64 DocumentStatistics::words() const {
+    return wordCount;
+}
+
+bool DocumentStatistics::wordsPending() const {
+    return !pendingWords.isEmpty();
+}
+
+qint64 DocumentStatistics::lines() const { // an empty document still has one line
+    return newlineCount + 1;
+}
+
+qint64 DocumentStatistics::selectedCharacters() const {
+    return selectionCharacters;
+}
+
+qint64 DocumentStatistics::selectedLines() const {
+    return selectionLines;
+}
+
+void DocumentStatistics::recount() { // full count over the whole text, only needed once at the start
+    pendingWords.clear();
+    pendingPart = 0;
+    pendingOffset = 0;
+    scheduler->cancel(QStringLiteral("countWords"));
+    const QString text = tracker->text();
+    characterCount = text.length();
+    wordCount = wordStarts(QChar(), text, QChar());
+    newlineCount = countNewlines(text);
+    selectionChanged();
+}
+
+void DocumentStatistics::textEdited(int position, const QString &removed, const QString &inserted) { // only the changed range is counted
+    const PieceTable &text = tracker->table(); // already contains the inserted text
+    QChar before = position > 0 ? text.at(position - 1) : QChar(); // the neighbours decide whether a word was split or joined
+    int afterPosition = position + inserted.length();
+    QChar after = afterPosition < text.size() ? text.at(afterPosition) : QChar();
+
+    characterCount += inserted.length() - removed.length();
+    newlineCount += countNewlines(inserted) - countNewlines(removed); // vectorized scan over the changed range only
+    if (inserted.length() + removed.length() <= immediateLimit) { // typing, the deltas add up in any order
+        wordCount += wordStarts(before, inserted, after) - wordStarts(before, removed, after);
+    } else {
+        pendingWords.append(PendingWords{before, removed, inserted, after});
+        scheduler->schedule(QStringLiteral("countWords"), IdleScheduler::Background, [this](const IdleScheduler::Budget &budget) {
+            return countPendingWords(budget);
+        });
+    }
+    emit changed();
+}
+
+bool DocumentStatistics::countPendingWords(const IdleScheduler::Budget &budget) { // returns true once every pending edit is counted
+    while (!pendingWords.isEmpty()) {
+        const PendingWords &edit = pendingWords.first();
+        QStringView text = pendingPart == 0 ? QStringView(edit.removed) : QStringView(edit.inserted);
+        qsizetype end = qMin(pendingOffset + sliceSize, text.size());
+        QChar previous = pendingOffset > 0 ? text[pendingOffset - 1] : edit.before;
+        QChar next = end < text.size() ? QChar() : edit.after; // the word behind the edit counts once, with the last slice
+        qint64 words = wordStarts(previous, text.mid(pendingOffset, end - pendingOffset), next);
+        wordCount += pendingPart == 0 ? -words : words;
+        pendingOffset = end;
+        if (pendingOffset == text.size()) {
+            pendingOffset = 0;
+            if (++pendingPart == 2) {
+                pendingPart = 0;
+                pendingWords.removeFirst();
+            }
+        }
+        if (budget.expired()) {
+            break;
+        }
+    }
+    emit changed();
+    return pendingWords.isEmpty();
+}
+
+void DocumentStatistics::selectionChanged() { // selection size comes from the cursor, the line count from the block numbers
+    QTextCursor cursor = textEdit->textCursor();
+    selectionCharacters = cursor.selectionEnd() - cursor.selectionStart();
+    if (selectionCharacters > 0) {
+        QTextDocument *document = textEdit->document();
+        selectionLines = document->findBlock(cursor.selectionEnd()).blockNumber() - document->findBlock(cursor.selectionStart()).blockNumber() + 1;
+    } else {
+        selectionLines = 0;
+    }
+    emit changed();
+}
+
+qint64 DocumentStatistics::countNewlines(QStringView text) {
+    return qint64(LineScanner::countNewlines(reinterpret_cast<const char16_t *>(text.utf16()), size_t(text.size())));
+}
+
+bool DocumentStatistics::isWordCharacter(QChar c) { // words are runs of non-whitespace characters
+    return !c.isNull() && !c.isSpace();
+}
+
+qint64 DocumentStatistics::wordStarts(QChar before, QStringView text, QChar after) { // number of words starting inside text or right behind it
+    bool previousIsWord = isWordCharacter(before);
+    qint64 count = 0;
+    for (QChar c : text) {
+        bool isWord = isWordCharacter(c);
+        if (isWord && !previousIsWord) {
+            ++count;
+        }
+        previousIsWord = isWord;
+    }
+    if (isWordCharacter(after) && !previousIsWord) { // the following word may start or stop being separate
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,64 @@
+#ifndef DOCUMENTSTATISTICS_H
+#define DOCUMENTSTATISTICS_H
+
+#include <QObject>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <QPlainTextEdit>
+#include "changetracker.h"
+#include "idlescheduler.h"
+
+// character, word, line and selection counts that are updated from the changed range only,
+// the words of big edits like a paste or a loaded chunk are counted in idle time
+class DocumentStatistics : public QObject {
+    Q_OBJECT
+
+    public:
+        DocumentStatistics(QPlainTextEdit *textEdit, ChangeTracker *tracker, IdleScheduler *scheduler, QObject *parent = nullptr);
+
+        static constexpr qsizetype immediateLimit = 4096; // edits up to this many characters are counted right away
+        static constexpr qsizetype sliceSize = 64 * 1024; // characters counted between two looks at the budget
+
+        qint64 characters() const;
+        qint64 words() const;
+        bool wordsPending() const; // words() is not up to date while big edits wait to be counted
+        qint64 lines() const;
+        qint64 selectedCharacters() const;
+        qint64 selectedLines() const;
+        void recount();
+
+    signals:
+        void changed();
+
+    private slots:
+        void textEdited(int position, const QString &removed, const QString &inserted);
+        void selectionChanged();
+
+    private:
+        struct PendingWords { // the strings are shared with the change tracker, not copied
+            QChar before;
+            QString removed;
+            QString inserted;
+            QChar after;
+        };
+
+        bool countPendingWords(const IdleScheduler::Budget &budget);
+        static qint64 countNewlines(QStringView text);
+        static bool isWordCharacter(QChar c);
+        static qint64 wordStarts(QChar before, QStringView text, QChar after);
+
+        QPlainTextEdit *textEdit;
+        ChangeTracker *tracker;
+        IdleScheduler *scheduler;
+        QVector<PendingWords> pendingWords;
+        int pendingPart; // 0 while the removed text of the first pending edit is counted, 1 for the inserted one
+        qsizetype pendingOffset; // characters of that part counted so far
+        qint64 characterCount;
+        qint64 wordCount;
+        qint64 newlineCount;
+        qint64 selectionCharacters;
+        qint64 selectionLines;
+};
+
+#endif // DOCUMENTSTATISTICS_H
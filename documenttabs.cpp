@@ -0,0 +1,242 @@
+#include "documenttabs.h"
+#include "profiler.h"
+#include <QMenuBar>
+#include <QAction>
+#include <QCloseEvent>
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QKeySequence>
+
+namespace {
+
+QList<TextEditor *> recentlyShown; // the tabs of every window, the one shown last in front
+qint64 budget = DocumentTabs::defaultMemoryBudget;
+
+}
+
+DocumentTabs::DocumentTabs(QWidget *parent): QMainWindow(parent), tabs(new QTabWidget(this)), tabMenu(new QMenu(tr("&Tabs"), this)), folderDialog(nullptr) { // constructor
+    tabs->setDocumentMode(true);
+    tabs->setTabsClosable(true);
+    tabs->setMovable(true);
+    setCentralWidget(tabs);
+    connect(tabs, &QTabWidget::currentChanged, this, &DocumentTabs::currentChanged);
+    connect(tabs, &QTabWidget::tabCloseRequested, this, &DocumentTabs::closeTab);
+
+    QAction *newTabAction = tabMenu->addAction(tr("Neuer Tab")); // an empty document next to the others
+    newTabAction->setShortcut(QKeySequence::AddTab);
+    connect(newTabAction, &QAction::triggered, this, &DocumentTabs::newTab);
+
+    QAction *openAction = tabMenu->addAction(tr("In neuen Tabs öffnen...")); // the first file is shown, the others are only loaded when picked
+    openAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_O));
+    connect(openAction, &QAction::triggered, this, &DocumentTabs::openInNewTabs);
+
+    QAction *closeAction = tabMenu->addAction(tr("Tab schließen"));
+    closeAction->setShortcut(QKeySequence::Close);
+    connect(closeAction, &QAction::triggered, this, [this]() {
+        closeTab(tabs->currentIndex());
+    });
+
+    tabMenu->addSeparator();
+    QAction *nextAction = tabMenu->addAction(tr("Nächster Tab"));
+    nextAction->setShortcut(QKeySequence::NextChild);
+    connect(nextAction, &QAction::triggered, this, [this]() {
+        tabs->setCurrentIndex((tabs->currentIndex() + 1) % tabs->count());
+    });
+
+    QAction *previousAction = tabMenu->addAction(tr("Vorheriger Tab"));
+    previousAction->setShortcut(QKeySequence::PreviousChild);
+    connect(previousAction, &QAction::triggered, this, [this]() {
+        tabs->setCurrentIndex((tabs->currentIndex() + tabs->count() - 1) % tabs->count());
+    });
+
+    resize(800, 600); // resizes window to 800 by 600 px
+    newTab();
+}
+
+DocumentTabs::~DocumentTabs() {
+    disconnect(tabs, nullptr, this, nullptr); // the tabs are removed one by one while the widgets are destroyed, the slots must not run then
+}
+
+void DocumentTabs::setMemoryBudget(qint64 bytes) {
+    budget = bytes;
+    enforceBudget();
+}
+
+qint64 DocumentTabs::memoryBudget() {
+    return budget;
+}
+
+qint64 DocumentTabs::memoryUsage() { // estimated, see TextEditor::memoryUsage
+    qint64 usage = 0;
+    for (const TextEditor *editor : std::as_const(recentlyShown)) {
+        usage += editor->memoryUsage();
+    }
+    return usage;
+}
+
+TextEditor *DocumentTabs::current() const {
+    return page(tabs->currentIndex());
+}
+
+TextEditor *DocumentTabs::page(int index) const { // null for an index without a tab
+    return static_cast<TextEditor *>(tabs->widget(index));
+}
+
+TextEditor *DocumentTabs::newTab() {
+    TextEditor *editor = addPage();
+    tabs->setCurrentWidget(editor);
+    return editor;
+}
+
+TextEditor *DocumentTabs::addPage() { // a tab behind the last one, it is shown by the caller if at all
+    auto *editor = new TextEditor;
+    editor->menuBar()->setNativeMenuBar(false);
+    editor->menuBar()->hide(); // its menus show up in the menu bar of the window while the tab is current
+    editor->installEventFilter(this); // title and modified mark of the tab follow the document
+    connect(editor, &TextEditor::menusCreated, this, [this, editor]() { // the menus are only built after the first paint of the tab
+        if (editor == current()) {
+            updateMenus();
+        }
+    });
+    connect(editor, &TextEditor::documentLoaded, this, &DocumentTabs::enforceBudget); // a loaded document may push the others over the budget
+    connect(editor, &TextEditor::folderSearchRequested, this, &DocumentTabs::findInFolder);
+    connect(editor, &QObject::destroyed, [editor]() {
+        recentlyShown.removeAll(editor);
+    });
+    recentlyShown.append(editor); // never shown, so it is the first to go, though it holds nothing until it is shown
+    tabs->addTab(editor, QString());
+    updateTab(editor);
+    return editor;
+}
+
+void DocumentTabs::openFiles(const QStringList &files) { // the first file is shown, the others wait in background tabs until they are picked
+    TextEditor *shown = nullptr;
+    for (const QString &file : files) {
+        TextEditor *editor = nullptr;
+        for (int index = 0; index < tabs->count() && !editor; ++index) { // a file that is open already is only brought to the front
+            if (!page(index)->fileName().isEmpty() && QFileInfo(page(index)->fileName()) == QFileInfo(file)) {
+                editor = page(index);
+            }
+        }
+        if (!editor) {
+            editor = !shown && current() && current()->isUntouched() ? current() : addPage(); // an empty tab takes the first file, like an empty window did
+            editor->openLater(file);
+        }
+        if (!shown) {
+            shown = editor;
+        }
+    }
+    if (shown) {
+        tabs->setCurrentWidget(shown);
+        shown->activate(); // the tab may have been current already, then there was no change that loaded it
+    }
+}
+
+void DocumentTabs::findInFolder(const QString &startFolder) {
+    if (!folderDialog) {
+        folderDialog = new FolderFindDialog(this);
+        connect(folderDialog, &FolderFindDialog::hitActivated, this, &DocumentTabs::openHit);
+    }
+    folderDialog->activate(startFolder);
+}
+
+void DocumentTabs::openHit(const QString &fileName, qint64 line) { // a file that is open already is shown in its tab, others get a tab of their own
+    openFiles({fileName});
+    if (TextEditor *editor = current()) {
+        editor->showLineWhenLoaded(line);
+    }
+}
+
+void DocumentTabs::openInNewTabs() {
+    openFiles(QFileDialog::getOpenFileNames(this, tr("Öffnen"), "", tr("Text Files (*.txt);;All Files (*)")));
+}
+
+void DocumentTabs::currentChanged(int index) {
+    TextEditor *editor = page(index);
+    if (editor) {
+        recentlyShown.removeAll(editor);
+        recentlyShown.prepend(editor);
+        editor->activate(); // loads a document that was opened in the background or evicted
+        updateTab(editor);
+    }
+    updateMenus();
+    enforceBudget(); // the document that is shown now may push the others over the budget
+}
+
+bool DocumentTabs::closeTab(int index) { // returns false if the document was kept
+    TextEditor *editor = page(index);
+    if (!editor || !editor->askForSave()) {
+        return false;
+    }
+    editor->closeDocument();
+    recentlyShown.removeAll(editor);
+    tabs->removeTab(index);
+    editor->deleteLater();
+    if (tabs->count() == 0) { // the last tab takes the window with it
+        close();
+    }
+    return true;
+}
+
+void DocumentTabs::updateTab(TextEditor *editor) { // the title of the document with [*] as placeholder for the modified mark
+    const int index = tabs->indexOf(editor);
+    if (index < 0) {
+        return;
+    }
+    QString title = editor->windowTitle();
+    title.replace(QLatin1String("[*]"), editor->isWindowModified() ? QLatin1String("*") : QLatin1String(""));
+    title.replace(QLatin1Char('&'), QLatin1String("&&")); // a single & would underline the next letter
+    tabs->setTabText(index, title);
+    tabs->setTabToolTip(index, QDir::toNativeSeparators(editor->fileName()));
+    if (editor == current()) {
+        setWindowTitle(editor->windowTitle());
+        setWindowModified(editor->isWindowModified());
+    }
+}
+
+void DocumentTabs::updateMenus() { // the menus of the current tab work on its document, the tab menu follows them
+    menuBar()->clear(); // only removes the actions, the menus belong to their tabs
+    if (TextEditor *editor = current()) {
+        for (QAction *action : editor->menuBar()->actions()) {
+            menuBar()->addAction(action);
+        }
+    }
+    menuBar()->addMenu(tabMenu);
+}
+
+void DocumentTabs::enforceBudget() { // the documents shown least recently are evicted first, the ones on screen never
+    ScopedTimer timer("memoryBudget");
+    qint64 usage = memoryUsage();
+    for (auto editor = recentlyShown.crbegin(); editor != recentlyShown.crend() && usage > budget; ++editor) {
+        if ((*editor)->isVisible()) { // the current tab of some window
+            continue;
+        }
+        const qint64 bytes = (*editor)->memoryUsage();
+        if (bytes > 0 && (*editor)->evict()) { // busy documents are skipped, they are tried again with the next change of tabs
+            usage -= bytes;
+        }
+    }
+}
+
+void DocumentTabs::closeEvent(QCloseEvent *event) { // every document is asked for first, canceling one keeps the window with all its tabs
+    for (int index = 0; index < tabs->count(); ++index) {
+        if (!page(index)->askForSave()) {
+            event->ignore();
+            return;
+        }
+    }
+    for (int index = 0; index < tabs->count(); ++index) {
+        page(index)->closeDocument();
+    }
+    event->accept();
+}
+
+bool DocumentTabs::eventFilter(QObject *watched, QEvent *event) {
+    if (event->type() == QEvent::WindowTitleChange || event->type() == QEvent::ModifiedChange) {
+        if (auto *editor = qobject_cast<TextEditor *>(watched)) {
+            updateTab(editor);
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
@@ -0,0 +1,52 @@
+#ifndef DOCUMENTTABS_H
+#define DOCUMENTTABS_H
+
+#include <QMainWindow>
+#include <QTabWidget>
+#include <QMenu>
+#include <QStringList>
+#include "texteditor.h"
+#include "folderfinddialog.h"
+
+// a window with one tab per document, the menu bar shows the menus of the current tab, tabs opened in the background
+// are only loaded once they are shown, and the documents of all windows share one memory budget that evicts the ones
+// shown least recently when it is exceeded
+class DocumentTabs : public QMainWindow {
+    Q_OBJECT
+
+    public:
+        explicit DocumentTabs(QWidget *parent = nullptr);
+        ~DocumentTabs();
+
+        static constexpr qint64 defaultMemoryBudget = 1024LL * 1024 * 1024; // estimated bytes of all documents together
+
+        static void setMemoryBudget(qint64 bytes);
+        static qint64 memoryBudget();
+        static qint64 memoryUsage();
+
+        TextEditor *current() const;
+        TextEditor *newTab();
+        void openFiles(const QStringList &files);
+
+    protected:
+        void closeEvent(QCloseEvent *event) override;
+        bool eventFilter(QObject *watched, QEvent *event) override;
+
+    private:
+        TextEditor *addPage();
+        TextEditor *page(int index) const;
+        void currentChanged(int index);
+        bool closeTab(int index);
+        void openInNewTabs();
+        void updateTab(TextEditor *editor);
+        void updateMenus();
+        static void enforceBudget();
+        void findInFolder(const QString &startFolder);
+        void openHit(const QString &fileName, qint64 line);
+
+        QTabWidget *tabs;
+        QMenu *tabMenu;
+        FolderFindDialog *folderDialog; // one for all tabs, built when it is first used
+};
+
+#endif // DOCUMENTTABS_H
@@ -0,0 +1,382 @@
+#include "editjournal.h"
+#include "profiler.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUuid>
+#include <QMetaObject>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr quint32 journalMagic = 0x544A4E31; // "TJN1"
+constexpr quint32 journalVersion = 3; // 2 added the compression of the file, 3 its encoding and line ends
+constexpr quint8 editRecord = 1;
+constexpr quint8 snapshotRecord = 2;
+
+bool syncToDisk(QFile &file) { // QFile::flush only hands the data to the os
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+// text with a gap at the last edit, replaying keystrokes moves only the characters between two edits instead of the whole text
+class GapBuffer {
+    public:
+        explicit GapBuffer(const QString &text): buffer(size_t(text.size()) + minimumGap), gapStart(text.size()), gapEnd(qsizetype(buffer.size())) { // constructor
+            std::copy(text.utf16(), text.utf16() + text.size(), buffer.begin());
+        }
+
+        qsizetype size() const {
+            return qsizetype(buffer.size()) - (gapEnd - gapStart);
+        }
+
+        bool replace(qsizetype position, const QString &removed, const QString &inserted) { // false if the removed text isn't there, i.e. the journal doesn't belong to this text
+            if (position < 0 || position + removed.size() > size()) {
+                return false;
+            }
+            moveGap(position);
+            if (QStringView(buffer.data() + gapEnd, removed.size()) != QStringView(removed)) {
+                return false;
+            }
+            gapEnd += removed.size();
+            reserveGap(inserted.size());
+            std::copy(inserted.utf16(), inserted.utf16() + inserted.size(), buffer.begin() + gapStart);
+            gapStart += inserted.size();
+            return true;
+        }
+
+        QString text() const {
+            QString result;
+            result.reserve(size());
+            result.append(QStringView(buffer.data(), gapStart));
+            result.append(QStringView(buffer.data() + gapEnd, qsizetype(buffer.size()) - gapEnd));
+            return result;
+        }
+
+    private:
+        static constexpr qsizetype minimumGap = 64 * 1024;
+
+        void moveGap(qsizetype position) {
+            if (position < gapStart) { // the characters between position and the gap go behind it
+                qsizetype count = gapStart - position;
+                std::memmove(buffer.data() + gapEnd - count, buffer.data() + position, size_t(count) * sizeof(char16_t));
+                gapStart -= count;
+                gapEnd -= count;
+            } else if (position > gapStart) {
+                qsizetype count = position - gapStart;
+                std::memmove(buffer.data() + gapStart, buffer.data() + gapEnd, size_t(count) * sizeof(char16_t));
+                gapStart += count;
+                gapEnd += count;
+            }
+        }
+
+        void reserveGap(qsizetype length) { // grows by half the text at least, so growing stays rare
+            if (gapEnd - gapStart >= length) {
+                return;
+            }
+            qsizetype tail = qsizetype(buffer.size()) - gapEnd;
+            qsizetype gap = std::max(length, std::max(minimumGap, size() / 2));
+            std::vector<char16_t> grown(size_t(gapStart + gap + tail));
+            std::copy(buffer.begin(), buffer.begin() + gapStart, grown.begin());
+            std::copy(buffer.begin() + gapEnd, buffer.end(), grown.begin() + gapStart + gap);
+            buffer.swap(grown);
+            gapEnd = gapStart + gap;
+        }
+
+        std::vector<char16_t> buffer;
+        qsizetype gapStart;
+        qsizetype gapEnd;
+};
+
+QString loadBase(const QString &fileName, qint64 size, qint64 modified, Compression::Format compression, const TextCodec::Format &format, bool &invalidBytes) { // the file the journal started from, read the same way as the file loader does
+    if (fileName.isEmpty()) {
+        return QString();
+    }
+    QFileInfo info(fileName);
+    if (!info.exists() || info.size() != size || info.lastModified().toMSecsSinceEpoch() != modified) {
+        throw std::runtime_error("Datei wurde seit der letzten Sitzung verändert: " + fileName.toStdString());
+    }
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    if (Compression::detect(file) != compression) {
+        throw std::runtime_error("Datei wurde seit der letzten Sitzung verändert: " + fileName.toStdString());
+    }
+    CompressedReader reader(&file, compression); // the edits refer to the decompressed text
+    TextDecoder decoder(format); // the encoding the file was loaded with, not detected again
+    QString text;
+    while (!reader.atEnd()) {
+        text += decoder.decode(reader.read(1024 * 1024));
+    }
+    text += decoder.finish();
+    invalidBytes = decoder.hasError();
+    ChangeTracker::toPlainText(text);
+    return text;
+}
+}
+
+EditJournal::EditJournal(ChangeTracker *tracker, QObject *parent): QObject(parent), tracker(tracker), journalBytes(0), active(false) { // constructor
+    pool.setMaxThreadCount(1); // one thread, so the writes reach the file in order
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(flushInterval); // edits are collected and written together, not one by one
+    connect(&flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+    connect(tracker, &ChangeTracker::textEdited, this, &EditJournal::textEdited);
+}
+
+EditJournal::~EditJournal() { // the journal stays on disk, a document closed without saving is offered again at the next start
+    flush();
+    pool.waitForDone();
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+void EditJournal::begin(const QString &fileName, Compression::Format compression, const TextCodec::Format &format) { // starts a new journal for the document, based on the file as it is on disk now (or an empty document)
+    discard();
+    if (!QDir().mkpath(directory())) {
+        emit failed(tr("Kann Journal nicht anlegen: %1").arg(directory()));
+        return;
+    }
+    path = directory() + QLatin1Char('/') + QUuid::createUuid().toString(QUuid::WithoutBraces) + QLatin1String(".journal");
+    lock = std::make_unique<QLockFile>(path + QLatin1String(".lock"));
+    lock->setStaleLockTime(0); // only the lock of a process that doesn't run anymore is stale, however old it is
+    if (!lock->tryLock(0)) {
+        emit failed(tr("Kann Journal nicht sperren: %1").arg(path));
+        lock.reset();
+        path.clear();
+        return;
+    }
+
+    QFileInfo info(fileName);
+    header.clear();
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << journalMagic << journalVersion << fileName << (fileName.isEmpty() ? qint64(-1) : info.size()) << (fileName.isEmpty() ? qint64(0) : info.lastModified().toMSecsSinceEpoch()) << quint8(compression) << quint8(format.encoding) << format.bom << quint8(format.lineEnding);
+    journalBytes = 0;
+    active = true; // the file itself is only created with the first edit
+}
+
+void EditJournal::snapshot() { // compaction, the whole text replaces the journal and becomes the new base
+    if (!active) {
+        return;
+    }
+    flushTimer.stop();
+    buffer.clear(); // the edits collected so far are part of the snapshot
+    const PieceTable text = tracker->table(); // o(1) snapshot, flattened and encoded on the pool thread
+    const QByteArray start = header;
+    const QString target = path;
+    pool.start([this, text, start, target]() {
+        file.close();
+        QByteArray bytes = record(snapshotRecord, text.toString().toUtf8());
+        QSaveFile save(target); // the old journal stays valid until the new one is complete
+        if (!save.open(QIODevice::WriteOnly) || save.write(start) != start.size() || save.write(bytes) != bytes.size() || !save.commit()) {
+            fail(target, tr("Kann Journal nicht schreiben: %1").arg(save.errorString()));
+            return;
+        }
+        file.setFileName(target);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            fail(target, tr("Kann Journal nicht schreiben: %1").arg(file.errorString()));
+            return;
+        }
+        journalBytes = start.size() + bytes.size();
+    });
+}
+
+void EditJournal::discard() { // deletes the journal, e.g. after saving or when the document is closed on purpose
+    flushTimer.stop();
+    buffer.clear();
+    pool.waitForDone();
+    if (file.isOpen()) {
+        file.close();
+    }
+    if (!path.isEmpty()) {
+        QFile::remove(path);
+    }
+    if (lock) {
+        lock->unlock();
+        lock.reset();
+    }
+    path.clear();
+    journalBytes = 0;
+    active = false;
+}
+
+void EditJournal::suspend() { // stops journaling but keeps the journal and its lock, e.g. while the document is evicted, the next begin deletes it
+    flush();
+    pool.waitForDone(); // everything up to now is on disk, a crash meanwhile still recovers it
+    if (file.isOpen()) {
+        file.close();
+    }
+    active = false;
+}
+
+void EditJournal::flush() { // hands the collected edits to the pool thread, which appends and fsyncs them
+    if (!active || buffer.isEmpty()) {
+        return;
+    }
+    const QByteArray bytes = buffer;
+    const QByteArray start = header;
+    const QString target = path;
+    buffer.clear();
+    pool.start([this, bytes, start, target]() {
+        ScopedTimer timer("journalWrite");
+        if (!file.isOpen()) { // first write of this journal
+            file.setFileName(target);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(start) != start.size()) {
+                fail(target, tr("Kann Journal nicht schreiben: %1").arg(file.errorString()));
+                file.close();
+                return;
+            }
+            journalBytes += start.size();
+        }
+        if (file.write(bytes) != bytes.size() || !file.flush() || !syncToDisk(file)) {
+            fail(target, tr("Kann Journal nicht schreiben: %1").arg(file.errorString()));
+            return;
+        }
+        journalBytes += bytes.size();
+    });
+    if (journalBytes > qMax<qint64>(minimumCompactSize, qint64(tracker->size()) * 2)) { // replaying would take longer than reading a snapshot
+        snapshot();
+    }
+}
+
+bool EditJournal::isActive() const {
+    return active;
+}
+
+QString EditJournal::directory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + QLatin1String("/journal");
+}
+
+QStringList EditJournal::recoverable() { // journals of editors that didn't end cleanly, newest first
+    QStringList result;
+    const QFileInfoList files = QDir(directory()).entryInfoList({QStringLiteral("*.journal")}, QDir::Files, QDir::Time);
+    for (const QFileInfo &info : files) {
+        QLockFile probe(info.filePath() + QLatin1String(".lock"));
+        probe.setStaleLockTime(0);
+        if (probe.tryLock(0)) { // a running editor holds the lock of its own journal
+            probe.unlock();
+            result.append(info.filePath());
+        }
+    }
+    return result;
+}
+
+JournalRecovery EditJournal::recover(const QString &journalFile) { // replays the journal on top of its base, a cut off last batch is ignored
+    QFile in(journalFile);
+    if (!in.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + in.errorString().toStdString());
+    }
+    const QByteArray data = in.readAll();
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint64 baseSize = 0;
+    qint64 baseModified = 0;
+    quint8 compression = 0;
+    quint8 encoding = 0;
+    quint8 lineEnding = 0;
+    JournalRecovery recovery;
+    stream >> magic >> version >> recovery.fileName >> baseSize >> baseModified >> compression >> encoding >> recovery.format.bom >> lineEnding;
+    if (stream.status() != QDataStream::Ok || magic != journalMagic || version != journalVersion || compression > quint8(Compression::Format::Zstd) || encoding > quint8(TextCodec::Encoding::Latin1) || lineEnding > quint8(TextCodec::LineEnding::CrLf)) {
+        throw std::runtime_error("Kein gültiges Journal: " + journalFile.toStdString());
+    }
+    recovery.compression = Compression::Format(compression);
+    recovery.format.encoding = TextCodec::Encoding(encoding);
+    recovery.format.lineEnding = TextCodec::LineEnding(lineEnding);
+
+    std::unique_ptr<GapBuffer> text;
+    while (!stream.atEnd()) {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        quint8 type = 0;
+        stream >> size >> checksum >> type;
+        qint64 offset = stream.device()->pos();
+        if (stream.status() != QDataStream::Ok || offset + size > data.size()) { // the crash happened in the middle of a write
+            break;
+        }
+        const QByteArray payload = QByteArray::fromRawData(data.constData() + offset, qsizetype(size));
+        if (qChecksum(payload) != checksum) {
+            break;
+        }
+        stream.skipRawData(int(size));
+
+        if (type == snapshotRecord) {
+            text = std::make_unique<GapBuffer>(QString::fromUtf8(payload));
+        } else if (type == editRecord) {
+            if (!text) {
+                text = std::make_unique<GapBuffer>(loadBase(recovery.fileName, baseSize, baseModified, recovery.compression, recovery.format, recovery.invalidBytes));
+            }
+            QDataStream edit(payload);
+            edit.setVersion(QDataStream::Qt_6_0);
+            qint32 position = 0;
+            QString removed;
+            QString inserted;
+            edit >> position >> removed >> inserted;
+            if (edit.status() != QDataStream::Ok || !text->replace(position, removed, inserted)) {
+                throw std::runtime_error("Journal passt nicht zur Datei: " + recovery.fileName.toStdString());
+            }
+        }
+        ++recovery.edits;
+    }
+    if (text) {
+        recovery.text = text->text();
+    }
+    return recovery;
+}
+
+void EditJournal::remove(const QString &journalFile) { // after a recovery was restored or declined
+    QFile::remove(journalFile);
+    QFile::remove(journalFile + QLatin1String(".lock"));
+}
+
+void EditJournal::textEdited(int position, const QString &removed, const QString &inserted) { // only serialized here, written on the next flush
+    if (!active) {
+        return;
+    }
+    if (removed.size() + inserted.size() > snapshotEditSize) { // a snapshot is smaller than the removed and the inserted text together
+        snapshot();
+        return;
+    }
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << qint32(position) << removed << inserted;
+    buffer += record(editRecord, payload);
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void EditJournal::fail(const QString &target, const QString &error) { // called on the pool thread, journaling stops until the next begin
+    QMetaObject::invokeMethod(this, [this, target, error]() {
+        if (active && target == path) { // a journal that was discarded meanwhile doesn't matter anymore
+            active = false;
+            emit failed(error);
+        }
+    }, Qt::QueuedConnection);
+}
+
+QByteArray EditJournal::record(quint8 type, const QByteArray &payload) { // size and checksum in front, so a half written record is recognized
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << quint32(payload.size()) << quint16(qChecksum(payload)) << type;
+    bytes += payload;
+    return bytes;
+}
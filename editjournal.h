@@ -0,0 +1,73 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QLockFile>
+#include <QTimer>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include "changetracker.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+
+struct JournalRecovery {
+    QString fileName;
+    Compression::Format compression = Compression::Format::None; // of the file, a compressed file is saved compressed again
+    TextCodec::Format format; // encoding and line ends of the file, saving keeps them
+    bool invalidBytes = false; // the file has bytes that aren't valid in its encoding, saving over it loses them
+    QString text;
+    qint64 edits = 0;
+};
+
+// append-only journal of the edits since the last save, written in batches on a background thread so a crash loses at most one batch
+class EditJournal : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit EditJournal(ChangeTracker *tracker, QObject *parent = nullptr);
+        ~EditJournal();
+
+        static constexpr int flushInterval = 250; // ms between two writes, each write ends with an fsync
+        static constexpr qint64 minimumCompactSize = 4 * 1024 * 1024; // smaller journals are never compacted
+        static constexpr qsizetype snapshotEditSize = 1024 * 1024; // bigger edits (e.g. replace all) are stored as a snapshot instead
+
+        void begin(const QString &fileName, Compression::Format compression = Compression::Format::None, const TextCodec::Format &format = TextCodec::Format());
+        void snapshot();
+        void discard();
+        void suspend();
+        void flush();
+        bool isActive() const;
+
+        static QString directory();
+        static QStringList recoverable();
+        static JournalRecovery recover(const QString &journalFile);
+        static void remove(const QString &journalFile);
+
+    signals:
+        void failed(const QString &error);
+
+    private slots:
+        void textEdited(int position, const QString &removed, const QString &inserted);
+
+    private:
+        void fail(const QString &target, const QString &error);
+        static QByteArray record(quint8 type, const QByteArray &payload);
+
+        ChangeTracker *tracker;
+        QString path;
+        QByteArray header;
+        QByteArray buffer;
+        QFile file; // only touched by the jobs on the pool, the gui thread waits for them first
+        std::unique_ptr<QLockFile> lock; // a running editor keeps its journal locked, so it is never offered for recovery
+        QTimer flushTimer;
+        QThreadPool pool;
+        std::atomic<qint64> journalBytes;
+        bool active;
+};
+
+#endif // EDITJOURNAL_H
@@ -0,0 +1,515 @@
+#include "texteditor.h"
+#include "editjournal.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+#include "trigramindex.h"
+#include "linetransformer.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QKeyEvent>
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// times the hot paths of the editor on synthetic documents without a display and writes the results as json,
+// usage: editor_benchmark [--sizes 1,16,128,1024] [--keystrokes 1000] [--undo-steps 200] [--folder-files 100000] [--sort-lines 10000000] [--output results.json]
+
+namespace {
+
+constexpr int timeout = 30 * 60 * 1000; // a single open or save taking longer than this counts as hanging
+
+void generate(const QString &fileName, qint64 size) { // word-like lines of 0 to 120 characters, written in chunks so 1 gb fits into any memory
+    static const char *const words[] = {"int", "return", "value", "editor", "document", "line", "the", "a", "buffer", "while", "if", "count", "text", "=", "+", "{", "}", "(", ")", ";"};
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw std::runtime_error("Kann nicht schreiben: " + file.errorString().toStdString());
+    }
+    quint32 state = 12345;
+    QByteArray chunk;
+    chunk.reserve(1024 * 1024 + 256);
+    qint64 written = 0;
+    while (written < size) {
+        state = state * 1664525u + 1013904223u; // simple lcg, the same document on every run
+        int length = int((state >> 8) % 121);
+        QByteArray line;
+        while (line.size() < length) {
+            state = state * 1664525u + 1013904223u;
+            line += words[(state >> 16) % (sizeof(words) / sizeof(words[0]))];
+            line += ' ';
+        }
+        line += '\n';
+        chunk += line;
+        if (chunk.size() >= 1024 * 1024 || written + chunk.size() >= size) {
+            chunk.truncate(int(qMin<qint64>(chunk.size(), size - written)));
+            if (file.write(chunk) != chunk.size()) {
+                throw std::runtime_error("Kann nicht schreiben: " + file.errorString().toStdString());
+            }
+            written += chunk.size();
+            chunk.clear();
+        }
+    }
+}
+
+qint64 peakRss() { // bytes, the high water mark of the whole process
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return qint64(counters.PeakWorkingSetSize);
+    }
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef Q_OS_MACOS
+    return qint64(usage.ru_maxrss); // already bytes on macos
+#else
+    return qint64(usage.ru_maxrss) * 1024; // kilobytes everywhere else
+#endif
+#endif
+}
+
+bool waitUntilIdle(TextEditor &editor) { // runs the event loop until loading, saving and line counting are done
+    QElapsedTimer timer;
+    timer.start();
+    QTimer wakeUp; // makes sure the state is checked again even if no event arrives
+    wakeUp.start(5);
+    while (editor.isBusy()) {
+        if (timer.elapsed() > timeout) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    QCoreApplication::processEvents(); // layout and painting of the result belong to the measurement
+    return true;
+}
+
+QJsonObject summary(QVector<qint64> nanoseconds) { // distribution of single measurements in microseconds
+    QJsonObject result;
+    result["count"] = nanoseconds.size();
+    if (nanoseconds.isEmpty()) {
+        return result;
+    }
+    std::sort(nanoseconds.begin(), nanoseconds.end());
+    qint64 total = 0;
+    for (qint64 value : nanoseconds) {
+        total += value;
+    }
+    auto percentile = [&nanoseconds](double p) {
+        return nanoseconds.at(qMin(nanoseconds.size() - 1, int(p * nanoseconds.size()))) / 1000.0;
+    };
+    result["meanUs"] = double(total) / nanoseconds.size() / 1000.0;
+    result["medianUs"] = percentile(0.5);
+    result["p99Us"] = percentile(0.99);
+    result["maxUs"] = nanoseconds.last() / 1000.0;
+    return result;
+}
+
+QJsonObject throughput(qint64 bytes, qint64 nanoseconds) {
+    QJsonObject result;
+    result["ms"] = nanoseconds / 1e6;
+    result["mbPerSecond"] = nanoseconds > 0 ? double(bytes) / (1024.0 * 1024.0) / (nanoseconds / 1e9) : 0.0;
+    return result;
+}
+
+void press(QPlainTextEdit *textEdit, QChar character) { // the same events a real keystroke produces, so every connected slot runs
+    QKeyEvent down(QEvent::KeyPress, character.isSpace() ? Qt::Key_Space : Qt::Key_A + (character.toLower().unicode() - 'a'), Qt::NoModifier, QString(character));
+    QKeyEvent up(QEvent::KeyRelease, down.key(), Qt::NoModifier, QString(character));
+    QApplication::sendEvent(textEdit, &down);
+    QApplication::sendEvent(textEdit, &up);
+}
+
+QVector<qint64> typeKeys(QPlainTextEdit *textEdit, int count) { // types into the middle of the document, the worst case for every buffer
+    static const QString sample = QStringLiteral("the quick brown fox jumps over the lazy dog ");
+    QTextCursor cursor = textEdit->textCursor();
+    cursor.setPosition(textEdit->document()->characterCount() / 2);
+    textEdit->setTextCursor(cursor);
+    QVector<qint64> times;
+    times.reserve(count);
+    QElapsedTimer timer;
+    for (int i = 0; i < count; ++i) {
+        timer.start();
+        press(textEdit, sample.at(i % sample.size()));
+        times.append(timer.nsecsElapsed());
+        QCoreApplication::processEvents(); // timers and queued work of the keystroke run outside the measurement
+    }
+    return times;
+}
+
+QVector<qint64> undoSteps(TextEditor &editor, QPlainTextEdit *textEdit, int steps) { // scattered words are separate undo steps, each one is undone on its own
+    quint32 state = 54321;
+    const int size = textEdit->document()->characterCount() - 1;
+    for (int i = 0; i < steps; ++i) {
+        state = state * 1664525u + 1013904223u;
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(int(quint64(state) * quint64(size) >> 32));
+        textEdit->setTextCursor(cursor);
+        for (QChar character : QStringLiteral("undo ")) {
+            press(textEdit, character);
+        }
+        QCoreApplication::processEvents();
+    }
+    QVector<qint64> times;
+    times.reserve(steps);
+    QElapsedTimer timer;
+    for (int i = 0; i < steps; ++i) {
+        timer.start();
+        editor.undo();
+        times.append(timer.nsecsElapsed());
+        QCoreApplication::processEvents();
+    }
+    return times;
+}
+
+QVector<qint64> charCounts(TextEditor &editor, QPlainTextEdit *textEdit, int count) { // half of the calls with a selection, it adds the second part of the label
+    QVector<qint64> times;
+    times.reserve(count);
+    QElapsedTimer timer;
+    for (int i = 0; i < count; ++i) {
+        if (i == count / 2 && textEdit->isVisible()) {
+            QTextCursor cursor = textEdit->textCursor();
+            cursor.setPosition(0);
+            cursor.setPosition(qMin(textEdit->document()->characterCount() - 1, 100000), QTextCursor::KeepAnchor);
+            textEdit->setTextCursor(cursor);
+            QCoreApplication::processEvents();
+        }
+        timer.start();
+        editor.updateCharCount();
+        times.append(timer.nsecsElapsed());
+    }
+    return times;
+}
+
+QJsonObject evictAndActivate(TextEditor &editor, QPlainTextEdit *textEdit) { // what switching back to an evicted tab costs, until the first screen and until the whole text is back
+    QJsonObject result;
+    QElapsedTimer timer;
+    timer.start();
+    if (!editor.evict()) {
+        throw std::runtime_error("Kann nicht auslagern");
+    }
+    result["evictMs"] = timer.nsecsElapsed() / 1e6;
+
+    timer.start();
+    editor.activate();
+    QTimer wakeUp; // makes sure the state is checked again even if no event arrives
+    wakeUp.start(5);
+    while (textEdit->document()->characterCount() <= 1 && editor.isBusy()) { // the first chunk of the loader is on screen
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    QCoreApplication::processEvents();
+    result["firstScreenMs"] = timer.nsecsElapsed() / 1e6;
+    if (!waitUntilIdle(editor)) {
+        throw std::runtime_error("Laden hat zu lange gedauert");
+    }
+    result["loadedMs"] = timer.nsecsElapsed() / 1e6;
+    return result;
+}
+
+QJsonObject transcode(const QString &fileName) { // decoding and encoding alone, without disk and document, on at most 64 mb of the file
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    const QByteArray bytes = file.read(64 * 1024 * 1024);
+    const QString text = TextDecoder(TextCodec::Format()).decode(bytes);
+    QJsonObject result;
+    result["instructionSet"] = QString::fromLatin1(TextCodec::instructionSet());
+    QElapsedTimer timer;
+    for (TextCodec::Encoding encoding : {TextCodec::Encoding::Utf8, TextCodec::Encoding::Utf16LE, TextCodec::Encoding::Latin1}) {
+        TextCodec::Format format;
+        format.encoding = encoding;
+        format.lineEnding = TextCodec::LineEnding::CrLf; // the slower direction, every line end is converted
+        timer.start();
+        TextEncoder encoder(format);
+        QByteArray encoded = encoder.encode(text);
+        encoded += encoder.finish();
+        const qint64 encodeTime = timer.nsecsElapsed();
+        timer.start();
+        TextDecoder decoder(encoded); // with the detection, as the file loader does it
+        QString decoded = decoder.decode(encoded);
+        decoded += decoder.finish();
+        const qint64 decodeTime = timer.nsecsElapsed();
+        if (decoded != text || decoder.format().lineEnding != format.lineEnding) { // ascii text is detected as utf-8 even if it was written as latin-1
+            throw std::runtime_error("Kodierung stimmt nicht überein: " + TextCodec::name(format).toStdString());
+        }
+        QJsonObject times;
+        times["encode"] = throughput(encoded.size(), encodeTime);
+        times["decode"] = throughput(encoded.size(), decodeTime);
+        result[TextCodec::name(format)] = times;
+    }
+    return result;
+}
+
+QJsonObject run(TextEditor &editor, const QString &directory, qint64 size, int keystrokes, int steps) {
+    const QString source = directory + QStringLiteral("/document-%1.txt").arg(size);
+    const QString target = directory + QStringLiteral("/saved-%1.txt").arg(size);
+    std::fprintf(stderr, "%lld MB: generating\n", (long long)(size / (1024 * 1024)));
+    generate(source, size);
+
+    QJsonObject result;
+    result["sizeBytes"] = size;
+    QElapsedTimer timer;
+
+    std::fprintf(stderr, "%lld MB: transcoding\n", (long long)(size / (1024 * 1024)));
+    result["transcode"] = transcode(source);
+
+    std::fprintf(stderr, "%lld MB: opening\n", (long long)(size / (1024 * 1024)));
+    timer.start();
+    editor.openFile(source);
+    if (!waitUntilIdle(editor)) {
+        throw std::runtime_error("Öffnen hat zu lange gedauert");
+    }
+    result["open"] = throughput(size, timer.nsecsElapsed());
+
+    QPlainTextEdit *textEdit = editor.findChild<QPlainTextEdit *>();
+    const bool editable = textEdit && textEdit->isVisible(); // huge files end up in the read-only viewer
+    result["mode"] = editable ? QStringLiteral("editor") : QStringLiteral("viewer");
+    if (editable) {
+        std::fprintf(stderr, "%lld MB: typing\n", (long long)(size / (1024 * 1024)));
+        result["keystroke"] = summary(typeKeys(textEdit, keystrokes));
+        std::fprintf(stderr, "%lld MB: undoing\n", (long long)(size / (1024 * 1024)));
+        result["undo"] = summary(undoSteps(editor, textEdit, steps));
+    }
+    result["updateCharCount"] = summary(charCounts(editor, textEdit, 1000));
+
+    std::fprintf(stderr, "%lld MB: saving\n", (long long)(size / (1024 * 1024)));
+    timer.start();
+    editor.saveAsFile(target);
+    if (!waitUntilIdle(editor)) {
+        throw std::runtime_error("Speichern hat zu lange gedauert");
+    }
+    const qint64 saved = QFileInfo(target).size();
+    result["save"] = throughput(saved, timer.nsecsElapsed());
+
+    if (editable) {
+        std::fprintf(stderr, "%lld MB: evicting\n", (long long)(size / (1024 * 1024)));
+        result["evict"] = evictAndActivate(editor, textEdit); // the document matches the saved file, it is loaded from there again
+        press(textEdit, QLatin1Char('x'));
+        QCoreApplication::processEvents();
+        result["evictModified"] = evictAndActivate(editor, textEdit); // read back from the spill instead
+    }
+
+    if (editable) { // compressed files are always loaded into the editor, the viewer only maps plain ones
+        for (Compression::Format format : {Compression::Format::Gzip, Compression::Format::Zstd}) {
+            if (!Compression::isAvailable(format)) {
+                continue;
+            }
+            const QString name = Compression::name(format);
+            const QString packed = target + (format == Compression::Format::Gzip ? QStringLiteral(".gz") : QStringLiteral(".zst"));
+            QJsonObject compressed;
+            std::fprintf(stderr, "%lld MB: saving %s\n", (long long)(size / (1024 * 1024)), qPrintable(name));
+            timer.start();
+            editor.saveAsFile(packed);
+            if (!waitUntilIdle(editor)) {
+                throw std::runtime_error("Speichern hat zu lange gedauert");
+            }
+            compressed["save"] = throughput(saved, timer.nsecsElapsed()); // throughput of the text, not of the smaller file
+            compressed["ratio"] = QFileInfo(packed).size() > 0 ? double(saved) / QFileInfo(packed).size() : 0.0;
+
+            std::fprintf(stderr, "%lld MB: opening %s\n", (long long)(size / (1024 * 1024)), qPrintable(name));
+            timer.start();
+            editor.openFile(packed);
+            if (!waitUntilIdle(editor)) {
+                throw std::runtime_error("Öffnen hat zu lange gedauert");
+            }
+            compressed["open"] = throughput(saved, timer.nsecsElapsed());
+            result[name] = compressed;
+            QFile::remove(packed);
+        }
+    }
+    result["peakRssBytes"] = peakRss(); // sizes run in ascending order, so this is the peak of the biggest document so far
+
+    QFile::remove(source);
+    QFile::remove(target);
+    return result;
+}
+
+QJsonObject folderSearch(const QString &directory, int count) { // index build, incremental update and queries over many small files, 100 per directory
+    QJsonObject result;
+    const QString root = directory + QStringLiteral("/folder");
+    for (int i = 0; i < count; ++i) {
+        const QString subdirectory = root + QStringLiteral("/d%1").arg(i / 100);
+        if (i % 100 == 0) {
+            QDir().mkpath(subdirectory);
+        }
+        generate(subdirectory + QStringLiteral("/f%1.txt").arg(i), 1024 + (i * 7919) % 7168); // 1 to 8 kb
+    }
+    const QString indexFile = directory + QStringLiteral("/folder.index");
+    const QString updatedFile = directory + QStringLiteral("/folder-updated.index");
+    QElapsedTimer timer;
+    timer.start();
+    TrigramIndex::build(root, nullptr, indexFile);
+    result["files"] = count;
+    result["buildMs"] = timer.elapsed();
+    result["indexBytes"] = QFileInfo(indexFile).size();
+
+    TrigramIndex index;
+    index.open(root, indexFile);
+    for (int i = 0; i < count; i += 100) { // one changed file per directory
+        QFile file(root + QStringLiteral("/d%1/f%2.txt").arg(i / 100).arg(i));
+        if (!file.open(QIODevice::Append) || file.write("\nzebra quagga\n") < 0) {
+            throw std::runtime_error("Kann nicht schreiben: " + file.errorString().toStdString());
+        }
+    }
+    timer.restart();
+    TrigramIndex::build(root, &index, updatedFile);
+    result["updateMs"] = timer.elapsed();
+
+    TrigramIndex updated;
+    updated.open(root, updatedFile);
+    QJsonObject queries;
+    for (const char *term : {"quagga", "zebra quagga", "editor document", "while (", "ReTuRn"}) { // rare, rare phrase, common phrase, punctuation, folded case
+        QVector<qint64> nanoseconds;
+        qsizetype hits = 0;
+        for (int repeat = 0; repeat < 5; ++repeat) {
+            timer.restart();
+            hits = updated.search(QString::fromLatin1(term), false).size();
+            nanoseconds.append(timer.nsecsElapsed());
+        }
+        QJsonObject query = summary(nanoseconds);
+        query["hits"] = hits;
+        queries[QString::fromLatin1(term)] = query;
+    }
+    result["queries"] = queries;
+    QDir(root).removeRecursively();
+    QFile::remove(indexFile);
+    QFile::remove(updatedFile);
+    return result;
+}
+
+QJsonObject lineOperations(int count) { // sort, numeric sort and unique on lines of a number and a word, a quarter of the numbers repeat often
+    static const char *const words[] = {"int", "return", "value", "editor", "document", "line", "the", "a", "buffer", "while"};
+    QString text;
+    text.reserve(qsizetype(count) * 24);
+    quint32 state = 4711;
+    for (int i = 0; i < count; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const quint32 number = (state >> 8) % 4 == 0 ? (state >> 10) % 1000 : state >> 4;
+        text += QString::number(number);
+        text += QLatin1Char(' ');
+        text += QLatin1String(words[(state >> 16) % (sizeof(words) / sizeof(words[0]))]);
+        if (i + 1 < count) {
+            text += QLatin1Char('\n');
+        }
+    }
+    QJsonObject result;
+    result["lines"] = count;
+    result["characters"] = qint64(text.size());
+    QElapsedTimer timer;
+    const std::pair<LineOperation::Kind, const char *> operations[] = {{LineOperation::Sort, "sortMs"}, {LineOperation::SortNumeric, "sortNumericMs"}, {LineOperation::Unique, "uniqueMs"}};
+    for (const auto &entry : operations) {
+        LineOperation operation;
+        operation.kind = entry.first;
+        timer.restart();
+        const QString transformed = LineTransformer::apply(text, operation);
+        result[QString::fromLatin1(entry.second)] = timer.elapsed();
+        result[QString::fromLatin1(entry.second).chopped(2) + QStringLiteral("Characters")] = qint64(transformed.size()); // keeps the result from being optimized away and shows what unique removed
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen"); // no display needed, but widgets are still laid out and painted
+    }
+    QApplication application(argc, argv);
+    QApplication::setApplicationName(QStringLiteral("editor_benchmark")); // journals go into their own directory, apart from the ones of the editor
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption sizesOption(QStringLiteral("sizes"), QStringLiteral("Document sizes in MB, comma separated."), QStringLiteral("list"), QStringLiteral("1,16,128,1024"));
+    QCommandLineOption keystrokesOption(QStringLiteral("keystrokes"), QStringLiteral("Keystrokes typed per document."), QStringLiteral("count"), QStringLiteral("1000"));
+    QCommandLineOption stepsOption(QStringLiteral("undo-steps"), QStringLiteral("Undo steps per document."), QStringLiteral("count"), QStringLiteral("200"));
+    QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("JSON file for the results, stdout if not given."), QStringLiteral("file"));
+    QCommandLineOption folderOption(QStringLiteral("folder-files"), QStringLiteral("Files for the folder search, 0 skips it."), QStringLiteral("count"), QStringLiteral("100000"));
+    QCommandLineOption sortOption(QStringLiteral("sort-lines"), QStringLiteral("Lines for sort and unique, 0 skips them."), QStringLiteral("count"), QStringLiteral("10000000"));
+    QCommandLineOption directoryOption(QStringLiteral("directory"), QStringLiteral("Where the documents are generated."), QStringLiteral("path"), QDir::tempPath());
+    parser.addOptions({sizesOption, keystrokesOption, stepsOption, folderOption, sortOption, outputOption, directoryOption});
+    parser.process(application);
+
+    QVector<qint64> sizes;
+    for (const QString &size : parser.value(sizesOption).split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        sizes.append(qint64(size.trimmed().toDouble() * 1024 * 1024));
+    }
+    std::sort(sizes.begin(), sizes.end()); // peak rss only grows, ascending sizes keep the per document values meaningful
+
+    QTemporaryDir directory(parser.value(directoryOption) + QStringLiteral("/editor_benchmark-XXXXXX"));
+    if (!directory.isValid()) {
+        std::fprintf(stderr, "Kann nicht anlegen: %s\n", qPrintable(directory.errorString()));
+        return 1;
+    }
+    QDir(EditJournal::directory()).removeRecursively(); // journals of an aborted run would pile up otherwise
+
+    QJsonArray results;
+    QJsonObject folder;
+    QJsonObject lines;
+    {
+        TextEditor editor;
+        editor.show();
+        QCoreApplication::processEvents();
+        try {
+            for (qint64 size : sizes) {
+                results.append(run(editor, directory.path(), size, parser.value(keystrokesOption).toInt(), parser.value(stepsOption).toInt()));
+            }
+            if (parser.value(folderOption).toInt() > 0) {
+                folder = folderSearch(directory.path(), parser.value(folderOption).toInt());
+            }
+            if (parser.value(sortOption).toInt() > 0) {
+                lines = lineOperations(parser.value(sortOption).toInt());
+            }
+        } catch (const std::exception &e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+    }
+    QDir(EditJournal::directory()).removeRecursively();
+
+    QJsonObject report;
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = QString::fromLatin1(qVersion());
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["os"] = QSysInfo::prettyProductName();
+    report["peakRssBytes"] = peakRss();
+    report["results"] = results;
+    if (!folder.isEmpty()) {
+        report["folderSearch"] = folder;
+    }
+    if (!lines.isEmpty()) {
+        report["lineOperations"] = lines;
+    }
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+    QFile output(parser.value(outputOption));
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(json) != json.size()) {
+        std::fprintf(stderr, "Kann nicht schreiben: %s\n", qPrintable(output.errorString()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "filefollower.h"
+#include "profiler.h"
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+bool sameFile(const QFile &file, const QString &path) { // false once the path names another file than the open handle, e.g. after a rename and a new file
+#ifdef Q_OS_WIN
+    Q_UNUSED(file)
+    Q_UNUSED(path)
+    return true; // qt opens files without FILE_SHARE_DELETE there, so a followed file can't be renamed away
+#else
+    struct stat opened;
+    struct stat named;
+    if (::fstat(file.handle(), &opened) != 0 || ::stat(QFile::encodeName(path).constData(), &named) != 0) { // can't tell, the other checks decide
+        return true;
+    }
+    return opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+#endif
+}
+
+}
+
+FileFollower::FileFollower(QObject *parent): QObject(parent), decoder(format), offset(0), active(false) { // constructor
+    readTimer.setSingleShot(true);
+    pollTimer.setInterval(pollInterval);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &FileFollower::fileChanged); // inotify on linux
+    connect(&pollTimer, &QTimer::timeout, this, &FileFollower::fileChanged);
+    connect(&readTimer, &QTimer::timeout, this, &FileFollower::readBatch);
+}
+
+void FileFollower::start(const QString &fileName, qint64 bytesRead, const TextCodec::Format &fileFormat) { // bytesRead is where the document ends in the file
+    stop();
+    path = fileName;
+    offset = bytesRead;
+    format = fileFormat;
+    TextCodec::Format rest = format;
+    rest.bom = bytesRead == 0 && rest.bom; // the mark was read with the document already
+    decoder = TextDecoder(rest);
+    active = true;
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit failed(tr("Kann nicht öffnen: %1").arg(file.errorString()));
+        return;
+    }
+    birthTime = QFileInfo(path).birthTime();
+    watcher.addPath(path);
+    pollTimer.start();
+    readTimer.start(0); // whatever was appended since the file was loaded
+}
+
+void FileFollower::stop() {
+    active = false;
+    readTimer.stop();
+    pollTimer.stop();
+    if (!watcher.files().isEmpty()) {
+        watcher.removePaths(watcher.files());
+    }
+    file.close();
+}
+
+bool FileFollower::isActive() const {
+    return active;
+}
+
+qint64 FileFollower::position() const {
+    return offset;
+}
+
+void FileFollower::fileChanged() {
+    if (active && !readTimer.isActive()) { // further notifications while waiting don't push the read back
+        readTimer.start(settleDelay);
+    }
+}
+
+bool FileFollower::replaced(const QFileInfo &info) const { // truncated in place, or rotated and created anew
+    if (info.size() < offset) {
+        return true;
+    }
+    QDateTime birth = info.birthTime();
+    if (birth.isValid() && birthTime.isValid() && birth != birthTime) {
+        return true;
+    }
+    return !sameFile(file, path); // without a birth time a new file that already grew past offset is only told apart by its inode
+}
+
+void FileFollower::readBatch() {
+    if (!active) {
+        return;
+    }
+    ScopedTimer timer("followRead");
+    QFileInfo info(path);
+    if (!info.exists()) { // rotated away, the poll timer looks again until the new file is there
+        return;
+    }
+    if (replaced(info)) {
+        file.close();
+        if (!file.open(QIODevice::ReadOnly)) {
+            emit failed(tr("Kann nicht öffnen: %1").arg(file.errorString()));
+            return;
+        }
+        offset = 0;
+        decoder = TextDecoder(format); // the new file starts with its own byte order mark, if any
+        birthTime = info.birthTime();
+        emit restarted();
+    }
+    if (!watcher.files().contains(path)) { // the watcher drops a file once it is removed or renamed
+        watcher.addPath(path);
+    }
+
+    if (!file.seek(offset)) {
+        return;
+    }
+    QByteArray bytes = file.read(batchSize);
+    if (bytes.isEmpty()) {
+        return;
+    }
+    offset += bytes.size();
+    QString text = decoder.decode(bytes); // same line ends as the file loader, a \r at the end waits for the next batch
+    if (!text.isEmpty()) {
+        emit appended(text);
+    }
+    if (active && file.size() > offset) { // more is waiting, input and painting get a turn before the next batch
+        readTimer.start(0);
+    }
+}
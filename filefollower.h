@@ -0,0 +1,54 @@
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+#include <QObject>
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDateTime>
+#include "textcodec.h"
+
+// follows a file that another program keeps appending to, like tail -F, only the new bytes are read and handed out in batches,
+// one batch per turn of the event loop, so a fast writer can't freeze the gui
+class FileFollower : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit FileFollower(QObject *parent = nullptr);
+
+        static constexpr qint64 batchSize = 4 * 1024 * 1024; // bytes read per turn of the event loop
+        static constexpr int settleDelay = 50; // ms, a burst of change notifications leads to one read
+        static constexpr int pollInterval = 1000; // ms, for file systems without notifications and while a rotated file is missing
+
+        void start(const QString &fileName, qint64 offset, const TextCodec::Format &format);
+        void stop();
+        bool isActive() const;
+        qint64 position() const; // bytes of the file handed out so far
+
+    signals:
+        void appended(const QString &text);
+        void restarted(); // the file was truncated or replaced, the following batches are read from its start
+        void failed(const QString &error); // the owner decides whether to stop
+
+    private slots:
+        void fileChanged();
+        void readBatch();
+
+    private:
+        bool replaced(const QFileInfo &info) const;
+
+        QString path;
+        QFile file;
+        QFileSystemWatcher watcher;
+        QTimer readTimer;
+        QTimer pollTimer;
+        TextCodec::Format format; // as detected when the file was loaded
+        TextDecoder decoder; // keeps sequences and a \r\n that are split between two batches
+        QDateTime birthTime; // tells a new file under the same name apart, where the file system knows it, the inode is compared as well
+        qint64 offset;
+        bool active;
+};
+
+#endif // FILEFOLLOWER_H
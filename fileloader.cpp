@@ -0,0 +1,145 @@
+#include "fileloader.h"
+#include "profiler.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+#include <QFile>
+#include <QMetaObject>
+#include <memory>
+
+FileLoader::FileLoader(QObject *parent): QObject(parent), worker(nullptr), pendingSlots(maxPendingChunks), canceledFlag(false), currentGeneration(0), running(false) { // constructor
+}
+
+FileLoader::~FileLoader() {
+    stop(); // the worker must not outlive the loader
+}
+
+void FileLoader::start(const QString &fileName) { // starts loading, a running load is canceled first
+    stop();
+    canceledFlag = false;
+    running = true;
+    const quint64 generation = ++currentGeneration; // results of older loads are recognized and dropped
+    worker = QThread::create([this, fileName, generation]() {
+        run(fileName, generation);
+    });
+    worker->start();
+}
+
+void FileLoader::cancel() { // the worker stops after the current chunk, canceled() follows
+    canceledFlag = true;
+}
+
+bool FileLoader::isRunning() const { // true until finished, failed or canceled has been emitted
+    return running;
+}
+
+void FileLoader::run(const QString &fileName, quint64 generation) { // runs on the worker thread
+    auto post = [this, generation](auto function) { // hands work over to the gui thread, unless a newer load has started in the meantime
+        QMetaObject::invokeMethod(this, [this, generation, function]() {
+            if (generation == currentGeneration) {
+                function();
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QString error = tr("Kann nicht öffnen: %1").arg(file.errorString());
+        post([this, error]() {
+            running = false;
+            emit failed(error);
+        });
+        return;
+    }
+
+    const qint64 total = file.size(); // progress counts the bytes taken from the file, compressed or not
+    qint64 done = 0;
+    std::unique_ptr<TextDecoder> decoder; // keeps incomplete sequences and a trailing \r between chunks
+    qint64 size = firstChunkSize;
+
+    std::unique_ptr<CompressedReader> reader;
+    while (!canceledFlag) {
+        QByteArray bytes;
+        try {
+            ScopedTimer timer("fileRead"); // the wait for the gui thread below is not part of it
+            if (!reader) { // .gz and .zst files are recognized by their first bytes and decompressed chunk by chunk
+                reader = std::make_unique<CompressedReader>(&file, Compression::detect(file));
+            }
+            bytes = reader->read(size);
+        } catch (const std::exception &e) {
+            QString error = QString::fromUtf8(e.what());
+            post([this, error]() {
+                running = false;
+                emit failed(error);
+            });
+            return;
+        }
+        bool atEnd = bytes.isEmpty() || reader->atEnd();
+        done = file.pos();
+
+        if (!decoder) { // the encoding is detected from the first chunk, the line ending from all of them
+            decoder = std::make_unique<TextDecoder>(bytes);
+        }
+        QString text;
+        {
+            ScopedTimer timer("fileDecode");
+            text = decoder->decode(bytes); // \r\n becomes \n, same as reading in text mode
+            if (atEnd) {
+                text += decoder->finish();
+            }
+        }
+
+        if (!text.isEmpty()) {
+            if (!waitForSlot()) { // blocks while the gui thread is still busy with earlier chunks
+                break;
+            }
+            post([this, text, done, total]() {
+                emit chunkLoaded(text);
+                emit progress(done, total);
+                pendingSlots.release(); // the chunk is in the document now, the worker may send the next one
+            });
+        }
+        if (atEnd) {
+            break;
+        }
+        size = chunkSize;
+    }
+
+    if (canceledFlag) {
+        post([this]() {
+            running = false;
+            emit canceled();
+        });
+    } else {
+        const TextCodec::Format format = decoder ? decoder->format() : TextCodec::Format();
+        const bool invalidBytes = decoder && decoder->hasError();
+        post([this, format, invalidBytes]() {
+            running = false;
+            emit formatDetected(format, invalidBytes);
+            emit finished();
+        });
+    }
+}
+
+bool FileLoader::waitForSlot() { // returns false when the load was canceled while waiting
+    while (!pendingSlots.tryAcquire(1, 20)) {
+        if (canceledFlag) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FileLoader::stop() { // cancels a running load and waits for the worker
+    canceledFlag = true;
+    if (worker) {
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+    ++currentGeneration; // chunks that are still queued are dropped
+    int missing = maxPendingChunks - pendingSlots.available();
+    if (missing > 0) {
+        pendingSlots.release(missing);
+    }
+    running = false;
+}
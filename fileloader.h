@@ -0,0 +1,47 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QSemaphore>
+#include <atomic>
+#include "textcodec.h"
+
+// reads and decodes a file in chunks on a worker thread, the chunks are handed to the gui thread one by one
+class FileLoader : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit FileLoader(QObject *parent = nullptr);
+        ~FileLoader();
+
+        static constexpr qint64 firstChunkSize = 64 * 1024; // small first chunk so the first screen shows up right away
+        static constexpr qint64 chunkSize = 1024 * 1024;
+        static constexpr int maxPendingChunks = 4; // the worker waits when the gui thread falls behind
+
+        void start(const QString &fileName);
+        void cancel();
+        void stop();
+        bool isRunning() const;
+
+    signals:
+        void chunkLoaded(const QString &text);
+        void progress(qint64 bytesRead, qint64 bytesTotal);
+        void formatDetected(const TextCodec::Format &format, bool invalidBytes); // right before finished, invalidBytes if some bytes became U+FFFD
+        void finished();
+        void failed(const QString &error);
+        void canceled();
+
+    private:
+        void run(const QString &fileName, quint64 generation);
+        bool waitForSlot();
+
+        QThread *worker;
+        QSemaphore pendingSlots;
+        std::atomic<bool> canceledFlag;
+        quint64 currentGeneration;
+        bool running;
+};
+
+#endif // FILELOADER_H
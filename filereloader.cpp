@@ -0,0 +1,147 @@
+#include "filereloader.h"
+#include "profiler.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <memory>
+
+FileReloader::FileReloader(QObject *parent): QObject(parent), knownSize(-1), removed(false), worker(nullptr), canceledFlag(false), currentGeneration(0), running(false) { // constructor
+    settleTimer.setSingleShot(true);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &FileReloader::fileChanged);
+    connect(&settleTimer, &QTimer::timeout, this, &FileReloader::checkFile);
+}
+
+FileReloader::~FileReloader() {
+    stop(); // the worker must not outlive the reloader
+}
+
+void FileReloader::watch(const QString &fileName) {
+    unwatch();
+    path = fileName;
+    QFileInfo info(path);
+    knownModified = info.lastModified();
+    knownSize = info.size();
+    removed = !info.exists();
+    if (!removed) {
+        watcher.addPath(path);
+    }
+}
+
+void FileReloader::unwatch() {
+    settleTimer.stop();
+    if (!watcher.files().isEmpty()) {
+        watcher.removePaths(watcher.files());
+    }
+    path.clear();
+}
+
+void FileReloader::fileChanged() {
+    if (!path.isEmpty()) {
+        settleTimer.start(settleDelay); // every further notification pushes the check back until the writer is done
+    }
+}
+
+void FileReloader::checkFile() {
+    QFileInfo info(path);
+    if (!info.exists()) {
+        if (!removed) {
+            removed = true;
+            emit removedFromDisk();
+        }
+        settleTimer.start(pollInterval); // looks again until the file is back, the watcher can't see it meanwhile
+        return;
+    }
+    if (!watcher.files().contains(path)) { // replaced by renaming, the watcher dropped the old file
+        watcher.addPath(path);
+    }
+    if (!removed && info.lastModified() == knownModified && info.size() == knownSize) { // our own save, or a touch without changes
+        return;
+    }
+    removed = false;
+    knownModified = info.lastModified(); // the same change is reported only once
+    knownSize = info.size();
+    emit changedOnDisk();
+}
+
+void FileReloader::reload(const PieceTable &document, qint64 revision) { // the document is an o(1) snapshot, editing goes on meanwhile
+    stop();
+    canceledFlag = false;
+    running = true;
+    const quint64 generation = ++currentGeneration;
+    const QString fileName = path;
+    worker = QThread::create([this, fileName, document, revision, generation]() {
+        run(fileName, document, revision, generation);
+    });
+    worker->start();
+}
+
+bool FileReloader::isRunning() const {
+    return running;
+}
+
+void FileReloader::run(const QString &fileName, const PieceTable &document, qint64 revision, quint64 generation) { // runs on the worker thread
+    auto post = [this, generation](auto function) { // hands the result over to the gui thread, unless a newer reload has started in the meantime
+        QMetaObject::invokeMethod(this, [this, generation, function]() {
+            if (generation == currentGeneration) {
+                running = false;
+                function();
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    ScopedTimer timer("reload");
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QString error = tr("Kann nicht öffnen: %1").arg(file.errorString());
+        post([this, error]() {
+            emit failed(error);
+        });
+        return;
+    }
+    std::unique_ptr<TextDecoder> decoder; // same detection and line ends as the file loader
+    QString text;
+    text.reserve(file.size());
+    try {
+        CompressedReader reader(&file, Compression::detect(file)); // a compressed file is compared by its content
+        while (!canceledFlag && !reader.atEnd()) {
+            QByteArray bytes = reader.read(1024 * 1024);
+            if (!decoder) {
+                decoder = std::make_unique<TextDecoder>(bytes);
+            }
+            text += decoder->decode(bytes);
+        }
+        if (decoder) {
+            text += decoder->finish();
+        }
+    } catch (const std::exception &e) {
+        QString error = QString::fromUtf8(e.what());
+        post([this, error]() {
+            emit failed(error);
+        });
+        return;
+    }
+    if (canceledFlag) {
+        return;
+    }
+
+    const QString current = document.toString();
+    QList<TextDiff::Edit> edits = TextDiff::diff(current, text);
+    const TextCodec::Format format = decoder ? decoder->format() : TextCodec::Format();
+    const bool invalidBytes = decoder && decoder->hasError();
+    post([this, edits, revision, format, invalidBytes]() {
+        emit reloaded(edits, revision, format, invalidBytes);
+    });
+}
+
+void FileReloader::stop() { // drops a running reload and waits for the worker
+    canceledFlag = true;
+    if (worker) {
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+    ++currentGeneration;
+    running = false;
+}
@@ -0,0 +1,61 @@
+#ifndef FILERELOADER_H
+#define FILERELOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <atomic>
+#include "piecetable.h"
+#include "textdiff.h"
+#include "textcodec.h"
+
+// notices when another program rewrites the open file and works out on a worker thread which ranges of the document changed,
+// applying only those keeps the cursor, the scroll position and the undo history. the worker reads the whole file and
+// flattens the snapshot for the diff, so a reload costs o(file) on the worker (about 0.5 s per 40 mb), only applying
+// the edits on the gui thread is o(changes)
+class FileReloader : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit FileReloader(QObject *parent = nullptr);
+        ~FileReloader();
+
+        static constexpr int settleDelay = 200; // ms, programs often write a file in several steps or replace it by renaming
+        static constexpr int pollInterval = 1000; // ms, while the file is gone
+
+        void watch(const QString &fileName); // the file as it is on disk now counts as known
+        void unwatch();
+        void reload(const PieceTable &document, qint64 revision);
+        void stop();
+        bool isRunning() const;
+
+    signals:
+        void changedOnDisk();
+        void removedFromDisk();
+        void reloaded(const QList<TextDiff::Edit> &edits, qint64 revision, const TextCodec::Format &format, bool invalidBytes); // revision of the document the edits were computed for, format of the file as it is now
+        void failed(const QString &error);
+
+    private slots:
+        void fileChanged();
+        void checkFile();
+
+    private:
+        void run(const QString &fileName, const PieceTable &document, qint64 revision, quint64 generation);
+
+        QString path;
+        QFileSystemWatcher watcher;
+        QTimer settleTimer;
+        QDateTime knownModified; // together with the size this tells our own saves apart from changes by other programs
+        qint64 knownSize;
+        bool removed;
+        QThread *worker;
+        std::atomic<bool> canceledFlag;
+        quint64 currentGeneration;
+        bool running;
+};
+
+#endif // FILERELOADER_H
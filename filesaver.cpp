@@ -0,0 +1,105 @@
+#include "filesaver.h"
+#include "profiler.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QMetaObject>
+#include <stdexcept>
+
+FileSaver::FileSaver(QObject *parent): QObject(parent), worker(nullptr), succeeded(false), pendingSaves(0) { // constructor
+}
+
+FileSaver::~FileSaver() {
+    waitForFinished(); // a running save is always completed, never dropped
+}
+
+void FileSaver::save(const QString &fileName, const PieceTable &text, const TextCodec::Format &textFormat, Compression::Format format) { // text is a snapshot of the piece table, the worker never copies it as a whole
+    start(fileName, QIODevice::WriteOnly, [this, text, textFormat, format](QSaveFile &file) { // the encoder writes the line ends, never text mode
+        TextEncoder encoder(textFormat); // keeps surrogate pairs that are split between two chunks
+        CompressedWriter writer(&file, format); // compresses chunk by chunk, the whole compressed file is never in memory
+        const qint64 total = text.size();
+        for (qsizetype position = 0; position < text.size(); position += chunkSize) {
+            writer.write(encoder.encode(text.mid(position, chunkSize))); // only one chunk is read out and encoded at a time
+            if (encoder.hasError()) { // only latin-1 lacks characters, the original file stays as it was rather than losing them
+                throw std::runtime_error("Kann nicht speichern: der Text enthält Zeichen, die es in Latin-1 nicht gibt");
+            }
+            qint64 done = qMin<qint64>(position + chunkSize, total);
+            QMetaObject::invokeMethod(this, [this, done, total]() {
+                emit progress(done, total);
+            }, Qt::QueuedConnection);
+        }
+        writer.write(encoder.finish());
+        writer.finish();
+    });
+}
+
+void FileSaver::copy(const QString &sourceFileName, const QString &fileName, Compression::Format format) { // streams an unchanged file to a new place, e.g. from the viewer
+    start(fileName, QIODevice::WriteOnly, [this, sourceFileName, format](QSaveFile &file) {
+        QFile source(sourceFileName);
+        if (!source.open(QIODevice::ReadOnly)) {
+            throw std::runtime_error("Kann nicht öffnen: " + source.errorString().toStdString());
+        }
+        CompressedWriter writer(&file, format);
+        const qint64 total = source.size();
+        qint64 done = 0;
+        while (!source.atEnd()) {
+            QByteArray bytes = source.read(4 * chunkSize);
+            if (bytes.isEmpty()) {
+                if (source.error() != QFileDevice::NoError) {
+                    throw std::runtime_error("Kann nicht einlesen: " + source.errorString().toStdString());
+                }
+                break;
+            }
+            writer.write(bytes);
+            done += bytes.size();
+            QMetaObject::invokeMethod(this, [this, done, total]() {
+                emit progress(done, total);
+            }, Qt::QueuedConnection);
+        }
+        writer.finish();
+    });
+}
+
+bool FileSaver::waitForFinished() { // blocks until the running save is done, returns whether it succeeded
+    if (worker) {
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+    return succeeded;
+}
+
+bool FileSaver::isRunning() const { // true until finished or failed has been emitted
+    return pendingSaves > 0;
+}
+
+void FileSaver::start(const QString &fileName, QIODevice::OpenMode mode, std::function<void(QSaveFile &)> job) {
+    waitForFinished(); // saves are written one after the other
+    ++pendingSaves;
+    succeeded = false;
+    worker = QThread::create([this, fileName, mode, job]() {
+        QSaveFile file(fileName); // writes into a temporary file next to the target
+        try {
+            ScopedTimer timer("fileSave"); // encoding, writing and the sync of commit
+            if (!file.open(mode)) {
+                throw std::runtime_error("Kann nicht speichern: " + file.errorString().toStdString());
+            }
+            job(file);
+            if (!file.commit()) { // flushes, syncs to disk and renames the temporary file over the target
+                throw std::runtime_error("Kann nicht speichern: " + file.errorString().toStdString());
+            }
+            succeeded = true;
+            QMetaObject::invokeMethod(this, [this, fileName]() {
+                --pendingSaves;
+                emit finished(fileName);
+            }, Qt::QueuedConnection);
+        } catch (const std::exception &e) {
+            file.cancelWriting(); // the target stays untouched, the temporary file is removed
+            QString error = QString::fromUtf8(e.what());
+            QMetaObject::invokeMethod(this, [this, error]() {
+                --pendingSaves;
+                emit failed(error);
+            }, Qt::QueuedConnection);
+        }
+    });
+    worker->start();
+}
@@ -0,0 +1,44 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QIODevice>
+#include <atomic>
+#include <functional>
+#include "piecetable.h"
+#include "compressedstream.h"
+#include "textcodec.h"
+
+class QSaveFile;
+
+// encodes, compresses if asked to and writes a snapshot of the document on a worker thread into a temporary file that replaces the target at the end
+class FileSaver : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit FileSaver(QObject *parent = nullptr);
+        ~FileSaver();
+
+        static constexpr qsizetype chunkSize = 1024 * 1024; // characters encoded and written per step
+
+        void save(const QString &fileName, const PieceTable &text, const TextCodec::Format &textFormat, Compression::Format format);
+        void copy(const QString &sourceFileName, const QString &fileName, Compression::Format format);
+        bool waitForFinished();
+        bool isRunning() const;
+
+    signals:
+        void progress(qint64 done, qint64 total);
+        void finished(const QString &fileName);
+        void failed(const QString &error);
+
+    private:
+        void start(const QString &fileName, QIODevice::OpenMode mode, std::function<void(QSaveFile &)> job);
+
+        QThread *worker;
+        std::atomic<bool> succeeded;
+        int pendingSaves;
+};
+
+#endif // FILESAVER_H
@@ -0,0 +1,273 @@
+#include "finddialog.h"
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QColor>
+#include <QApplication>
+#include <QMetaObject>
+#include <QtConcurrent>
+
+namespace {
+constexpr int highlightDelay = 30; // scrolling and typing are collected before the visible matches are searched again
+constexpr int countDelay = 300; // the background count waits a bit longer, it covers the whole text
+}
+
+FindDialog::FindDialog(QPlainTextEdit *textEdit, ChangeTracker *tracker, UndoEngine *undoEngine, QWidget *parent): QDialog(parent), textEdit(textEdit), tracker(tracker), undoEngine(undoEngine), findEdit(new QLineEdit(this)), replaceEdit(new QLineEdit(this)), regexBox(new QCheckBox(tr("Regulärer Ausdruck"), this)), caseBox(new QCheckBox(tr("Groß-/Kleinschreibung beachten"), this)), statusLabel(new QLabel(this)), countGeneration(0) { // constructor
+    setWindowTitle(tr("Suchen/Ersetzen"));
+    setModal(false); // the editor stays usable while the dialog is open
+
+    auto *layout = new QGridLayout(this);
+    layout->addWidget(new QLabel(tr("Suchen:"), this), 0, 0);
+    layout->addWidget(findEdit, 0, 1);
+    layout->addWidget(new QLabel(tr("Ersetzen durch:"), this), 1, 0);
+    layout->addWidget(replaceEdit, 1, 1);
+    auto *options = new QHBoxLayout();
+    options->addWidget(regexBox);
+    options->addWidget(caseBox);
+    layout->addLayout(options, 2, 1);
+    layout->addWidget(statusLabel, 3, 0, 1, 2);
+
+    auto *buttons = new QVBoxLayout();
+    QPushButton *nextButton = new QPushButton(tr("Weitersuchen"), this);
+    QPushButton *previousButton = new QPushButton(tr("Zurück"), this);
+    QPushButton *replaceButton = new QPushButton(tr("Ersetzen"), this);
+    QPushButton *replaceAllButton = new QPushButton(tr("Alle ersetzen"), this);
+    QPushButton *closeButton = new QPushButton(tr("Schließen"), this);
+    nextButton->setDefault(true); // enter searches forward
+    buttons->addWidget(nextButton);
+    buttons->addWidget(previousButton);
+    buttons->addWidget(replaceButton);
+    buttons->addWidget(replaceAllButton);
+    buttons->addStretch();
+    buttons->addWidget(closeButton);
+    layout->addLayout(buttons, 0, 2, 4, 1);
+
+    connect(nextButton, &QPushButton::clicked, this, &FindDialog::findNext);
+    connect(previousButton, &QPushButton::clicked, this, &FindDialog::findPrevious);
+    connect(replaceButton, &QPushButton::clicked, this, &FindDialog::replace);
+    connect(replaceAllButton, &QPushButton::clicked, this, &FindDialog::replaceAll);
+    connect(closeButton, &QPushButton::clicked, this, &FindDialog::hide);
+    connect(findEdit, &QLineEdit::textChanged, this, &FindDialog::optionsChanged);
+    connect(regexBox, &QCheckBox::toggled, this, &FindDialog::optionsChanged);
+    connect(caseBox, &QCheckBox::toggled, this, &FindDialog::optionsChanged);
+
+    highlightTimer.setSingleShot(true);
+    highlightTimer.setInterval(highlightDelay);
+    connect(&highlightTimer, &QTimer::timeout, this, &FindDialog::highlightVisible);
+    countTimer.setSingleShot(true);
+    countTimer.setInterval(countDelay);
+    connect(&countTimer, &QTimer::timeout, this, &FindDialog::startCount);
+
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &FindDialog::scheduleHighlight); // only what is on screen gets highlighted, so scrolling searches again
+    connect(textEdit->verticalScrollBar(), &QScrollBar::rangeChanged, this, &FindDialog::scheduleHighlight);
+    connect(tracker, &ChangeTracker::textEdited, this, [this]() {
+        scheduleHighlight();
+        scheduleCount();
+    });
+}
+
+FindDialog::~FindDialog() {
+    cancelCount();
+    counting.waitForFinished(); // the count reads the engine and the text snapshot until it is done
+}
+
+void FindDialog::activate() { // opens the dialog with the selected text as search term
+    QString selected = textEdit->textCursor().selectedText();
+    if (!selected.isEmpty() && !selected.contains(QChar::ParagraphSeparator)) { // multi-line selections are no useful search term
+        findEdit->setText(regexBox->isChecked() ? QRegularExpression::escape(selected) : selected);
+    }
+    show();
+    raise();
+    activateWindow();
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void FindDialog::findNext() { // searches forward from the cursor and wraps around at the end
+    if (!ready()) {
+        return;
+    }
+    const QString text = tracker->text(); // flattened at most once between two edits
+    SearchMatch match = engine->findNext(text, textEdit->textCursor().selectionEnd());
+    if (!match.isValid()) {
+        match = engine->findNext(text, 0);
+    }
+    select(match);
+}
+
+void FindDialog::findPrevious() { // searches backward from the cursor and wraps around at the start
+    if (!ready()) {
+        return;
+    }
+    const QString text = tracker->text(); // flattened at most once between two edits
+    SearchMatch match = engine->findPrevious(text, textEdit->textCursor().selectionStart());
+    if (!match.isValid()) {
+        match = engine->findPrevious(text, text.size());
+    }
+    select(match);
+}
+
+void FindDialog::replace() { // replaces the selected match and moves on to the next one
+    if (!ready() || textEdit->isReadOnly()) {
+        return;
+    }
+    QTextCursor cursor = textEdit->textCursor();
+    const QString text = tracker->text(); // flattened at most once between two edits
+    SearchMatch match = engine->findNext(text, cursor.selectionStart());
+    if (cursor.hasSelection() && match.position == cursor.selectionStart() && match.end() == cursor.selectionEnd()) { // only a selection that is a match is replaced
+        QString replacement = engine->replacement(text, match, replaceEdit->text());
+        undoEngine->breakGroup(); // every replacement is its own undo step
+        cursor.insertText(replacement);
+        undoEngine->breakGroup();
+        textEdit->setTextCursor(cursor);
+    }
+    findNext();
+}
+
+void FindDialog::replaceAll() { // all matches are replaced by one edit over the range they span, so it is a single undo step
+    if (!ready() || textEdit->isReadOnly()) {
+        return;
+    }
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const QString text = tracker->text(); // shared snapshot, the threads must not see the edit below
+    QVector<SearchMatch> matches = engine->findAllParallel(text);
+    if (matches.isEmpty()) {
+        QApplication::restoreOverrideCursor();
+        statusLabel->setText(tr("Nicht gefunden"));
+        return;
+    }
+    QString replaced = engine->replaceAllParallel(text, matches, replaceEdit->text());
+
+    QTextCursor cursor(textEdit->document());
+    cursor.setPosition(int(matches.first().position));
+    cursor.setPosition(int(matches.last().end()), QTextCursor::KeepAnchor);
+    undoEngine->beginTransaction();
+    if (replaced.isEmpty()) {
+        cursor.removeSelectedText();
+    } else {
+        cursor.insertText(replaced);
+    }
+    undoEngine->endTransaction();
+    QApplication::restoreOverrideCursor();
+    statusLabel->setText(tr("%1 Treffer ersetzt").arg(matches.size()));
+}
+
+void FindDialog::showEvent(QShowEvent *event) {
+    QDialog::showEvent(event);
+    optionsChanged();
+}
+
+void FindDialog::hideEvent(QHideEvent *event) { // the highlighting disappears together with the dialog
+    QDialog::hideEvent(event);
+    highlightTimer.stop();
+    countTimer.stop();
+    cancelCount();
+    textEdit->setExtraSelections({});
+}
+
+void FindDialog::optionsChanged() { // the engine is rebuilt once per change of the search term or the options
+    SearchOptions options;
+    options.pattern = findEdit->text();
+    options.regex = regexBox->isChecked();
+    options.caseSensitive = caseBox->isChecked();
+    engine = QSharedPointer<const SearchEngine>::create(options);
+    statusLabel->setText(options.pattern.isEmpty() ? QString() : engine->errorString());
+    highlightVisible();
+    startCount();
+}
+
+void FindDialog::scheduleHighlight() {
+    if (isVisible()) {
+        highlightTimer.start();
+    }
+}
+
+void FindDialog::scheduleCount() {
+    if (isVisible()) {
+        cancelCount(); // the running count is for an outdated text
+        countTimer.start();
+    }
+}
+
+void FindDialog::highlightVisible() { // searches only the lines between the top and the bottom of the viewport
+    QList<QTextEdit::ExtraSelection> selections;
+    if (isVisible() && engine && engine->isValid()) {
+        QTextDocument *document = textEdit->document();
+        QWidget *viewport = textEdit->viewport();
+        QTextBlock first = document->findBlock(textEdit->cursorForPosition(QPoint(0, 0)).position());
+        QTextBlock last = document->findBlock(textEdit->cursorForPosition(QPoint(viewport->width(), viewport->height())).position());
+        QTextCharFormat format;
+        format.setBackground(QColor(255, 200, 0, 140)); // readable on both the light and the dark palette
+        const qsizetype from = first.position();
+        const QString window = tracker->table().mid(from, last.position() + last.length() - from); // only the visible lines are read out of the piece table
+        for (const SearchMatch &match : engine->findAll(window, 0, window.size())) {
+            QTextEdit::ExtraSelection selection;
+            selection.cursor = QTextCursor(document);
+            selection.cursor.setPosition(int(from + match.position));
+            selection.cursor.setPosition(int(from + match.end()), QTextCursor::KeepAnchor);
+            selection.format = format;
+            selections.append(selection);
+        }
+    }
+    textEdit->setExtraSelections(selections);
+}
+
+void FindDialog::startCount() { // counts all matches on the thread pool, the result arrives later in the status label
+    cancelCount();
+    if (!isVisible() || !engine || !engine->isValid()) {
+        return;
+    }
+    statusLabel->setText(tr("Treffer werden gezählt..."));
+    const quint64 generation = ++countGeneration;
+    countCanceled = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> canceled = countCanceled;
+    QSharedPointer<const SearchEngine> searchEngine = engine;
+    const PieceTable snapshot = tracker->table(); // o(1) snapshot, edits meanwhile don't touch it
+    counting = QtConcurrent::run([this, searchEngine, snapshot, canceled, generation]() {
+        qsizetype count = searchEngine->countParallel(snapshot.toString(), canceled.get()); // flattened on the pool thread, not on the gui thread
+        if (*canceled) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, count, generation]() {
+            if (generation != countGeneration) { // a newer count was started in the meantime
+                return;
+            }
+            statusLabel->setText(count > 0 ? tr("%1 Treffer").arg(count) : tr("Nicht gefunden"));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void FindDialog::cancelCount() {
+    if (countCanceled) {
+        *countCanceled = true;
+    }
+    ++countGeneration;
+}
+
+void FindDialog::select(const SearchMatch &match) { // selects the match and scrolls it into view
+    if (!match.isValid()) {
+        statusLabel->setText(tr("Nicht gefunden"));
+        return;
+    }
+    QTextCursor cursor(textEdit->document());
+    cursor.setPosition(int(match.position));
+    cursor.setPosition(int(match.end()), QTextCursor::KeepAnchor);
+    textEdit->setTextCursor(cursor);
+    textEdit->ensureCursorVisible();
+}
+
+bool FindDialog::ready() { // the engine exists once the dialog was shown, an invalid term is reported instead of searched
+    if (!engine) {
+        optionsChanged();
+    }
+    if (!engine->isValid()) {
+        statusLabel->setText(engine->errorString());
+        return false;
+    }
+    return true;
+}
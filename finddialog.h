@@ -0,0 +1,63 @@
+#ifndef FINDDIALOG_H
+#define FINDDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QTimer>
+#include <QFuture>
+#include <QSharedPointer>
+#include <atomic>
+#include <memory>
+#include "changetracker.h"
+#include "undoengine.h"
+#include "searchengine.h"
+
+// find/replace window, highlights the matches in the visible part of the editor and counts the rest in the background
+class FindDialog : public QDialog {
+    Q_OBJECT
+
+    public:
+        FindDialog(QPlainTextEdit *textEdit, ChangeTracker *tracker, UndoEngine *undoEngine, QWidget *parent = nullptr);
+        ~FindDialog();
+
+    public slots:
+        void activate();
+        void findNext();
+        void findPrevious();
+        void replace();
+        void replaceAll();
+
+    protected:
+        void showEvent(QShowEvent *event) override;
+        void hideEvent(QHideEvent *event) override;
+
+    private:
+        void optionsChanged();
+        void scheduleHighlight();
+        void scheduleCount();
+        void highlightVisible();
+        void startCount();
+        void cancelCount();
+        void select(const SearchMatch &match);
+        bool ready();
+
+        QPlainTextEdit *textEdit;
+        ChangeTracker *tracker;
+        UndoEngine *undoEngine;
+        QLineEdit *findEdit;
+        QLineEdit *replaceEdit;
+        QCheckBox *regexBox;
+        QCheckBox *caseBox;
+        QLabel *statusLabel;
+        QTimer highlightTimer;
+        QTimer countTimer;
+        QSharedPointer<const SearchEngine> engine;
+        QFuture<void> counting;
+        std::shared_ptr<std::atomic<bool>> countCanceled;
+        quint64 countGeneration;
+};
+
+#endif // FINDDIALOG_H
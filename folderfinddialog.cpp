@@ -0,0 +1,269 @@
+#include "folderfinddialog.h"
+#include "profiler.h"
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QtConcurrent>
+#include <QUuid>
+
+namespace {
+constexpr int searchDelay = 150; // typing is collected before the index is asked, a search takes milliseconds but reads the hits from disk
+}
+
+FolderFindDialog::FolderFindDialog(QWidget *parent): QDialog(parent), folderEdit(new QLineEdit(this)), findEdit(new QLineEdit(this)), caseBox(new QCheckBox(tr("Groß-/Kleinschreibung beachten"), this)), hitList(new QTreeWidget(this)), statusLabel(new QLabel(this)), indexLabel(new QLabel(this)), updater(nullptr), updateGeneration(0), searchGeneration(0) { // constructor
+    setWindowTitle(tr("In Ordner suchen"));
+    setModal(false); // the editor stays usable while the dialog is open
+    resize(700, 450);
+
+    folderEdit->setReadOnly(true);
+    hitList->setColumnCount(3);
+    hitList->setHeaderLabels({tr("Datei"), tr("Zeile"), tr("Text")});
+    hitList->setRootIsDecorated(false);
+    hitList->setUniformRowHeights(true); // thousands of hits are laid out without measuring every row
+    hitList->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    hitList->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+
+    auto *layout = new QGridLayout(this);
+    layout->addWidget(new QLabel(tr("Ordner:"), this), 0, 0);
+    layout->addWidget(folderEdit, 0, 1);
+    QPushButton *folderButton = new QPushButton(tr("Ordner wählen..."), this);
+    layout->addWidget(folderButton, 0, 2);
+    layout->addWidget(new QLabel(tr("Suchen:"), this), 1, 0);
+    layout->addWidget(findEdit, 1, 1, 1, 2);
+    layout->addWidget(caseBox, 2, 1, 1, 2);
+    layout->addWidget(hitList, 3, 0, 1, 3);
+    auto *status = new QHBoxLayout();
+    status->addWidget(statusLabel, 1);
+    status->addWidget(indexLabel);
+    QPushButton *closeButton = new QPushButton(tr("Schließen"), this);
+    status->addWidget(closeButton);
+    layout->addLayout(status, 4, 0, 1, 3);
+
+    connect(folderButton, &QPushButton::clicked, this, &FolderFindDialog::chooseFolder);
+    connect(closeButton, &QPushButton::clicked, this, &FolderFindDialog::hide);
+    connect(findEdit, &QLineEdit::textChanged, this, &FolderFindDialog::scheduleSearch);
+    connect(findEdit, &QLineEdit::returnPressed, this, &FolderFindDialog::startSearch);
+    connect(caseBox, &QCheckBox::toggled, this, &FolderFindDialog::startSearch);
+    connect(hitList, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem *item) {
+        emit hitActivated(item->data(0, Qt::UserRole).toString(), item->data(1, Qt::UserRole).toLongLong());
+    });
+
+    searchTimer.setSingleShot(true);
+    searchTimer.setInterval(searchDelay);
+    connect(&searchTimer, &QTimer::timeout, this, &FolderFindDialog::startSearch);
+}
+
+FolderFindDialog::~FolderFindDialog() {
+    stopUpdate(); // the worker must not outlive the dialog
+    cancelSearch();
+    searching.waitForFinished(); // the search reads the index until it is done
+}
+
+void FolderFindDialog::activate(const QString &startFolder) { // the first time it starts in the given folder, every time the index is brought up to date
+    if (folder.isEmpty()) {
+        setFolder(startFolder.isEmpty() ? QDir::homePath() : startFolder);
+    } else {
+        startUpdate();
+    }
+    show();
+    raise();
+    activateWindow();
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void FolderFindDialog::chooseFolder() {
+    QString chosen = QFileDialog::getExistingDirectory(this, tr("Ordner wählen"), folder);
+    if (!chosen.isEmpty()) {
+        setFolder(chosen);
+    }
+}
+
+void FolderFindDialog::setFolder(const QString &path) {
+    stopUpdate(); // an update of the previous folder is of no use anymore
+    cancelSearch();
+    searching.waitForFinished();
+    folder = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+    folderEdit->setText(QDir::toNativeSeparators(folder));
+    hitList->clear();
+    openIndex();
+    startUpdate();
+    startSearch(); // the index of the last session answers right away, the update only brings in what changed since then
+}
+
+void FolderFindDialog::openIndex() { // a broken index is removed, the next update builds it from scratch
+    auto opened = std::make_shared<TrigramIndex>();
+    const QString indexFile = TrigramIndex::indexFileName(folder);
+    try {
+        opened->open(folder, indexFile);
+    } catch (const std::exception &) {
+        QFile::remove(indexFile);
+    }
+    index = opened;
+    indexLabel->setText(index->isOpen() ? tr("%1 Dateien im Index").arg(index->fileCount()) : tr("Index wird erstellt..."));
+}
+
+void FolderFindDialog::startUpdate() { // crawls the folder on a worker thread, only new and changed files are read again
+    if (updater) { // the running update will do
+        return;
+    }
+    const QString target = TrigramIndex::indexFileName(folder) + QLatin1Char('.') + QUuid::createUuid().toString(QUuid::WithoutBraces) + QLatin1String(".tmp"); // the index in use stays mapped until the new one is complete, other windows may build the same index at the same time
+    QDir().mkpath(QFileInfo(target).absolutePath());
+    const quint64 generation = ++updateGeneration;
+    updateCanceled = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> canceled = updateCanceled;
+    std::shared_ptr<const TrigramIndex> previous = index; // kept alive by the worker even if the dialog switches to another index
+    const QString root = folder;
+    updater = QThread::create([this, root, previous, target, canceled, generation]() {
+        ScopedTimer timer("folderIndex");
+        QString built;
+        std::string error;
+        try {
+            if (TrigramIndex::build(root, previous.get(), target, canceled.get(), [this, generation](qint64 done, qint64 total) {
+                QMetaObject::invokeMethod(this, [this, generation, done, total]() {
+                    if (generation == updateGeneration) {
+                        indexLabel->setText(tr("Index wird aktualisiert... %1 von %2 Dateien").arg(done).arg(total));
+                    }
+                }, Qt::QueuedConnection);
+            })) {
+                built = target;
+            }
+        } catch (const std::exception &e) {
+            QFile::remove(target); // a half written index
+            error = e.what();
+        }
+        if (*canceled) {
+            if (!built.isEmpty()) {
+                QFile::remove(built);
+            }
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, generation, built, error]() {
+            if (generation != updateGeneration) { // the folder was changed in the meantime
+                if (!built.isEmpty()) {
+                    QFile::remove(built);
+                }
+                return;
+            }
+            finishUpdate(built);
+            if (!error.empty()) {
+                indexLabel->setText(QString::fromUtf8(error.c_str()));
+            }
+        }, Qt::QueuedConnection);
+    });
+    updater->start();
+}
+
+void FolderFindDialog::stopUpdate() { // drops a running update and waits for the worker
+    if (updateCanceled) {
+        *updateCanceled = true;
+    }
+    if (updater) {
+        updater->wait();
+        delete updater;
+        updater = nullptr;
+    }
+    ++updateGeneration;
+}
+
+void FolderFindDialog::finishUpdate(const QString &built) { // the new index replaces the old one, an empty name means nothing changed
+    updater->wait();
+    delete updater; // releases the previous index the worker held on to
+    updater = nullptr;
+    if (built.isEmpty()) {
+        indexLabel->setText(index->isOpen() ? tr("%1 Dateien im Index").arg(index->fileCount()) : QString());
+        return;
+    }
+    cancelSearch();
+    searching.waitForFinished();
+    index.reset(); // unmapped before it is replaced, windows doesn't rename over a mapped file
+    const QString indexFile = TrigramIndex::indexFileName(folder);
+    QFile::remove(indexFile);
+    if (!QFile::rename(built, indexFile)) { // e.g. another window renamed its own build there first, the next update tries again
+        QFile::remove(built);
+        openIndex();
+        indexLabel->setText(tr("Kann Index nicht ersetzen: %1").arg(QDir::toNativeSeparators(indexFile)));
+        return;
+    }
+    openIndex();
+    startSearch(); // hits in files that changed meanwhile are found now
+}
+
+void FolderFindDialog::scheduleSearch() {
+    cancelSearch(); // the running search is for an outdated term
+    searchTimer.start();
+}
+
+void FolderFindDialog::startSearch() { // asks the index on the thread pool, the hits arrive later in the list
+    searchTimer.stop();
+    cancelSearch();
+    const QString term = findEdit->text();
+    if (term.isEmpty() || !index || !index->isOpen()) {
+        hitList->clear();
+        statusLabel->clear();
+        return;
+    }
+    statusLabel->setText(tr("Suche..."));
+    const quint64 generation = ++searchGeneration;
+    searchCanceled = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> canceled = searchCanceled;
+    std::shared_ptr<const TrigramIndex> searched = index;
+    const bool caseSensitive = caseBox->isChecked();
+    searching = QtConcurrent::run([this, searched, term, caseSensitive, canceled, generation]() {
+        ScopedTimer timer("folderSearch");
+        QElapsedTimer elapsed;
+        elapsed.start();
+        QVector<FolderHit> hits = searched->search(term, caseSensitive, canceled.get());
+        if (*canceled) {
+            return;
+        }
+        const qint64 milliseconds = elapsed.elapsed();
+        QMetaObject::invokeMethod(this, [this, hits, milliseconds, generation]() {
+            if (generation != searchGeneration) { // a newer search was started in the meantime
+                return;
+            }
+            showHits(hits, milliseconds);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void FolderFindDialog::cancelSearch() {
+    if (searchCanceled) {
+        *searchCanceled = true;
+    }
+    ++searchGeneration;
+}
+
+void FolderFindDialog::showHits(const QVector<FolderHit> &hits, qint64 elapsed) {
+    hitList->setUpdatesEnabled(false); // one repaint for all rows
+    hitList->clear();
+    const QDir root(folder);
+    QList<QTreeWidgetItem *> items;
+    items.reserve(hits.size());
+    qsizetype fileCount = 0;
+    for (qsizetype i = 0; i < hits.size(); ++i) {
+        const FolderHit &hit = hits.at(i);
+        if (i == 0 || hits.at(i - 1).fileName != hit.fileName) { // hits of a file come one after another
+            ++fileCount;
+        }
+        auto *item = new QTreeWidgetItem(QStringList{QDir::toNativeSeparators(root.relativeFilePath(hit.fileName)), QString::number(hit.line), hit.text});
+        item->setData(0, Qt::UserRole, hit.fileName);
+        item->setData(1, Qt::UserRole, hit.line);
+        items.append(item);
+    }
+    hitList->addTopLevelItems(items);
+    hitList->setUpdatesEnabled(true);
+    if (hits.isEmpty()) {
+        statusLabel->setText(tr("Nicht gefunden (%1 ms)").arg(elapsed));
+    } else if (hits.size() >= TrigramIndex::maxHits) {
+        statusLabel->setText(tr("%1 Treffer, weitere werden nicht gezeigt (%2 ms)").arg(hits.size()).arg(elapsed));
+    } else {
+        statusLabel->setText(tr("%1 Treffer in %2 Dateien (%3 ms)").arg(hits.size()).arg(fileCount).arg(elapsed));
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef FOLDERFINDDIALOG_H
+#define FOLDERFINDDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QCheckBox>
+#include <QLabel>
+#include <QTreeWidget>
+#include <QThread>
+#include <QTimer>
+#include <QFuture>
+#include <atomic>
+#include <memory>
+#include "trigramindex.h"
+
+// searches all files below a folder through its trigram index, the index is brought up to date in the background every
+// time the dialog is opened, searches meanwhile use the previous one
+class FolderFindDialog : public QDialog {
+    Q_OBJECT
+
+    public:
+        explicit FolderFindDialog(QWidget *parent = nullptr);
+        ~FolderFindDialog();
+
+    public slots:
+        void activate(const QString &startFolder);
+
+    signals:
+        void hitActivated(const QString &fileName, qint64 line);
+
+    private:
+        void chooseFolder();
+        void setFolder(const QString &path);
+        void openIndex();
+        void startUpdate();
+        void stopUpdate();
+        void finishUpdate(const QString &built);
+        void scheduleSearch();
+        void startSearch();
+        void cancelSearch();
+        void showHits(const QVector<FolderHit> &hits, qint64 elapsed);
+
+        QLineEdit *folderEdit;
+        QLineEdit *findEdit;
+        QCheckBox *caseBox;
+        QTreeWidget *hitList;
+        QLabel *statusLabel;
+        QLabel *indexLabel;
+        QTimer searchTimer;
+        QString folder;
+        std::shared_ptr<TrigramIndex> index;
+        QThread *updater;
+        std::shared_ptr<std::atomic<bool>> updateCanceled;
+        quint64 updateGeneration;
+        QFuture<void> searching;
+        std::shared_ptr<std::atomic<bool>> searchCanceled;
+        quint64 searchGeneration;
+};
+
+#endif // FOLDERFINDDIALOG_H
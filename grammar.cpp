@@ -0,0 +1,33 @@
+#include "grammar.h"
+#include "grammars.h"
+#include <vector>
+
+namespace {
+std::vector<std::unique_ptr<Grammar>> &registry() { // the built-in grammars are registered on first use
+    static std::vector<std::unique_ptr<Grammar>> grammars = []() {
+        std::vector<std::unique_ptr<Grammar>> builtIn;
+        builtIn.push_back(Grammars::cpp());
+        builtIn.push_back(Grammars::java());
+        builtIn.push_back(Grammars::javaScript());
+        builtIn.push_back(Grammars::python());
+        builtIn.push_back(Grammars::shell());
+        builtIn.push_back(Grammars::cmake());
+        builtIn.push_back(Grammars::ini());
+        return builtIn;
+    }();
+    return grammars;
+}
+}
+
+void Grammar::add(std::unique_ptr<Grammar> grammar) { // grammars added later win over the built-in ones for the same files
+    registry().insert(registry().begin(), std::move(grammar));
+}
+
+const Grammar *Grammar::forFile(const QString &fileName) { // nullptr if no grammar knows the file, it is shown without highlighting then
+    for (const std::unique_ptr<Grammar> &grammar : registry()) {
+        if (grammar->matches(fileName)) {
+            return grammar.get();
+        }
+    }
+    return nullptr;
+}
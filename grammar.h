@@ -0,0 +1,32 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <memory>
+
+struct HighlightSpan {
+    int start;
+    int length;
+    int style;
+};
+
+// a language for the highlighter, lines are lexed one by one and the state carries over from one line to the next
+class Grammar {
+    public:
+        enum Style { Keyword, Type, String, Comment, Number, Preprocessor, Key, Section, StyleCount };
+
+        virtual ~Grammar() = default;
+
+        virtual QString name() const = 0;
+        virtual bool matches(const QString &fileName) const = 0;
+        // spans of the line are appended, returns the state at the end of the line; 0 is the state at the start of the file,
+        // called on the highlighter thread as well, so it must not change anything
+        virtual int highlightLine(QStringView line, int state, QVector<HighlightSpan> &spans) const = 0;
+
+        static void add(std::unique_ptr<Grammar> grammar);
+        static const Grammar *forFile(const QString &fileName);
+};
+
+#endif // GRAMMAR_H
@@ -0,0 +1,338 @@
+#include "grammars.h"
+#include <QFileInfo>
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+enum LineState { Normal = 0, BlockComment = 1, TripleDouble = 2, TripleSingle = 3 };
+
+bool isIdentifierStart(QChar c) {
+    return c.isLetter() || c == QLatin1Char('_');
+}
+
+bool isIdentifierPart(QChar c) {
+    return c.isLetterOrNumber() || c == QLatin1Char('_');
+}
+
+qsizetype identifierEnd(QStringView line, qsizetype i) {
+    while (i < line.size() && isIdentifierPart(line.at(i))) {
+        ++i;
+    }
+    return i;
+}
+
+qsizetype numberEnd(QStringView line, qsizetype i) { // digits, hex, exponents, suffixes and separators in one go
+    while (i < line.size() && (line.at(i).isLetterOrNumber() || line.at(i) == QLatin1Char('.') || line.at(i) == QLatin1Char('\''))) {
+        ++i;
+    }
+    return i;
+}
+
+qsizetype stringEnd(QStringView line, qsizetype i) { // position behind the closing quote, an unterminated string ends with the line
+    QChar quote = line.at(i++);
+    while (i < line.size()) {
+        if (line.at(i) == QLatin1Char('\\')) {
+            i += 2;
+        } else if (line.at(i++) == quote) {
+            return i;
+        }
+    }
+    return line.size();
+}
+
+void addSpan(QVector<HighlightSpan> &spans, qsizetype start, qsizetype end, int style) {
+    if (end > start) {
+        spans.append({int(start), int(end - start), style});
+    }
+}
+
+// keywords are kept sorted, so a word is looked up without allocating a string
+class WordGrammar : public Grammar {
+    public:
+        WordGrammar(const QString &name, const QStringList &suffixes, const QStringList &fileNames, QStringList keywords, QStringList types): grammarName(name), suffixes(suffixes), fileNames(fileNames), keywords(std::move(keywords)), types(std::move(types)) { // constructor
+            this->keywords.sort();
+            this->types.sort();
+        }
+
+        QString name() const override {
+            return grammarName;
+        }
+
+        bool matches(const QString &fileName) const override { // by suffix, or by the whole name for files like CMakeLists.txt
+            QFileInfo info(fileName);
+            return fileNames.contains(info.fileName(), Qt::CaseInsensitive) || suffixes.contains(info.suffix().toLower());
+        }
+
+    protected:
+        int wordStyle(QStringView word) const { // -1 for ordinary identifiers
+            auto less = [](QStringView a, QStringView b) { return a < b; };
+            if (std::binary_search(keywords.cbegin(), keywords.cend(), word, less)) {
+                return Keyword;
+            }
+            if (std::binary_search(types.cbegin(), types.cend(), word, less)) {
+                return Type;
+            }
+            return -1;
+        }
+
+        void addWord(QVector<HighlightSpan> &spans, QStringView line, qsizetype start, qsizetype end) const {
+            int style = wordStyle(line.sliced(start, end - start));
+            if (style >= 0) {
+                addSpan(spans, start, end, style);
+            }
+        }
+
+    private:
+        QString grammarName;
+        QStringList suffixes;
+        QStringList fileNames;
+        QStringList keywords;
+        QStringList types;
+};
+
+// c, c++, java, javascript and friends: // and /* */ comments, quoted strings, optionally # directives
+class CLikeGrammar : public WordGrammar {
+    public:
+        CLikeGrammar(const QString &name, const QStringList &suffixes, const QStringList &keywords, const QStringList &types, bool preprocessor, bool templateStrings): WordGrammar(name, suffixes, QStringList(), keywords, types), preprocessor(preprocessor), templateStrings(templateStrings) { // constructor
+        }
+
+        int highlightLine(QStringView line, int state, QVector<HighlightSpan> &spans) const override {
+            const qsizetype size = line.size();
+            qsizetype i = 0;
+            if (state == BlockComment) { // the comment of the previous line goes on
+                qsizetype end = line.indexOf(u"*/");
+                if (end < 0) {
+                    addSpan(spans, 0, size, Comment);
+                    return BlockComment;
+                }
+                addSpan(spans, 0, end + 2, Comment);
+                i = end + 2;
+            } else if (preprocessor) {
+                qsizetype first = 0;
+                while (first < size && line.at(first).isSpace()) {
+                    ++first;
+                }
+                if (first < size && line.at(first) == QLatin1Char('#')) { // the directive itself, its arguments are lexed as usual
+                    qsizetype end = first + 1;
+                    while (end < size && line.at(end).isSpace()) {
+                        ++end;
+                    }
+                    end = identifierEnd(line, end);
+                    addSpan(spans, first, end, Preprocessor);
+                    i = end;
+                }
+            }
+
+            while (i < size) {
+                QChar c = line.at(i);
+                if (c == QLatin1Char('/') && i + 1 < size && line.at(i + 1) == QLatin1Char('/')) {
+                    addSpan(spans, i, size, Comment);
+                    return Normal;
+                }
+                if (c == QLatin1Char('/') && i + 1 < size && line.at(i + 1) == QLatin1Char('*')) {
+                    qsizetype end = line.indexOf(u"*/", i + 2);
+                    if (end < 0) {
+                        addSpan(spans, i, size, Comment);
+                        return BlockComment;
+                    }
+                    addSpan(spans, i, end + 2, Comment);
+                    i = end + 2;
+                } else if (c == QLatin1Char('"') || c == QLatin1Char('\'') || (templateStrings && c == QLatin1Char('`'))) {
+                    qsizetype end = stringEnd(line, i);
+                    addSpan(spans, i, end, String);
+                    i = end;
+                } else if (c.isDigit()) {
+                    qsizetype end = numberEnd(line, i);
+                    addSpan(spans, i, end, Number);
+                    i = end;
+                } else if (isIdentifierStart(c)) {
+                    qsizetype end = identifierEnd(line, i);
+                    addWord(spans, line, i, end);
+                    i = end;
+                } else {
+                    ++i;
+                }
+            }
+            return Normal;
+        }
+
+    private:
+        bool preprocessor;
+        bool templateStrings;
+};
+
+// python, shell and cmake: # comments, quoted strings, optionally triple quotes and $variables
+class ScriptGrammar : public WordGrammar {
+    public:
+        ScriptGrammar(const QString &name, const QStringList &suffixes, const QStringList &fileNames, const QStringList &keywords, const QStringList &types, bool tripleQuotes, bool variables): WordGrammar(name, suffixes, fileNames, keywords, types), tripleQuotes(tripleQuotes), variables(variables) { // constructor
+        }
+
+        int highlightLine(QStringView line, int state, QVector<HighlightSpan> &spans) const override {
+            const qsizetype size = line.size();
+            qsizetype i = 0;
+            if (state == TripleDouble || state == TripleSingle) { // a docstring of the previous line goes on
+                qsizetype end = line.indexOf(state == TripleDouble ? u"\"\"\"" : u"'''");
+                if (end < 0) {
+                    addSpan(spans, 0, size, String);
+                    return state;
+                }
+                addSpan(spans, 0, end + 3, String);
+                i = end + 3;
+            }
+
+            while (i < size) {
+                QChar c = line.at(i);
+                if (c == QLatin1Char('#') && (!variables || i == 0 || line.at(i - 1).isSpace())) { // $# or a#b are no comments in a shell
+                    addSpan(spans, i, size, Comment);
+                    return Normal;
+                }
+                if (c == QLatin1Char('"') || c == QLatin1Char('\'')) {
+                    QStringView triple = line.sliced(i).first(qMin<qsizetype>(3, size - i));
+                    if (tripleQuotes && (triple == u"\"\"\"" || triple == u"'''")) {
+                        qsizetype end = line.indexOf(triple, i + 3);
+                        if (end < 0) {
+                            addSpan(spans, i, size, String);
+                            return c == QLatin1Char('"') ? TripleDouble : TripleSingle;
+                        }
+                        addSpan(spans, i, end + 3, String);
+                        i = end + 3;
+                        continue;
+                    }
+                    qsizetype end = stringEnd(line, i);
+                    addSpan(spans, i, end, String);
+                    i = end;
+                } else if (variables && c == QLatin1Char('$') && i + 1 < size) { // $name and ${name}
+                    qsizetype end = line.at(i + 1) == QLatin1Char('{') ? line.indexOf(QLatin1Char('}'), i) + 1 : identifierEnd(line, i + 1);
+                    if (end <= 0) {
+                        end = size;
+                    }
+                    addSpan(spans, i, qMax(end, i + 1), Type);
+                    i = qMax(end, i + 1);
+                } else if (!variables && c == QLatin1Char('@') && i + 1 < size && isIdentifierStart(line.at(i + 1))) { // python decorators
+                    qsizetype end = identifierEnd(line, i + 1);
+                    addSpan(spans, i, end, Preprocessor);
+                    i = end;
+                } else if (c.isDigit()) {
+                    qsizetype end = numberEnd(line, i);
+                    addSpan(spans, i, end, Number);
+                    i = end;
+                } else if (isIdentifierStart(c)) {
+                    qsizetype end = identifierEnd(line, i);
+                    addWord(spans, line, i, end);
+                    i = end;
+                } else {
+                    ++i;
+                }
+            }
+            return Normal;
+        }
+
+    private:
+        bool tripleQuotes;
+        bool variables;
+};
+
+// ini, conf and properties files: [sections], keys and ; or # comments, every line stands on its own
+class IniGrammar : public WordGrammar {
+    public:
+        IniGrammar(): WordGrammar(QStringLiteral("INI"), {QStringLiteral("ini"), QStringLiteral("conf"), QStringLiteral("cfg"), QStringLiteral("properties"), QStringLiteral("toml"), QStringLiteral("desktop")}, QStringList(), QStringList(), QStringList()) { // constructor
+        }
+
+        int highlightLine(QStringView line, int state, QVector<HighlightSpan> &spans) const override {
+            Q_UNUSED(state)
+            const qsizetype size = line.size();
+            qsizetype first = 0;
+            while (first < size && line.at(first).isSpace()) {
+                ++first;
+            }
+            if (first == size) {
+                return Normal;
+            }
+            QChar c = line.at(first);
+            if (c == QLatin1Char(';') || c == QLatin1Char('#')) {
+                addSpan(spans, first, size, Comment);
+            } else if (c == QLatin1Char('[')) {
+                qsizetype end = line.indexOf(QLatin1Char(']'), first);
+                addSpan(spans, first, end < 0 ? size : end + 1, Section);
+            } else {
+                qsizetype separator = first;
+                while (separator < size && line.at(separator) != QLatin1Char('=') && line.at(separator) != QLatin1Char(':')) {
+                    ++separator;
+                }
+                qsizetype keyEnd = separator;
+                while (keyEnd > first && line.at(keyEnd - 1).isSpace()) {
+                    --keyEnd;
+                }
+                addSpan(spans, first, keyEnd, Key);
+                qsizetype value = separator + 1;
+                while (value < size && line.at(value).isSpace()) {
+                    ++value;
+                }
+                if (value < size && (line.at(value) == QLatin1Char('"') || line.at(value) == QLatin1Char('\''))) {
+                    addSpan(spans, value, stringEnd(line, value), String);
+                } else if (value < size && (line.at(value).isDigit() || (line.at(value) == QLatin1Char('-') && value + 1 < size && line.at(value + 1).isDigit()))) {
+                    addSpan(spans, value, numberEnd(line, value + 1), Number);
+                }
+            }
+            return Normal;
+        }
+};
+
+}
+
+namespace Grammars {
+
+std::unique_ptr<Grammar> cpp() {
+    return std::make_unique<CLikeGrammar>(QStringLiteral("C++"),
+        QStringList{"c", "cc", "cpp", "cxx", "h", "hh", "hpp", "hxx", "ino"},
+        QStringList{"alignas", "alignof", "auto", "break", "case", "catch", "class", "const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default", "delete", "do", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "final", "for", "friend", "goto", "if", "inline", "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override", "private", "protected", "public", "register", "reinterpret_cast", "return", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union", "using", "virtual", "volatile", "while", "signals", "slots", "emit", "Q_OBJECT"},
+        QStringList{"bool", "char", "char8_t", "char16_t", "char32_t", "double", "float", "int", "long", "short", "signed", "unsigned", "void", "wchar_t", "size_t", "ptrdiff_t", "int8_t", "int16_t", "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "qint64", "quint64", "qsizetype"},
+        true, false);
+}
+
+std::unique_ptr<Grammar> java() {
+    return std::make_unique<CLikeGrammar>(QStringLiteral("Java"),
+        QStringList{"java", "kt", "kts", "cs", "scala", "groovy", "gradle"},
+        QStringList{"abstract", "assert", "break", "case", "catch", "class", "const", "continue", "default", "do", "else", "enum", "extends", "false", "final", "finally", "for", "fun", "goto", "if", "implements", "import", "instanceof", "interface", "native", "new", "null", "object", "override", "package", "private", "protected", "public", "record", "return", "sealed", "static", "super", "switch", "synchronized", "this", "throw", "throws", "transient", "true", "try", "val", "var", "volatile", "when", "while", "yield"},
+        QStringList{"boolean", "byte", "char", "double", "float", "int", "long", "short", "void", "String", "Object", "Integer", "Long", "Boolean"},
+        false, false);
+}
+
+std::unique_ptr<Grammar> javaScript() {
+    return std::make_unique<CLikeGrammar>(QStringLiteral("JavaScript"),
+        QStringList{"js", "mjs", "cjs", "jsx", "ts", "tsx", "json", "qml"},
+        QStringList{"as", "async", "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default", "delete", "do", "else", "export", "extends", "false", "finally", "for", "from", "function", "if", "import", "in", "instanceof", "interface", "let", "new", "null", "of", "property", "readonly", "return", "signal", "static", "super", "switch", "this", "throw", "true", "try", "type", "typeof", "undefined", "var", "void", "while", "with", "yield"},
+        QStringList{"any", "bigint", "boolean", "never", "number", "object", "string", "symbol", "unknown", "Array", "Map", "Promise", "Set"},
+        false, true);
+}
+
+std::unique_ptr<Grammar> python() {
+    return std::make_unique<ScriptGrammar>(QStringLiteral("Python"),
+        QStringList{"py", "pyw", "pyi"}, QStringList{"SConstruct", "SConscript"},
+        QStringList{"False", "None", "True", "and", "as", "assert", "async", "await", "break", "class", "continue", "def", "del", "elif", "else", "except", "finally", "for", "from", "global", "if", "import", "in", "is", "lambda", "nonlocal", "not", "or", "pass", "raise", "return", "self", "try", "while", "with", "yield"},
+        QStringList{"bool", "bytes", "dict", "float", "int", "list", "object", "set", "str", "tuple"},
+        true, false);
+}
+
+std::unique_ptr<Grammar> shell() {
+    return std::make_unique<ScriptGrammar>(QStringLiteral("Shell"),
+        QStringList{"sh", "bash", "zsh", "ksh"}, QStringList{".bashrc", ".profile", ".zshrc", "PKGBUILD"},
+        QStringList{"case", "declare", "do", "done", "elif", "else", "esac", "exit", "export", "fi", "for", "function", "if", "in", "local", "readonly", "return", "select", "shift", "source", "then", "until", "while"},
+        QStringList(),
+        false, true);
+}
+
+std::unique_ptr<Grammar> cmake() {
+    return std::make_unique<ScriptGrammar>(QStringLiteral("CMake"),
+        QStringList{"cmake"}, QStringList{"CMakeLists.txt"},
+        QStringList{"add_custom_command", "add_custom_target", "add_definitions", "add_executable", "add_library", "add_subdirectory", "add_test", "else", "elseif", "endforeach", "endfunction", "endif", "endmacro", "endwhile", "find_package", "foreach", "function", "if", "include", "install", "macro", "message", "option", "project", "return", "set", "set_target_properties", "target_compile_definitions", "target_compile_options", "target_include_directories", "target_link_libraries", "target_sources", "unset", "while"},
+        QStringList{"AND", "NOT", "OR", "PRIVATE", "PUBLIC", "INTERFACE", "REQUIRED", "COMPONENTS", "STATUS", "FATAL_ERROR", "ON", "OFF", "TRUE", "FALSE"},
+        false, true);
+}
+
+std::unique_ptr<Grammar> ini() {
+    return std::make_unique<IniGrammar>();
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef GRAMMARS_H
+#define GRAMMARS_H
+
+#include <memory>
+#include "grammar.h"
+
+// the grammars that come with the editor, further ones can be plugged in with Grammar::add
+namespace Grammars {
+std::unique_ptr<Grammar> cpp();
+std::unique_ptr<Grammar> java();
+std::unique_ptr<Grammar> javaScript();
+std::unique_ptr<Grammar> python();
+std::unique_ptr<Grammar> shell();
+std::unique_ptr<Grammar> cmake();
+std::unique_ptr<Grammar> ini();
+}
+
+#endif // GRAMMARS_H
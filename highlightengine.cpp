@@ -0,0 +1,297 @@
+#include "highlightengine.h"
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QScrollBar>
+#include <QMetaObject>
+#include <QColor>
+#include <QFont>
+
+HighlightEngine::HighlightEngine(QPlainTextEdit *textEdit, ChangeTracker *tracker, IdleScheduler *scheduler, QObject *parent): QObject(parent), textEdit(textEdit), document(textEdit->document()), tracker(tracker), scheduler(scheduler), currentGrammar(nullptr), firstVisible(0), lastVisible(0), applying(false), worker(nullptr), pendingSlots(maxPendingBatches), canceledFlag(false), currentGeneration(0) { // constructor
+    formats.resize(Grammar::StyleCount); // colors that are readable on both the light and the dark palette
+    formats[Grammar::Keyword].setForeground(QColor(86, 156, 214));
+    formats[Grammar::Keyword].setFontWeight(QFont::Bold);
+    formats[Grammar::Type].setForeground(QColor(43, 145, 175));
+    formats[Grammar::String].setForeground(QColor(206, 123, 0));
+    formats[Grammar::Comment].setForeground(QColor(106, 153, 85));
+    formats[Grammar::Comment].setFontItalic(true);
+    formats[Grammar::Number].setForeground(QColor(181, 93, 200));
+    formats[Grammar::Preprocessor].setForeground(QColor(155, 155, 155));
+    formats[Grammar::Key].setForeground(QColor(43, 145, 175));
+    formats[Grammar::Section].setForeground(QColor(86, 156, 214));
+    formats[Grammar::Section].setFontWeight(QFont::Bold);
+
+    connect(document, &QTextDocument::contentsChange, this, &HighlightEngine::contentsChanged);
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &HighlightEngine::updateVisibleRange); // the visible lines are the ones highlighted right away
+    connect(textEdit->verticalScrollBar(), &QScrollBar::rangeChanged, this, &HighlightEngine::updateVisibleRange);
+}
+
+HighlightEngine::~HighlightEngine() {
+    stopWorker(); // the worker must not outlive the engine
+}
+
+void HighlightEngine::setGrammar(const Grammar *grammar) { // nullptr switches highlighting off, a new grammar lexes the whole document in the background
+    if (grammar == currentGrammar) {
+        return;
+    }
+    stopWorker();
+    scheduler->cancel(QStringLiteral("highlight"));
+    clearPending();
+    if (currentGrammar) {
+        clearFormats();
+    }
+    currentGrammar = grammar;
+    if (grammar) {
+        updateVisibleRange();
+        markPending(0, document->characterCount()); // no block has a state yet, so nothing can stop early
+        startWorker();
+    }
+}
+
+const Grammar *HighlightEngine::grammar() const {
+    return currentGrammar;
+}
+
+bool HighlightEngine::isHighlighting() const { // true while some blocks still wait for the worker
+    return !pendingStart.isNull();
+}
+
+void HighlightEngine::contentsChanged(int position, int charsRemoved, int charsAdded) { // re-lexes from the edited block until the state at a block end is the same as before
+    Q_UNUSED(charsRemoved)
+    if (applying || !currentGrammar) { // our own format changes also arrive here
+        return;
+    }
+    stopWorker(); // the text the worker is lexing is outdated now
+    QTextBlock first = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + charsAdded);
+    if (!first.isValid()) {
+        first = document->lastBlock();
+    }
+    if (!last.isValid()) {
+        last = document->lastBlock();
+    }
+    if (!highlightVisible(first, last.position())) {
+        markPending(first.position(), last.position());
+    }
+    if (!pendingStart.isNull()) { // typing is collected before the worker starts again
+        scheduler->schedule(QStringLiteral("highlight"), IdleScheduler::Normal, [this](const IdleScheduler::Budget &) {
+            startWorker();
+            return true;
+        });
+    }
+}
+
+void HighlightEngine::updateVisibleRange() {
+    QWidget *viewport = textEdit->viewport();
+    firstVisible = textEdit->cursorForPosition(QPoint(0, 0)).blockNumber();
+    lastVisible = textEdit->cursorForPosition(QPoint(viewport->width() - 1, viewport->height() - 1)).blockNumber();
+}
+
+bool HighlightEngine::highlightVisible(QTextBlock block, int editEnd) { // lexes on the gui thread while the blocks are on screen, returns false if the edit wasn't handled at all
+    QTextBlock previous = block.previous();
+    int state = previous.isValid() ? previous.userState() : 0;
+    int screen = lastVisible - firstVisible + 1;
+    if (state < 0 || block.blockNumber() > lastVisible || block.blockNumber() < firstVisible - screen) { // off screen or behind blocks that aren't lexed yet
+        return false;
+    }
+
+    const int from = block.position();
+    int to = from;
+    bool converged = false;
+    QVector<HighlightSpan> spans;
+    applying = true;
+    while (block.isValid() && block.blockNumber() <= lastVisible) {
+        int oldState = block.userState();
+        spans.clear();
+        state = currentGrammar->highlightLine(block.text(), state, spans);
+        setFormats(block, spans);
+        block.setUserState(state);
+        to = block.position() + block.length();
+        bool done = block.position() >= editEnd && oldState == state; // the following blocks start with the same state as before, so they stay as they are
+        block = block.next();
+        if (done) {
+            converged = true;
+            break;
+        }
+    }
+    document->markContentsDirty(from, to - from); // one relayout for all blocks
+    applying = false;
+
+    if (!converged && block.isValid()) { // the rest is left to the worker
+        markPending(block.position(), qMax(editEnd, block.position()));
+    }
+    return true;
+}
+
+void HighlightEngine::applyBatch(int firstBlock, const QVector<LineResult> &lines) { // formats from the worker, stops it as soon as the states match the cached ones again
+    if (pendingStart.isNull()) {
+        return;
+    }
+    QTextBlock block = document->findBlockByNumber(firstBlock);
+    if (!block.isValid()) {
+        stopWorker();
+        clearPending();
+        return;
+    }
+    const int from = block.position();
+    int to = from;
+    bool converged = false;
+    applying = true;
+    for (const LineResult &line : lines) {
+        if (!block.isValid()) {
+            break;
+        }
+        int oldState = block.userState();
+        setFormats(block, line.spans);
+        block.setUserState(line.state);
+        to = block.position() + block.length();
+        bool done = block.position() >= pendingEnd.position() && oldState == line.state;
+        block = block.next();
+        if (done) {
+            converged = true;
+            break;
+        }
+    }
+    document->markContentsDirty(from, to - from);
+    applying = false;
+
+    if (converged || !block.isValid()) { // nothing left to do, the rest of the document is still valid
+        stopWorker();
+        clearPending();
+    } else {
+        pendingStart.setPosition(block.position()); // an edit restarts the worker from here instead of from the beginning
+    }
+}
+
+void HighlightEngine::setFormats(QTextBlock block, const QVector<HighlightSpan> &spans) { // formats go into the layout only, the text and the undo history are not touched
+    QVector<QTextLayout::FormatRange> ranges;
+    ranges.reserve(spans.size());
+    for (const HighlightSpan &span : spans) {
+        QTextLayout::FormatRange range;
+        range.start = span.start;
+        range.length = span.length;
+        range.format = formats.at(span.style);
+        ranges.append(range);
+    }
+    block.layout()->setFormats(ranges);
+}
+
+void HighlightEngine::markPending(int from, int to) { // widens the range the worker has to go over
+    if (pendingStart.isNull()) {
+        pendingStart = QTextCursor(document);
+        pendingStart.setPosition(from);
+        pendingEnd = QTextCursor(document);
+        pendingEnd.setPosition(qMin(to, document->characterCount() - 1));
+        return;
+    }
+    pendingStart.setPosition(qMin(from, pendingStart.position()));
+    pendingEnd.setPosition(qMin(qMax(to, pendingEnd.position()), document->characterCount() - 1));
+}
+
+void HighlightEngine::clearPending() {
+    pendingStart = QTextCursor();
+    pendingEnd = QTextCursor();
+}
+
+void HighlightEngine::clearFormats() { // removes the highlighting of the previous grammar
+    applying = true;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        block.layout()->clearFormats();
+        block.setUserState(-1);
+    }
+    document->markContentsDirty(0, document->characterCount());
+    applying = false;
+}
+
+void HighlightEngine::startWorker() { // lexes from the first pending block on a snapshot of the text
+    stopWorker();
+    if (!currentGrammar || pendingStart.isNull()) {
+        return;
+    }
+    QTextBlock block = pendingStart.block();
+    QTextBlock previous = block.previous();
+    while (previous.isValid() && previous.userState() < 0) { // starts behind the last block with a known state
+        block = previous;
+        previous = block.previous();
+    }
+    const int state = previous.isValid() ? previous.userState() : 0;
+    pendingStart.setPosition(block.position());
+
+    canceledFlag = false;
+    const quint64 generation = ++currentGeneration;
+    const Grammar *grammar = currentGrammar;
+    const PieceTable text = tracker->table(); // o(1) snapshot, typing meanwhile doesn't touch it
+    const qsizetype offset = block.position(); // positions in the document and in the mirror are the same
+    const int firstBlock = block.blockNumber();
+    worker = QThread::create([this, grammar, text, offset, firstBlock, state, generation]() {
+        run(grammar, text, offset, firstBlock, state, generation);
+    });
+    worker->start();
+}
+
+void HighlightEngine::stopWorker() { // cancels the worker and waits for it, batches that are still queued are dropped
+    canceledFlag = true;
+    if (worker) {
+        worker->wait();
+        delete worker;
+        worker = nullptr;
+    }
+    ++currentGeneration;
+    int missing = maxPendingBatches - pendingSlots.available();
+    if (missing > 0) {
+        pendingSlots.release(missing);
+    }
+}
+
+void HighlightEngine::run(const Grammar *grammar, const PieceTable &text, qsizetype offset, int firstBlock, int state, quint64 generation) { // runs on the worker thread
+    QVector<LineResult> lines;
+    lines.reserve(batchLines);
+    int blockNumber = firstBlock;
+    const qsizetype size = text.size();
+    QString window; // the snapshot is read window by window, never as a whole
+    qsizetype windowStart = offset;
+
+    while (!canceledFlag) {
+        const qsizetype local = offset - windowStart;
+        qsizetype end = window.indexOf(QLatin1Char('\n'), local);
+        if (end < 0 && windowStart + window.size() < size) { // the line goes on behind the window
+            window = window.mid(local) + text.mid(windowStart + window.size(), windowSize);
+            windowStart = offset;
+            continue;
+        }
+        bool last = end < 0;
+        if (last) {
+            end = window.size();
+        }
+        LineResult line;
+        state = grammar->highlightLine(QStringView(window).sliced(local, end - local), state, line.spans);
+        line.state = state;
+        lines.append(std::move(line));
+        offset = windowStart + end + 1;
+
+        if (lines.size() == batchLines || last) {
+            if (!waitForSlot()) { // blocks while the gui thread is still busy with earlier batches
+                return;
+            }
+            QMetaObject::invokeMethod(this, [this, generation, blockNumber, lines]() {
+                if (generation == currentGeneration) {
+                    pendingSlots.release();
+                    applyBatch(blockNumber, lines);
+                }
+            }, Qt::QueuedConnection);
+            blockNumber += lines.size();
+            lines.clear();
+        }
+        if (last) {
+            break;
+        }
+    }
+}
+
+bool HighlightEngine::waitForSlot() { // returns false when the worker was canceled while waiting
+    while (!pendingSlots.tryAcquire(1, 20)) {
+        if (canceledFlag) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef HIGHLIGHTENGINE_H
+#define HIGHLIGHTENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextCharFormat>
+#include <QThread>
+#include <QSemaphore>
+#include <atomic>
+#include "changetracker.h"
+#include "grammar.h"
+#include "idlescheduler.h"
+
+// syntax highlighting on the document of the editor, the lexer state at the end of every block is kept in its user state,
+// the visible lines are highlighted right away and everything behind them on a worker thread
+class HighlightEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        HighlightEngine(QPlainTextEdit *textEdit, ChangeTracker *tracker, IdleScheduler *scheduler, QObject *parent = nullptr);
+        ~HighlightEngine();
+
+        static constexpr int batchLines = 2000; // lines the worker lexes before handing them to the gui thread
+        static constexpr int maxPendingBatches = 4; // the worker waits when the gui thread falls behind
+        static constexpr qsizetype windowSize = 1024 * 1024; // characters the worker reads out of the snapshot at once
+
+        void setGrammar(const Grammar *grammar);
+        const Grammar *grammar() const;
+        bool isHighlighting() const;
+
+    private slots:
+        void contentsChanged(int position, int charsRemoved, int charsAdded);
+        void updateVisibleRange();
+
+    private:
+        struct LineResult {
+            QVector<HighlightSpan> spans;
+            int state;
+        };
+
+        bool highlightVisible(QTextBlock block, int editEnd);
+        void applyBatch(int firstBlock, const QVector<LineResult> &lines);
+        void setFormats(QTextBlock block, const QVector<HighlightSpan> &spans);
+        void markPending(int from, int to);
+        void clearPending();
+        void clearFormats();
+        void startWorker();
+        void stopWorker();
+        void run(const Grammar *grammar, const PieceTable &text, qsizetype offset, int firstBlock, int state, quint64 generation);
+        bool waitForSlot();
+
+        QPlainTextEdit *textEdit;
+        QTextDocument *document;
+        ChangeTracker *tracker;
+        IdleScheduler *scheduler; // restarts the worker once typing pauses
+        const Grammar *currentGrammar;
+        QVector<QTextCharFormat> formats;
+        QTextCursor pendingStart; // first block that still has to be lexed, moves along with edits
+        QTextCursor pendingEnd; // highlighting may stop early only behind this position
+        int firstVisible;
+        int lastVisible;
+        bool applying;
+        QThread *worker;
+        QSemaphore pendingSlots;
+        std::atomic<bool> canceledFlag;
+        quint64 currentGeneration;
+};
+
+#endif // HIGHLIGHTENGINE_H
@@ -0,0 +1,134 @@
+#include "idlescheduler.h"
+#include "profiler.h"
+#include <QCoreApplication>
+#include <QEvent>
+#include <climits>
+
+namespace {
+
+constexpr qint64 millisecond = 1000 * 1000; // Profiler::now() counts nanoseconds
+
+}
+
+bool IdleScheduler::Budget::expired() const {
+    return Profiler::now() >= deadline;
+}
+
+IdleScheduler::IdleScheduler(QObject *parent): QObject(parent), lastInput(0), nextSerial(0) { // constructor
+    runTimer.setSingleShot(true);
+    connect(&runTimer, &QTimer::timeout, this, &IdleScheduler::run);
+    QCoreApplication::instance()->installEventFilter(this); // input of every widget counts, not only of the editor
+}
+
+bool IdleScheduler::eventFilter(QObject *watched, QEvent *event) {
+    switch (event->type()) {
+        case QEvent::KeyPress:
+        case QEvent::MouseButtonPress:
+        case QEvent::Wheel:
+        case QEvent::InputMethod:
+            lastInput = Profiler::now(); // the event arrives once per widget it passes, the time is the same
+            break;
+        default:
+            break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void IdleScheduler::schedule(const QString &name, Priority priority, Step step) {
+    auto existing = jobs.find(name);
+    if (existing != jobs.end()) { // coalesced, the newest step knows the newest state
+        existing->priority = qMin(existing->priority, priority);
+        existing->step = std::move(step);
+        existing->serial = nextSerial++;
+    } else {
+        jobs.insert(name, Job{priority, std::move(step), Profiler::now(), nextSerial++});
+    }
+    arm();
+}
+
+void IdleScheduler::cancel(const QString &name) {
+    jobs.remove(name);
+    if (jobs.isEmpty()) {
+        runTimer.stop();
+    }
+}
+
+bool IdleScheduler::isPending(const QString &name) const {
+    return jobs.contains(name);
+}
+
+void IdleScheduler::runAll() {
+    const Budget unlimited = {LLONG_MAX};
+    while (!jobs.isEmpty()) {
+        runJob(next(LLONG_MAX), unlimited); // everything counts as ready, see isReady
+    }
+    runTimer.stop();
+}
+
+bool IdleScheduler::isReady(const Job &job, qint64 now) const {
+    if (job.priority == Urgent || now == LLONG_MAX) {
+        return true;
+    }
+    return now - lastInput >= quietTime * millisecond || now - job.queued >= maxDelay * millisecond;
+}
+
+QString IdleScheduler::next(qint64 now) const { // the ready job with the highest priority, the oldest first among equal ones
+    QString best;
+    const Job *bestJob = nullptr;
+    for (auto job = jobs.cbegin(); job != jobs.cend(); ++job) {
+        if (!isReady(job.value(), now)) {
+            continue;
+        }
+        if (!bestJob || job->priority < bestJob->priority || (job->priority == bestJob->priority && job->serial < bestJob->serial)) {
+            best = job.key();
+            bestJob = &job.value();
+        }
+    }
+    return best;
+}
+
+bool IdleScheduler::runJob(const QString &name, const Budget &budget) { // returns whether the job is finished
+    Job job = jobs.value(name); // the step may schedule or cancel jobs, even itself
+    bool done = job.step(budget);
+    auto current = jobs.find(name);
+    if (done && current != jobs.end() && current->serial == job.serial) { // scheduled again during the step means there is new work
+        jobs.erase(current);
+    }
+    return done;
+}
+
+void IdleScheduler::run() {
+    ScopedTimer timer("idleWork");
+    const qint64 start = Profiler::now();
+    const Budget budget = {start + frameBudget * millisecond};
+    while (!budget.expired()) {
+        QString name = next(Profiler::now());
+        if (name.isNull()) {
+            break;
+        }
+        runJob(name, budget); // an unfinished job is picked again while there is time, otherwise on the next turn
+    }
+    arm();
+}
+
+void IdleScheduler::arm() { // the next turn with work to do, right away for ready jobs
+    if (jobs.isEmpty()) {
+        runTimer.stop();
+        return;
+    }
+    const qint64 now = Profiler::now();
+    qint64 wait = LLONG_MAX;
+    for (const Job &job : std::as_const(jobs)) {
+        if (isReady(job, now)) {
+            wait = 0;
+            break;
+        }
+        qint64 quiet = lastInput + quietTime * millisecond - now;
+        qint64 overdue = job.queued + maxDelay * millisecond - now;
+        wait = qMin(wait, qMin(quiet, overdue));
+    }
+    int interval = int(qMax<qint64>(0, (wait + millisecond - 1) / millisecond));
+    if (!runTimer.isActive() || runTimer.remainingTime() > interval) {
+        runTimer.start(interval);
+    }
+}
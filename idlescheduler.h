@@ -0,0 +1,58 @@
+#ifndef IDLESCHEDULER_H
+#define IDLESCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QTimer>
+#include <functional>
+
+// runs the side effects of edits that don't have to happen right away, like status bar counts or restarting the highlighter,
+// in slices of a few milliseconds between input events, the same job scheduled again before it ran is done only once
+class IdleScheduler : public QObject {
+    Q_OBJECT
+
+    public:
+        enum Priority { Urgent, Normal, Background }; // urgent runs on the next turn of the event loop, the others wait for a pause in the input
+
+        struct Budget {
+            qint64 deadline; // Profiler::now() at which the slice has to end
+            bool expired() const;
+        };
+        using Step = std::function<bool(const Budget &budget)>; // one slice of the job, returns true once the job is done
+
+        explicit IdleScheduler(QObject *parent = nullptr);
+
+        static constexpr int frameBudget = 8; // ms per turn of the event loop, the rest of a 60 hz frame is left to input and painting
+        static constexpr int quietTime = 100; // ms without key or mouse input before normal and background jobs run
+        static constexpr int maxDelay = 1000; // ms, jobs run even during continuous typing once they waited this long
+
+        void schedule(const QString &name, Priority priority, Step step); // replaces a pending job of the same name, the higher priority of both is kept
+        void cancel(const QString &name);
+        bool isPending(const QString &name) const;
+        void runAll(); // runs every pending job to the end right now, e.g. before the window is closed
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override;
+
+    private:
+        struct Job {
+            Priority priority;
+            Step step;
+            qint64 queued; // Profiler::now() of the first schedule, later ones don't push the job back
+            quint64 serial; // order of the jobs with the same priority, and tells a job replaced by its own step apart
+        };
+
+        void run();
+        void arm();
+        bool isReady(const Job &job, qint64 now) const;
+        QString next(qint64 now) const;
+        bool runJob(const QString &name, const Budget &budget);
+
+        QHash<QString, Job> jobs;
+        QTimer runTimer;
+        qint64 lastInput; // Profiler::now() of the latest key press, click or wheel turn
+        quint64 nextSerial;
+};
+
+#endif // IDLESCHEDULER_H
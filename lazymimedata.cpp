@@ -0,0 +1,32 @@
+#include "lazymimedata.h"
+
+LazyMimeData::LazyMimeData(const PieceTable &text, qsizetype position, qsizetype length): snapshot(text), start(position), size(length) { // constructor
+}
+
+const PieceTable &LazyMimeData::source() const {
+    return snapshot;
+}
+
+qsizetype LazyMimeData::position() const {
+    return start;
+}
+
+qsizetype LazyMimeData::length() const {
+    return size;
+}
+
+QStringList LazyMimeData::formats() const {
+    return {QStringLiteral("text/plain")};
+}
+
+bool LazyMimeData::hasFormat(const QString &mimeType) const {
+    return mimeType == QLatin1String("text/plain");
+}
+
+QVariant LazyMimeData::retrieveData(const QString &mimeType, QMetaType type) const { // built anew for every request, keeping it would hold the whole text twice
+    Q_UNUSED(type) // qt converts the string into the bytes the other application wants
+    if (!hasFormat(mimeType)) {
+        return QVariant();
+    }
+    return snapshot.mid(start, size);
+}
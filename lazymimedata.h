@@ -0,0 +1,34 @@
+#ifndef LAZYMIMEDATA_H
+#define LAZYMIMEDATA_H
+
+#include <QMimeData>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include "piecetable.h"
+
+// clipboard contents that stay a snapshot of the document until something is pasted, the string is only built
+// when another application asks for it, pasting into the editor itself reads the snapshot directly
+class LazyMimeData : public QMimeData {
+    Q_OBJECT
+
+    public:
+        LazyMimeData(const PieceTable &text, qsizetype position, qsizetype length);
+
+        const PieceTable &source() const;
+        qsizetype position() const;
+        qsizetype length() const;
+
+        QStringList formats() const override;
+        bool hasFormat(const QString &mimeType) const override;
+
+    protected:
+        QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+    private:
+        PieceTable snapshot;
+        qsizetype start;
+        qsizetype size;
+};
+
+#endif // LAZYMIMEDATA_H
@@ -0,0 +1,54 @@
+#include "lineindex.h"
+#include "linescanner.h"
+#include <algorithm>
+#include <cstring>
+
+void LineIndex::clear() {
+    marks.clear();
+    newlines = 0;
+    scanned = 0;
+}
+
+void LineIndex::append(const char *data, std::size_t size) { // data continues where the previous call stopped, so the index can be built piece by piece
+    newlines = LineScanner::markNewlines(data, size, scanned, newlines, interval, marks);
+    scanned += std::int64_t(size);
+}
+
+void LineIndex::build(const char *data, std::size_t size) {
+    clear();
+    append(data, size);
+}
+
+std::int64_t LineIndex::lineCount() const { // a buffer without newline still has one line
+    return std::int64_t(newlines) + 1;
+}
+
+std::int64_t LineIndex::scannedBytes() const {
+    return scanned;
+}
+
+std::int64_t LineIndex::lineStart(std::int64_t line, const char *data, std::size_t size) const { // byte offset of a 0-based line
+    if (line <= 0) {
+        return 0;
+    }
+    if (line >= lineCount()) {
+        line = lineCount() - 1;
+    }
+    std::size_t mark = std::size_t(line) / interval; // jumps to the closest stored start in front of the line
+    std::int64_t offset = mark == 0 ? 0 : marks[mark - 1];
+    for (std::size_t rest = std::size_t(line) % interval; rest > 0; --rest) { // and walks the remaining lines with memchr
+        const void *hit = std::memchr(data + offset, '\n', size - std::size_t(offset));
+        if (!hit) {
+            break;
+        }
+        offset = static_cast<const char *>(hit) - data + 1;
+    }
+    return offset;
+}
+
+std::int64_t LineIndex::lineAt(std::int64_t offset, const char *data) const { // 0-based line that contains offset, binary search over the stored starts
+    auto mark = std::upper_bound(marks.begin(), marks.end(), offset);
+    std::size_t index = std::size_t(mark - marks.begin());
+    std::int64_t start = index == 0 ? 0 : marks[index - 1];
+    return std::int64_t(index * interval) + std::int64_t(LineScanner::countNewlines(data + start, std::size_t(offset - start)));
+}
@@ -0,0 +1,27 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// sparse index of line starts in a byte buffer, every interval-th line start is stored
+class LineIndex {
+    public:
+        static constexpr std::size_t interval = 64; // lines between two stored starts, keeps the index small for huge files
+
+        void clear();
+        void append(const char *data, std::size_t size);
+        void build(const char *data, std::size_t size);
+        std::int64_t lineCount() const;
+        std::int64_t scannedBytes() const;
+        std::int64_t lineStart(std::int64_t line, const char *data, std::size_t size) const;
+        std::int64_t lineAt(std::int64_t offset, const char *data) const;
+
+    private:
+        std::vector<std::int64_t> marks;
+        std::size_t newlines = 0;
+        std::int64_t scanned = 0;
+};
+
+#endif // LINEINDEX_H
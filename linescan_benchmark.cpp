@@ -0,0 +1,93 @@
+#include "linescanner.h"
+#include "lineindex.h"
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// compares the vectorized newline scanner with a plain loop, usage: linescan_benchmark [megabytes] (default 1024)
+
+namespace {
+
+std::vector<char> generate(std::size_t size) { // synthetic log-like text with lines of 0 to 160 characters
+    std::vector<char> buffer(size);
+    std::uint32_t state = 12345;
+    std::size_t i = 0;
+    while (i < size) {
+        state = state * 1664525u + 1013904223u; // simple lcg, the content doesn't matter, only the line lengths
+        std::size_t length = (state >> 8) % 161;
+        for (std::size_t j = 0; j < length && i < size; ++j, ++i) {
+            buffer[i] = char('a' + (j + (state >> 24)) % 26);
+        }
+        if (i < size) {
+            buffer[i++] = '\n';
+        }
+    }
+    return buffer;
+}
+
+template <typename Function>
+double measure(Function function, std::size_t &result, int runs = 3) { // best of a few runs in seconds
+    double best = 1e30;
+    for (int run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        result = function();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+void report(const char *name, double seconds, std::size_t bytes, std::size_t lines) {
+    std::printf("%-22s %10.2f ms %10.2f GB/s %14zu lines\n", name, seconds * 1000.0, double(bytes) / seconds / 1e9, lines);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1024;
+    std::size_t size = megabytes * 1024 * 1024;
+    std::printf("generating %zu MB of text...\n", megabytes);
+    std::vector<char> buffer = generate(size);
+    std::u16string wide(buffer.begin(), buffer.begin() + std::min<std::size_t>(size, 256u * 1024 * 1024)); // utf-16 copy for the qstring path
+
+    std::printf("instruction set: %s\n", LineScanner::instructionSet());
+    std::size_t scalar = 0;
+    std::size_t simd = 0;
+    std::size_t indexed = 0;
+    std::size_t scalarWide = 0;
+    std::size_t simdWide = 0;
+
+    double scalarTime = measure([&]() { return LineScanner::countNewlinesScalar(buffer.data(), buffer.size()); }, scalar);
+    double simdTime = measure([&]() { return LineScanner::countNewlines(buffer.data(), buffer.size()); }, simd);
+    double indexTime = measure([&]() {
+        LineIndex index;
+        index.build(buffer.data(), buffer.size());
+        return std::size_t(index.lineCount() - 1);
+    }, indexed);
+    double scalarWideTime = measure([&]() {
+        std::size_t count = 0;
+        for (char16_t c : wide) {
+            count += c == u'\n';
+        }
+        return count;
+    }, scalarWide);
+    double simdWideTime = measure([&]() { return LineScanner::countNewlines(wide.data(), wide.size()); }, simdWide);
+
+    report("count scalar", scalarTime, buffer.size(), scalar);
+    report("count simd", simdTime, buffer.size(), simd);
+    report("index build simd", indexTime, buffer.size(), indexed);
+    report("count utf-16 scalar", scalarWideTime, wide.size() * 2, scalarWide);
+    report("count utf-16 simd", simdWideTime, wide.size() * 2, simdWide);
+    std::printf("speedup: %.1fx (bytes), %.1fx (utf-16)\n", scalarTime / simdTime, scalarWideTime / simdWideTime);
+
+    if (scalar != simd || scalar != indexed || scalarWide != simdWide) {
+        std::printf("mismatch between scalar and simd results\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "linescanner.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LINESCANNER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(LINESCANNER_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINESCANNER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline unsigned popcount32(unsigned value) {
+#if defined(__GNUC__)
+    return unsigned(__builtin_popcount(value));
+#else
+    unsigned count = 0;
+    while (value) {
+        value &= value - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+inline unsigned lowestBit(unsigned value) { // value must not be 0
+#if defined(__GNUC__)
+    return unsigned(__builtin_ctz(value));
+#else
+    unsigned bit = 0;
+    while (!(value & 1u)) {
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+std::size_t countScalar16(const char16_t *data, std::size_t size) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        count += data[i] == u'\n';
+    }
+    return count;
+}
+
+std::size_t markScalar(const char *data, std::size_t begin, std::size_t size, std::int64_t base, std::size_t counted, std::size_t interval, std::vector<std::int64_t> &marks) {
+    for (std::size_t i = begin; i < size; ++i) {
+        if (data[i] == '\n' && ++counted % interval == 0) {
+            marks.push_back(base + std::int64_t(i) + 1); // start of the line behind the newline
+        }
+    }
+    return counted;
+}
+
+// walks over the set bits of a block mask and records every interval-th line start
+inline void markBits(unsigned mask, std::size_t offset, std::int64_t base, std::size_t &counted, std::size_t &untilMark, std::size_t interval, std::vector<std::int64_t> &marks) {
+    unsigned count = popcount32(mask);
+    if (count < untilMark) { // no mark inside this block, the common case
+        counted += count;
+        untilMark -= count;
+        return;
+    }
+    while (mask) {
+        unsigned bit = lowestBit(mask);
+        ++counted;
+        if (--untilMark == 0) {
+            marks.push_back(base + std::int64_t(offset + bit) + 1);
+            untilMark = interval;
+        }
+        mask &= mask - 1;
+    }
+}
+
+#ifdef LINESCANNER_SSE2
+std::size_t countSse2(const char *data, std::size_t size) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t count = 0;
+    std::size_t i = 0;
+    while (size - i >= 16) {
+        std::size_t blocks = (size - i) / 16;
+        if (blocks > 255) { // the byte counters are summed up before they can overflow
+            blocks = 255;
+        }
+        __m128i counters = zero;
+        for (std::size_t block = 0; block < blocks; ++block, i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(chunk, newline)); // a match is -1, so subtracting counts up
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        count += std::size_t(_mm_cvtsi128_si32(sums)) + std::size_t(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+    }
+    return count + LineScanner::countNewlinesScalar(data + i, size - i);
+}
+
+std::size_t countSse2(const char16_t *data, std::size_t size) {
+    const __m128i newline = _mm_set1_epi16('\n');
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        count += popcount32(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi16(chunk, newline)))) / 2; // two mask bits per character
+    }
+    return count + countScalar16(data + i, size - i);
+}
+
+std::size_t markSse2(const char *data, std::size_t size, std::int64_t base, std::size_t counted, std::size_t interval, std::vector<std::int64_t> &marks) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    std::size_t untilMark = interval - counted % interval;
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        if (mask) {
+            markBits(mask, i, base, counted, untilMark, interval, marks);
+        }
+    }
+    return markScalar(data, i, size, base, counted, interval, marks);
+}
+#endif
+
+#ifdef LINESCANNER_AVX2
+__attribute__((target("avx2,popcnt,bmi"))) std::size_t countAvx2(const char *data, std::size_t size) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    std::size_t count = 0;
+    std::size_t i = 0;
+    while (size - i >= 32) {
+        std::size_t blocks = (size - i) / 32;
+        if (blocks > 255) {
+            blocks = 255;
+        }
+        __m256i counters = zero;
+        for (std::size_t block = 0; block < blocks; ++block, i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(chunk, newline));
+        }
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_sad_epu8(counters, zero));
+        count += std::size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+    }
+    return count + LineScanner::countNewlinesScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2,popcnt,bmi"))) std::size_t countAvx2(const char16_t *data, std::size_t size) {
+    const __m256i newline = _mm256_set1_epi16('\n');
+    std::size_t count = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        count += popcount32(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi16(chunk, newline)))) / 2;
+    }
+    return count + countScalar16(data + i, size - i);
+}
+
+__attribute__((target("avx2,popcnt,bmi"))) std::size_t markAvx2(const char *data, std::size_t size, std::int64_t base, std::size_t counted, std::size_t interval, std::vector<std::int64_t> &marks) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    std::size_t untilMark = interval - counted % interval;
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+        if (mask) {
+            markBits(mask, i, base, counted, untilMark, interval, marks);
+        }
+    }
+    return markScalar(data, i, size, base, counted, interval, marks);
+}
+
+bool hasAvx2() { // checked once at runtime, the binary itself only requires sse2
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return supported;
+}
+#endif
+
+}
+
+namespace LineScanner {
+
+const char *instructionSet() { // name of the code path that is used on this cpu
+#if defined(LINESCANNER_AVX2)
+    if (hasAvx2()) {
+        return "avx2";
+    }
+#endif
+#if defined(LINESCANNER_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+std::size_t countNewlinesScalar(const char *data, std::size_t size) { // plain loop, also the reference for the benchmark
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        count += data[i] == '\n';
+    }
+    return count;
+}
+
+std::size_t countNewlines(const char *data, std::size_t size) {
+#if defined(LINESCANNER_AVX2)
+    if (hasAvx2()) {
+        return countAvx2(data, size);
+    }
+#endif
+#if defined(LINESCANNER_SSE2)
+    return countSse2(data, size);
+#else
+    return countNewlinesScalar(data, size);
+#endif
+}
+
+std::size_t countNewlines(const char16_t *data, std::size_t size) { // utf-16 text as stored in qstring
+#if defined(LINESCANNER_AVX2)
+    if (hasAvx2()) {
+        return countAvx2(data, size);
+    }
+#endif
+#if defined(LINESCANNER_SSE2)
+    return countSse2(data, size);
+#else
+    return countScalar16(data, size);
+#endif
+}
+
+// scans data (which starts at byte base of the whole buffer) and appends the start of every interval-th line to marks,
+// counted is the number of newlines before data, the new total is returned
+std::size_t markNewlines(const char *data, std::size_t size, std::int64_t base, std::size_t counted, std::size_t interval, std::vector<std::int64_t> &marks) {
+#if defined(LINESCANNER_AVX2)
+    if (hasAvx2()) {
+        return markAvx2(data, size, base, counted, interval, marks);
+    }
+#endif
+#if defined(LINESCANNER_SSE2)
+    return markSse2(data, size, base, counted, interval, marks);
+#else
+    return markScalar(data, 0, size, base, counted, interval, marks);
+#endif
+}
+
+}
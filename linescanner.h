@@ -0,0 +1,19 @@
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// vectorized newline scanning (sse2/avx2 with a scalar fallback), used for line counts and the line index
+namespace LineScanner {
+
+const char *instructionSet();
+std::size_t countNewlinesScalar(const char *data, std::size_t size);
+std::size_t countNewlines(const char *data, std::size_t size);
+std::size_t countNewlines(const char16_t *data, std::size_t size);
+std::size_t markNewlines(const char *data, std::size_t size, std::int64_t base, std::size_t counted, std::size_t interval, std::vector<std::int64_t> &marks);
+
+}
+
+#endif // LINESCANNER_H
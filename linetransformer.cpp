@@ -0,0 +1,317 @@
+#include "linetransformer.h"
+#include "linescanner.h"
+#include "profiler.h"
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct Range {
+    qsizetype begin;
+    qsizetype end;
+};
+
+struct NumberedLine {
+    double number;
+    QStringView text;
+};
+
+QVector<Range> rangesOf(qsizetype count, qsizetype size) { // [0, count) cut into pieces of at most size
+    QVector<Range> ranges;
+    for (qsizetype begin = 0; begin < count; begin += size) {
+        ranges.append({begin, qMin(count, begin + size)});
+    }
+    return ranges;
+}
+
+bool isCanceled(const std::atomic<bool> *canceled) {
+    return canceled && *canceled;
+}
+
+std::vector<QStringView> splitLines(QStringView text) { // every block ends behind a line end, so the blocks are split on their own
+    QVector<Range> blocks;
+    for (qsizetype begin = 0; begin < text.size(); ) {
+        qsizetype newline = begin + LineTransformer::blockSize < text.size() ? text.indexOf(u'\n', begin + LineTransformer::blockSize) : -1;
+        qsizetype end = newline < 0 ? text.size() : newline + 1;
+        blocks.append({begin, end});
+        begin = end;
+    }
+    const QList<QVector<QStringView>> split = QtConcurrent::blockingMapped<QList<QVector<QStringView>>>(blocks, [text](const Range &block) {
+        QVector<QStringView> lines;
+        qsizetype position = block.begin;
+        while (position < block.end) {
+            qsizetype newline = text.indexOf(u'\n', position);
+            qsizetype end = newline < 0 || newline >= block.end ? block.end : newline;
+            lines.append(text.mid(position, end - position));
+            position = end + 1;
+        }
+        if (block.end == text.size() && text.endsWith(u'\n')) { // the empty line behind the last line end
+            lines.append(text.mid(text.size(), 0));
+        }
+        return lines;
+    });
+    std::vector<QStringView> lines;
+    for (const QVector<QStringView> &part : split) {
+        lines.insert(lines.end(), part.cbegin(), part.cend());
+    }
+    return lines;
+}
+
+QString joinLines(const std::vector<QStringView> &lines) { // the offsets are summed up first, then every chunk copies its lines into place
+    if (lines.empty()) {
+        return QString();
+    }
+    std::vector<qsizetype> offsets(lines.size() + 1, 0);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        offsets[i + 1] = offsets[i] + lines[i].size() + 1;
+    }
+    QString result(offsets.back() - 1, Qt::Uninitialized);
+    QChar *out = result.data(); // detached here, the chunks only write
+    QVector<Range> chunks = rangesOf(qsizetype(lines.size()), LineTransformer::chunkLines);
+    QtConcurrent::blockingMap(chunks, [&lines, &offsets, out](const Range &chunk) {
+        for (qsizetype i = chunk.begin; i < chunk.end; ++i) {
+            const QStringView line = lines[size_t(i)];
+            if (!line.isEmpty()) { // an empty view may have no data at all
+                std::memcpy(out + offsets[size_t(i)], line.data(), size_t(line.size()) * sizeof(QChar));
+            }
+            if (size_t(i) + 1 < lines.size()) {
+                out[offsets[size_t(i) + 1] - 1] = QLatin1Char('\n');
+            }
+        }
+    });
+    return result;
+}
+
+template <typename T, typename Less>
+void parallelSort(std::vector<T> &items, Less less, const std::atomic<bool> *canceled) { // stable: runs are sorted on the pool, then merged pairwise round by round
+    const qsizetype count = qsizetype(items.size());
+    const qsizetype runLength = qMax<qsizetype>(LineTransformer::chunkLines, (count + QThread::idealThreadCount() - 1) / qMax(1, QThread::idealThreadCount()));
+    QVector<Range> runs = rangesOf(count, runLength);
+    QtConcurrent::blockingMap(runs, [&items, &less](const Range &run) {
+        std::stable_sort(items.begin() + run.begin, items.begin() + run.end, less);
+    });
+    std::vector<T> merged(items.size());
+    while (runs.size() > 1 && !isCanceled(canceled)) {
+        QVector<Range> pairs; // begin and end of two neighbouring runs, the middle is kept apart
+        QVector<qsizetype> middles;
+        for (qsizetype i = 0; i < runs.size(); i += 2) {
+            pairs.append({runs.at(i).begin, i + 1 < runs.size() ? runs.at(i + 1).end : runs.at(i).end});
+            middles.append(runs.at(i).end);
+        }
+        QVector<qsizetype> indexes(pairs.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        QtConcurrent::blockingMap(indexes, [&items, &merged, &pairs, &middles, &less](qsizetype index) { // equal items are taken from the first run first, so the merge is stable
+            const Range &pair = pairs.at(index);
+            std::merge(items.begin() + pair.begin, items.begin() + middles.at(index), items.begin() + middles.at(index), items.begin() + pair.end, merged.begin() + pair.begin, less);
+        });
+        items.swap(merged);
+        runs = pairs;
+    }
+}
+
+double leadingNumber(QStringView line) { // like sort -n, a line that doesn't start with a number counts as 0
+    qsizetype i = 0;
+    while (i < line.size() && line.at(i).isSpace()) {
+        ++i;
+    }
+    const qsizetype begin = i;
+    auto isDigit = [&line](qsizetype at) {
+        return at < line.size() && line.at(at) >= QLatin1Char('0') && line.at(at) <= QLatin1Char('9');
+    };
+    if (i < line.size() && (line.at(i) == QLatin1Char('-') || line.at(i) == QLatin1Char('+'))) {
+        ++i;
+    }
+    while (isDigit(i)) {
+        ++i;
+    }
+    if (i < line.size() && line.at(i) == QLatin1Char('.')) {
+        ++i;
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    bool ok = false;
+    const double number = line.mid(begin, i - begin).toDouble(&ok);
+    return ok ? number : 0.0;
+}
+
+template <typename Keep>
+void keepLines(std::vector<QStringView> &lines, Keep keep) { // decided in parallel chunks, compacted in order afterwards
+    std::vector<char> kept(lines.size(), 0);
+    QVector<Range> chunks = rangesOf(qsizetype(lines.size()), LineTransformer::chunkLines);
+    QtConcurrent::blockingMap(chunks, [&lines, &kept, &keep](const Range &chunk) {
+        for (qsizetype i = chunk.begin; i < chunk.end; ++i) {
+            kept[size_t(i)] = keep(qsizetype(i), lines[size_t(i)]) ? 1 : 0;
+        }
+    });
+    size_t out = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (kept[i]) {
+            lines[out++] = lines[i];
+        }
+    }
+    lines.resize(out);
+}
+
+void sortLines(std::vector<QStringView> &lines, bool descending, const std::atomic<bool> *canceled) {
+    if (descending) {
+        parallelSort(lines, [](QStringView a, QStringView b) { return b.compare(a) < 0; }, canceled);
+    } else {
+        parallelSort(lines, [](QStringView a, QStringView b) { return a.compare(b) < 0; }, canceled);
+    }
+}
+
+void sortNumeric(std::vector<QStringView> &lines, bool descending, const std::atomic<bool> *canceled) { // the numbers are parsed once, in parallel, not in every comparison
+    std::vector<NumberedLine> numbered(lines.size());
+    QVector<Range> chunks = rangesOf(qsizetype(lines.size()), LineTransformer::chunkLines);
+    QtConcurrent::blockingMap(chunks, [&lines, &numbered](const Range &chunk) {
+        for (qsizetype i = chunk.begin; i < chunk.end; ++i) {
+            numbered[size_t(i)] = {leadingNumber(lines[size_t(i)]), lines[size_t(i)]};
+        }
+    });
+    if (descending) {
+        parallelSort(numbered, [](const NumberedLine &a, const NumberedLine &b) { return b.number < a.number; }, canceled);
+    } else {
+        parallelSort(numbered, [](const NumberedLine &a, const NumberedLine &b) { return a.number < b.number; }, canceled);
+    }
+    for (size_t i = 0; i < lines.size(); ++i) {
+        lines[i] = numbered[i].text;
+    }
+}
+
+void uniqueLines(std::vector<QStringView> &lines) { // equal lines have equal hashes and end up in the same shard, so the shards are independent
+    std::vector<size_t> hashes(lines.size());
+    QVector<Range> chunks = rangesOf(qsizetype(lines.size()), LineTransformer::chunkLines);
+    QtConcurrent::blockingMap(chunks, [&lines, &hashes](const Range &chunk) {
+        for (qsizetype i = chunk.begin; i < chunk.end; ++i) {
+            hashes[size_t(i)] = qHash(lines[size_t(i)]);
+        }
+    });
+    QVector<std::vector<qsizetype>> shards(LineTransformer::shards);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        shards[int((quint64(hashes[i]) * 0x9E3779B97F4A7C15ULL) >> 58)].push_back(qsizetype(i)); // the top bits, the sets below use the low ones
+    }
+    std::vector<char> duplicate(lines.size(), 0);
+    QtConcurrent::blockingMap(shards, [&lines, &hashes, &duplicate](const std::vector<qsizetype> &shard) {
+        auto hash = [&hashes](qsizetype index) { return hashes[size_t(index)]; };
+        auto equal = [&lines](qsizetype a, qsizetype b) { return lines[size_t(a)] == lines[size_t(b)]; };
+        std::unordered_set<qsizetype, decltype(hash), decltype(equal)> seen(shard.size() * 2, hash, equal);
+        for (qsizetype index : shard) { // in order, so the first of equal lines is the one in the set
+            if (!seen.insert(index).second) {
+                duplicate[size_t(index)] = 1;
+            }
+        }
+    });
+    keepLines(lines, [&duplicate](qsizetype index, QStringView) {
+        return !duplicate[size_t(index)];
+    });
+}
+
+}
+
+LineTransformer::LineTransformer(QObject *parent): QObject(parent), currentGeneration(0) { // constructor
+}
+
+LineTransformer::~LineTransformer() {
+    stop(); // the worker reports to this object
+}
+
+QString LineTransformer::apply(const QString &text, const LineOperation &operation, const std::atomic<bool> *canceled) { // the lines are views into text, only the result is a new string
+    std::vector<QStringView> lines = splitLines(text);
+    if (isCanceled(canceled)) {
+        return QString();
+    }
+    switch (operation.kind) {
+        case LineOperation::Sort:
+            sortLines(lines, operation.descending, canceled);
+            break;
+        case LineOperation::SortNumeric:
+            sortNumeric(lines, operation.descending, canceled);
+            break;
+        case LineOperation::Unique:
+            uniqueLines(lines);
+            break;
+        case LineOperation::Filter: {
+            const SearchEngine engine(operation.filter);
+            if (!engine.isValid()) {
+                throw std::runtime_error("Ungültiger Filter: " + engine.errorString().toStdString());
+            }
+            const bool keepMatches = operation.keepMatches;
+            keepLines(lines, [&engine, keepMatches](qsizetype, QStringView line) {
+                return engine.findNext(line, 0).isValid() == keepMatches;
+            });
+            break;
+        }
+        case LineOperation::Reverse:
+            std::reverse(lines.begin(), lines.end());
+            break;
+        case LineOperation::Trim:
+            keepLines(lines, [](qsizetype, QStringView &line) { // every line is kept, only shortened
+                while (!line.isEmpty() && line.back().isSpace()) {
+                    line.chop(1);
+                }
+                return true;
+            });
+            break;
+    }
+    if (isCanceled(canceled)) {
+        return QString();
+    }
+    return joinLines(lines);
+}
+
+void LineTransformer::start(const PieceTable &text, qsizetype position, qsizetype length, const LineOperation &operation) { // the piece table is an o(1) snapshot, the result arrives with finished
+    stop();
+    const quint64 generation = ++currentGeneration;
+    canceledFlag = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> canceled = canceledFlag;
+    running = QtConcurrent::run([this, text, position, length, operation, canceled, generation]() {
+        ScopedTimer timer("lineOperation");
+        QElapsedTimer elapsed;
+        elapsed.start();
+        const QString original = text.mid(position, length); // flattened here, not on the gui thread
+        QString result;
+        QString error;
+        try {
+            result = apply(original, operation, canceled.get());
+        } catch (const std::exception &e) {
+            error = QString::fromUtf8(e.what());
+        }
+        if (*canceled) {
+            return;
+        }
+        const qint64 lines = qint64(LineScanner::countNewlines(reinterpret_cast<const char16_t *>(original.utf16()), size_t(original.size()))) + 1;
+        const qint64 resultLines = result.isEmpty() ? 0 : qint64(LineScanner::countNewlines(reinterpret_cast<const char16_t *>(result.utf16()), size_t(result.size()))) + 1;
+        const qint64 milliseconds = elapsed.elapsed();
+        QMetaObject::invokeMethod(this, [this, result, error, lines, resultLines, milliseconds, generation]() {
+            if (generation != currentGeneration) { // stopped or started again in the meantime
+                return;
+            }
+            if (!error.isEmpty()) {
+                emit failed(error);
+            } else {
+                emit finished(result, lines, resultLines, milliseconds);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LineTransformer::stop() {
+    if (canceledFlag) {
+        *canceledFlag = true;
+    }
+    running.waitForFinished();
+    ++currentGeneration;
+}
+
+bool LineTransformer::isRunning() const {
+    return running.isRunning();
+}
@@ -0,0 +1,57 @@
+#ifndef LINETRANSFORMER_H
+#define LINETRANSFORMER_H
+
+#include <QObject>
+#include <QString>
+#include <QFuture>
+#include <atomic>
+#include <memory>
+#include "piecetable.h"
+#include "searchengine.h"
+
+struct LineOperation {
+    enum Kind {
+        Sort, // by the utf-16 code units, stable
+        SortNumeric, // by the number at the start of the line like sort -n, stable
+        Unique, // the first of equal lines is kept
+        Filter,
+        Reverse,
+        Trim // whitespace at the end of the lines
+    };
+
+    Kind kind = Sort;
+    bool descending = false; // sorts only
+    SearchOptions filter; // filter only, lines with a match are kept or removed
+    bool keepMatches = true;
+};
+
+// applies a line operation to a snapshot of the text on the thread pool: the lines are split, sorted by a parallel merge
+// sort, deduplicated by hash in independent shards, filtered and joined again in parallel chunks
+class LineTransformer : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit LineTransformer(QObject *parent = nullptr);
+        ~LineTransformer();
+
+        static constexpr qsizetype blockSize = 1024 * 1024; // characters split into lines per task
+        static constexpr qsizetype chunkLines = 64 * 1024; // lines per task on the thread pool
+        static constexpr int shards = 64; // unique spreads the lines over these by hash, every shard is deduplicated on its own
+
+        static QString apply(const QString &text, const LineOperation &operation, const std::atomic<bool> *canceled = nullptr);
+
+        void start(const PieceTable &text, qsizetype position, qsizetype length, const LineOperation &operation);
+        void stop();
+        bool isRunning() const;
+
+    signals:
+        void finished(const QString &result, qint64 lines, qint64 resultLines, qint64 elapsed); // elapsed in milliseconds
+        void failed(const QString &error);
+
+    private:
+        QFuture<void> running;
+        std::shared_ptr<std::atomic<bool>> canceledFlag;
+        quint64 currentGeneration;
+};
+
+#endif // LINETRANSFORMER_H
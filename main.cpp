@@ -1,12 +1,92 @@
-#include "texteditor.h"
+#include "documenttabs.h"
+#include "singleinstance.h"
+#include "profiler.h"
+#include "batchmode.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTimer>
+
+namespace {
+
+DocumentTabs *newWindow() { // every window deletes itself when closed, the application ends with the last one
+    auto *window = new DocumentTabs;
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    window->show();
+    return window;
+}
+
+void openFiles(const QStringList &files) { // the files become tabs of the active window, or of the first one if none is active
+    if (files.isEmpty()) {
+        newWindow()->activateWindow();
+        return;
+    }
+    auto *target = qobject_cast<DocumentTabs *>(QApplication::activeWindow());
+    for (QWidget *widget : QApplication::topLevelWidgets()) {
+        auto *window = qobject_cast<DocumentTabs *>(widget);
+        if (!target && window && window->isVisible()) {
+            target = window;
+        }
+    }
+    if (!target) {
+        target = newWindow();
+    }
+    target->openFiles(files);
+    target->raise();
+    target->activateWindow();
+}
+
+}
 
 int main(int argc, char *argv[])
 {
+    Profiler::now(); // starts the clock, the startup times are measured from here
+    if (BatchMode::isRequested(argc, argv)) { // scripts on servers without a display, no gui object is ever created
+        return BatchMode::run(argc, argv);
+    }
     QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     QApplication a(argc, argv);
-    TextEditor t;
-    t.show();
+    const qint64 applicationReady = Profiler::now();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("files"), QApplication::translate("main", "Dateien, die geöffnet werden."), QStringLiteral("[files...]"));
+    QCommandLineOption newInstanceOption(QStringLiteral("new-instance"), QApplication::translate("main", "Startet einen eigenen Prozess, auch wenn der Editor schon läuft."));
+    parser.addOption(newInstanceOption);
+    QCommandLineOption memoryBudgetOption(QStringLiteral("memory-budget"), QApplication::translate("main", "Speicher in MB, den alle offenen Dokumente zusammen belegen dürfen."), QStringLiteral("mb"), QString::number(DocumentTabs::defaultMemoryBudget / (1024 * 1024)));
+    parser.addOption(memoryBudgetOption);
+    parser.process(a);
+    const qint64 memoryBudget = parser.value(memoryBudgetOption).toLongLong();
+    if (memoryBudget > 0) {
+        DocumentTabs::setMemoryBudget(memoryBudget * 1024 * 1024); // the least recently shown documents are evicted beyond it
+    }
+
+    QStringList files;
+    for (const QString &file : parser.positionalArguments()) {
+        files.append(QFileInfo(file).absoluteFilePath()); // the running instance may have another working directory
+    }
+
+    SingleInstance instance(QStringLiteral("schlichting_texteditor"));
+    if (!parser.isSet(newInstanceOption)) {
+        if (instance.forward(files)) {
+            qInfo("startup: handed over to the running instance after %.1f ms", Profiler::now() / 1e6);
+            return 0;
+        }
+        if (!instance.listen() && instance.forward(files)) { // another start was faster
+            return 0;
+        }
+        QObject::connect(&instance, &SingleInstance::filesReceived, &openFiles);
+    }
+
+    DocumentTabs *first = newWindow();
+    qInfo("startup: application after %.1f ms, window after %.1f ms", applicationReady / 1e6, Profiler::now() / 1e6);
+    if (!files.isEmpty()) {
+        openFiles(files);
+    } else {
+        QTimer::singleShot(0, first, [first]() {
+            first->current()->recoverSession(); // crashed sessions are only offered to a window that is still empty
+        });
+    }
     return a.exec();
 }
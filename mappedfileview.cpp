@@ -0,0 +1,369 @@
+#include "mappedfileview.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QKeyEvent>
+#include <QWheelEvent>
+#include <QScrollBar>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QTimer>
+#include <QMetaObject>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr qint64 maxLineLength = 4096; // longer lines are shown in pieces of this many bytes
+constexpr int scrollRange = 1 << 24; // the scrollbar works on a fixed range until the lines are counted
+constexpr qint64 indexSlice = 64 * 1024 * 1024; // the indexer checks for cancellation after every slice
+}
+
+MappedFileView::MappedFileView(QWidget *parent): QAbstractScrollArea(parent), data(nullptr), size(0), topOffset(0), widestLine(0), syncingScrollBar(false), indexReady(false), indexer(nullptr), indexCanceled(false), indexGeneration(0) { // constructor
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont)); // logs and dumps are easier to read in a monospace font
+    setFocusPolicy(Qt::StrongFocus);
+    verticalScrollBar()->setRange(0, 0);
+}
+
+MappedFileView::~MappedFileView() {
+    close();
+}
+
+bool MappedFileView::canShow(const QString &fileName) { // only the first bytes are read, utf-16 without a mark is told by its zero bytes
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return true; // open reports the error
+    }
+    const QByteArray head = file.read(4096);
+    const TextCodec::Encoding encoding = TextCodec::detect(head.constData(), head.size()).encoding;
+    return encoding != TextCodec::Encoding::Utf16LE && encoding != TextCodec::Encoding::Utf16BE;
+}
+
+void MappedFileView::open(const QString &fileName) { // maps the file, nothing is read until it is drawn
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    size = file.size();
+    if (size > 0) {
+        data = file.map(0, size); // only the address space is reserved, the os pages in what is actually drawn
+        if (!data) {
+            std::string error = file.errorString().toStdString();
+            file.close();
+            size = 0;
+            throw std::runtime_error("Kann nicht einlesen: " + error);
+        }
+    }
+    textFormat = TextCodec::detect(bytes(), qMin(size, detectBytes));
+    updateScrollBars();
+    setTopOffset(0);
+    startIndexing(); // lines are counted in the background, until then the scrollbar works on bytes
+}
+
+void MappedFileView::close() { // releases the mapping and the file handle
+    stopIndexing(); // the indexer reads from the mapping, so it has to stop first
+    if (data) {
+        file.unmap(const_cast<uchar *>(data));
+    }
+    if (file.isOpen()) {
+        file.close();
+    }
+    data = nullptr;
+    size = 0;
+    textFormat = TextCodec::Format();
+    topOffset = 0;
+    widestLine = 0;
+    viewport()->update();
+}
+
+bool MappedFileView::isOpen() const {
+    return file.isOpen();
+}
+
+QString MappedFileView::fileName() const {
+    return file.fileName();
+}
+
+qint64 MappedFileView::fileSize() const {
+    return size;
+}
+
+TextCodec::Format MappedFileView::format() const {
+    return textFormat;
+}
+
+qint64 MappedFileView::lineCount() const { // -1 while the lines are still being counted
+    return indexReady ? lineIndex.lineCount() : -1;
+}
+
+qint64 MappedFileView::currentLine() const { // 1-based line at the top of the viewport, -1 while counting
+    return indexReady ? lineIndex.lineAt(topOffset, bytes()) + 1 : -1;
+}
+
+void MappedFileView::goToLine(qint64 line) { // 1-based, jumps via the line index without scanning the file
+    if (indexReady) {
+        setTopOffset(lineIndex.lineStart(line - 1, bytes(), size_t(size)));
+    }
+}
+
+void MappedFileView::paintEvent(QPaintEvent *event) { // decodes and draws only the lines that fit into the viewport
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+    if (!data) {
+        return;
+    }
+    painter.setPen(palette().text().color());
+
+    QFontMetrics metrics(font());
+    int lineHeight = metrics.lineSpacing();
+    int x = 4 - horizontalScrollBar()->value();
+    int y = metrics.ascent();
+    int widest = widestLine;
+    qint64 offset = topOffset;
+    while (y - metrics.ascent() < viewport()->height() && offset < size) {
+        QString line = decodeLine(offset);
+        painter.drawText(x, y, line);
+        widest = qMax(widest, metrics.horizontalAdvance(line) + 8); // the horizontal scrollbar grows with the widest line seen so far
+        offset = nextLine(offset);
+        y += lineHeight;
+    }
+
+    if (widest != widestLine) {
+        widestLine = widest;
+        QTimer::singleShot(0, this, &MappedFileView::updateScrollBars); // not changed while painting
+    }
+}
+
+void MappedFileView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void MappedFileView::keyPressEvent(QKeyEvent *event) { // keyboard navigation moves line by line through the mapping
+    int page = qMax(1, visibleLineCount() - 1);
+    switch (event->key()) {
+    case Qt::Key_Up:
+        scrollLines(-1);
+        break;
+    case Qt::Key_Down:
+        scrollLines(1);
+        break;
+    case Qt::Key_PageUp:
+        scrollLines(-page);
+        break;
+    case Qt::Key_PageDown:
+        scrollLines(page);
+        break;
+    case Qt::Key_Home:
+        setTopOffset(0);
+        break;
+    case Qt::Key_End:
+        setTopOffset(lastPageOffset());
+        break;
+    case Qt::Key_Left:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub);
+        break;
+    case Qt::Key_Right:
+        horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void MappedFileView::wheelEvent(QWheelEvent *event) { // the wheel scrolls three lines per notch like qtextedit
+    int lines = -event->angleDelta().y() / 40;
+    if (lines != 0) {
+        scrollLines(lines);
+    }
+    if (event->angleDelta().x() != 0) {
+        horizontalScrollBar()->setValue(horizontalScrollBar()->value() - event->angleDelta().x() / 2);
+    }
+    event->accept();
+}
+
+void MappedFileView::scrollContentsBy(int dx, int dy) { // called when the scrollbars are dragged
+    Q_UNUSED(dx)
+    if (dy != 0 && !syncingScrollBar) {
+        int value = verticalScrollBar()->value();
+        if (lineScrolling()) { // the scrollbar value is the line number once the lines are counted
+            topOffset = lineIndex.lineStart(value, bytes(), size_t(size));
+        } else if (value >= verticalScrollBar()->maximum()) {
+            topOffset = lastPageOffset();
+        } else {
+            topOffset = lineStart(qint64(double(value) / scrollRange * size)); // jumps to the start of the line at that position
+        }
+        emit positionChanged();
+    }
+    viewport()->update();
+}
+
+qint64 MappedFileView::characterStart(qint64 offset) const { // moves back onto the first byte of a utf-8 sequence
+    if (textFormat.encoding != TextCodec::Encoding::Utf8) { // every latin-1 byte is a character
+        return offset;
+    }
+    for (int i = 0; i < 3 && offset > 0 && offset < size && (data[offset] & 0xC0) == 0x80; ++i) {
+        --offset;
+    }
+    return offset;
+}
+
+qint64 MappedFileView::lineStart(qint64 offset) const { // start of the line containing offset, searches back at most one piece
+    qint64 limit = qMax<qint64>(0, offset - maxLineLength);
+    for (qint64 i = offset; i > limit; --i) {
+        if (data[i - 1] == '\n') {
+            return i;
+        }
+    }
+    return characterStart(limit);
+}
+
+qint64 MappedFileView::lineEnd(qint64 offset) const { // position of the newline or the end of the piece
+    qint64 length = qMin(maxLineLength, size - offset);
+    const void *hit = std::memchr(data + offset, '\n', size_t(length));
+    if (hit) {
+        return static_cast<const uchar *>(hit) - data;
+    }
+    qint64 end = characterStart(offset + length);
+    return end > offset ? end : offset + length;
+}
+
+qint64 MappedFileView::nextLine(qint64 offset) const {
+    qint64 end = lineEnd(offset);
+    return end < size && data[end] == '\n' ? end + 1 : end;
+}
+
+qint64 MappedFileView::previousLine(qint64 offset) const {
+    if (offset <= 0) {
+        return 0;
+    }
+    return lineStart(offset - 1);
+}
+
+qint64 MappedFileView::lastPageOffset() const { // first line of the last full screen
+    qint64 offset = size;
+    for (int i = 0; i < visibleLineCount() && offset > 0; ++i) {
+        offset = previousLine(offset);
+    }
+    return offset;
+}
+
+QString MappedFileView::decodeLine(qint64 offset) const { // only this one line is decoded
+    qint64 end = lineEnd(offset);
+    TextDecoder decoder(textFormat); // the byte order mark in front of the first line is skipped
+    QString line = decoder.decode(QByteArray::fromRawData(bytes() + offset, end - offset));
+    line += decoder.finish();
+    if (line.endsWith(QLatin1Char('\r'))) { // windows line endings
+        line.chop(1);
+    }
+    line.replace(QLatin1Char('\t'), QLatin1String("    "));
+    return line;
+}
+
+int MappedFileView::visibleLineCount() const {
+    return qMax(1, viewport()->height() / QFontMetrics(font()).lineSpacing());
+}
+
+void MappedFileView::scrollLines(int count) { // moves the first visible line by count lines
+    if (!data) {
+        return;
+    }
+    qint64 offset = topOffset;
+    if (count > 0) {
+        qint64 last = lastPageOffset();
+        for (int i = 0; i < count && offset < last; ++i) {
+            offset = nextLine(offset);
+        }
+    } else {
+        for (int i = 0; i > count && offset > 0; --i) {
+            offset = previousLine(offset);
+        }
+    }
+    setTopOffset(offset);
+}
+
+void MappedFileView::setTopOffset(qint64 offset) { // moves the view and the scrollbar without jumping back to a line start
+    topOffset = qBound<qint64>(0, offset, size);
+    syncingScrollBar = true;
+    if (lineScrolling()) {
+        verticalScrollBar()->setValue(int(lineIndex.lineAt(topOffset, bytes())));
+    } else {
+        verticalScrollBar()->setValue(size > 0 ? int(double(topOffset) / size * scrollRange) : 0);
+    }
+    syncingScrollBar = false;
+    viewport()->update();
+    emit positionChanged();
+}
+
+void MappedFileView::updateScrollBars() {
+    if (lineScrolling()) { // exact geometry from the line index
+        verticalScrollBar()->setRange(0, int(qMax<qint64>(0, lineIndex.lineCount() - visibleLineCount())));
+        verticalScrollBar()->setPageStep(visibleLineCount());
+    } else {
+        verticalScrollBar()->setRange(0, size > 0 ? scrollRange : 0);
+        verticalScrollBar()->setPageStep(qMax(1, scrollRange / 100));
+    }
+    horizontalScrollBar()->setRange(0, qMax(0, widestLine - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(QFontMetrics(font()).horizontalAdvance(QLatin1Char('x')) * 4);
+}
+
+void MappedFileView::startIndexing() { // builds the line index on a worker thread with the vectorized scanner
+    indexCanceled = false;
+    const quint64 generation = ++indexGeneration;
+    const char *buffer = bytes();
+    const qint64 length = size;
+    const bool checkUtf8 = textFormat.encoding == TextCodec::Encoding::Utf8 && !textFormat.bom; // a mark settles it, latin-1 is settled anyway
+    indexer = QThread::create([this, buffer, length, checkUtf8, generation]() {
+        LineIndex index;
+        bool latin1 = false;
+        for (qint64 offset = 0; offset < length && !indexCanceled; offset += indexSlice) {
+            const qint64 slice = qMin(indexSlice, length - offset);
+            index.append(buffer + offset, size_t(slice));
+            if (checkUtf8 && !latin1) { // the same rule as TextCodec::detect, one sequence anywhere that isn't utf-8 makes the file latin-1
+                qint64 start = offset;
+                while (start < offset + slice && start - offset < 3 && (uchar(buffer[start]) & 0xc0) == 0x80) { // the end of a sequence from the slice before
+                    ++start;
+                }
+                latin1 = TextCodec::detect(buffer + start, offset + slice - start).encoding == TextCodec::Encoding::Latin1;
+            }
+        }
+        if (indexCanceled) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, index, latin1, generation]() mutable {
+            if (generation != indexGeneration) { // the file was closed in the meantime
+                return;
+            }
+            if (latin1) {
+                textFormat.encoding = TextCodec::Encoding::Latin1;
+            }
+            lineIndex = std::move(index);
+            indexReady = true;
+            updateScrollBars();
+            setTopOffset(topOffset); // the scrollbar switches from bytes to lines
+            emit lineIndexReady();
+        }, Qt::QueuedConnection);
+    });
+    indexer->start();
+}
+
+void MappedFileView::stopIndexing() {
+    indexCanceled = true;
+    if (indexer) {
+        indexer->wait();
+        delete indexer;
+        indexer = nullptr;
+    }
+    ++indexGeneration; // a result that is still queued is dropped
+    lineIndex.clear();
+    indexReady = false;
+}
+
+bool MappedFileView::lineScrolling() const { // lines are used for the scrollbar once counted, unless there are more than an int can hold
+    return indexReady && lineIndex.lineCount() < INT_MAX;
+}
+
+const char *MappedFileView::bytes() const {
+    return reinterpret_cast<const char *>(data);
+}
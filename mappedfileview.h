@@ -0,0 +1,77 @@
+#ifndef MAPPEDFILEVIEW_H
+#define MAPPEDFILEVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QFile>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include "lineindex.h"
+#include "textcodec.h"
+
+// read-only viewer for huge files, only the visible lines of the memory mapping are decoded and drawn, in utf-8 or
+// latin-1 like the loader would, utf-16 is left to the loader because the line index only finds byte newlines
+class MappedFileView : public QAbstractScrollArea {
+    Q_OBJECT
+
+    public:
+        explicit MappedFileView(QWidget *parent = nullptr);
+        ~MappedFileView();
+
+        static constexpr qint64 threshold = 256 * 1024 * 1024; // files of at least this size are opened in this viewer
+        static constexpr qint64 detectBytes = 1024 * 1024; // the encoding is guessed from these, the indexer checks the rest
+
+        static bool canShow(const QString &fileName); // false for utf-16
+        void open(const QString &fileName);
+        void close();
+        bool isOpen() const;
+        QString fileName() const;
+        qint64 fileSize() const;
+        TextCodec::Format format() const;
+        qint64 lineCount() const;
+        qint64 currentLine() const;
+        void goToLine(qint64 line);
+
+    signals:
+        void positionChanged();
+        void lineIndexReady();
+
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+        void resizeEvent(QResizeEvent *event) override;
+        void keyPressEvent(QKeyEvent *event) override;
+        void wheelEvent(QWheelEvent *event) override;
+        void scrollContentsBy(int dx, int dy) override;
+
+    private:
+        qint64 characterStart(qint64 offset) const;
+        qint64 lineStart(qint64 offset) const;
+        qint64 nextLine(qint64 offset) const;
+        qint64 previousLine(qint64 offset) const;
+        qint64 lineEnd(qint64 offset) const;
+        qint64 lastPageOffset() const;
+        QString decodeLine(qint64 offset) const;
+        int visibleLineCount() const;
+        void scrollLines(int count);
+        void setTopOffset(qint64 offset);
+        void updateScrollBars();
+        void startIndexing();
+        void stopIndexing();
+        bool lineScrolling() const;
+        const char *bytes() const;
+
+        QFile file;
+        const uchar *data;
+        qint64 size;
+        TextCodec::Format textFormat; // turns to latin-1 once the indexer finds bytes that aren't utf-8
+        qint64 topOffset;
+        int widestLine;
+        bool syncingScrollBar;
+        LineIndex lineIndex;
+        bool indexReady;
+        QThread *indexer;
+        std::atomic<bool> indexCanceled;
+        quint64 indexGeneration;
+};
+
+#endif // MAPPEDFILEVIEW_H
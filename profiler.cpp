@@ -0,0 +1,156 @@
+#include "profiler.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QByteArray>
+#include <QThread>
+#include <QSaveFile>
+#include <QCoreApplication>
+#include <algorithm>
+#include <stdexcept>
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace {
+
+struct Histogram {
+    QVector<qint64> samples; // ring buffer of the latest durations
+    int next = 0;
+};
+
+struct TraceEvent {
+    const char *name;
+    qint64 start;
+    qint64 duration;
+    quint64 thread;
+};
+
+struct State {
+    QMutex mutex; // timers run on the gui thread and on the loader, saver and journal threads
+    QElapsedTimer clock;
+    QHash<QByteArray, Histogram> histograms;
+    QVector<TraceEvent> trace;
+
+    State() { // constructor
+        clock.start();
+    }
+};
+
+State &state() {
+    static State instance;
+    return instance;
+}
+
+quint64 currentThread() {
+    return quint64(quintptr(QThread::currentThreadId()));
+}
+
+}
+
+void Profiler::setEnabled(bool value) { // the collected data is kept, so a session can be paused and exported later
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+qint64 Profiler::now() {
+    return state().clock.nsecsElapsed();
+}
+
+void Profiler::record(const char *name, qint64 start, qint64 duration) {
+    if (!isEnabled()) {
+        return;
+    }
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    Histogram &histogram = s.histograms[QByteArray::fromRawData(name, int(qstrlen(name)))];
+    if (histogram.samples.size() < historySize) {
+        histogram.samples.append(duration);
+    } else {
+        histogram.samples[histogram.next] = duration;
+        histogram.next = (histogram.next + 1) % historySize;
+    }
+    if (s.trace.size() < maxTraceEvents) {
+        s.trace.append({name, start, duration, currentThread()});
+    }
+}
+
+LatencyStats Profiler::stats(const char *name) { // percentiles over the rolling window of one timer
+    QVector<qint64> samples;
+    {
+        State &s = state();
+        QMutexLocker locker(&s.mutex);
+        samples = s.histograms.value(QByteArray(name)).samples;
+    }
+    LatencyStats result;
+    if (samples.isEmpty()) {
+        return result;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples.at(qMin(samples.size() - 1, int(p * samples.size()))) / 1e6;
+    };
+    result.count = samples.size();
+    result.p50 = percentile(0.5);
+    result.p99 = percentile(0.99);
+    result.max = samples.last() / 1e6;
+    return result;
+}
+
+QStringList Profiler::names() {
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    QStringList result;
+    for (auto it = s.histograms.cbegin(); it != s.histograms.cend(); ++it) {
+        result.append(QString::fromLatin1(it.key()));
+    }
+    result.sort();
+    return result;
+}
+
+void Profiler::clear() {
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    s.histograms.clear();
+    s.trace.clear();
+}
+
+void Profiler::exportTrace(const QString &fileName) { // trace event format with complete events, opens in chrome://tracing and perfetto
+    QVector<TraceEvent> events;
+    {
+        State &s = state();
+        QMutexLocker locker(&s.mutex);
+        events = s.trace; // written without the lock, timers go on meanwhile
+    }
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    const quint64 gui = currentThread(); // exported from the gui thread
+    QSet<quint64> threads;
+
+    QByteArray json;
+    json.reserve(events.size() * 96 + 256);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const TraceEvent &event : events) {
+        threads.insert(event.thread);
+        json += "{\"name\":\"";
+        json += event.name; // names are literals of our own, nothing to escape
+        json += "\",\"cat\":\"editor\",\"ph\":\"X\",\"ts\":";
+        json += QByteArray::number(event.start / 1000.0, 'f', 3); // microseconds
+        json += ",\"dur\":";
+        json += QByteArray::number(event.duration / 1000.0, 'f', 3);
+        json += ",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(event.thread) + "},\n";
+    }
+    for (quint64 thread : threads) { // names the threads in the viewer
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(thread);
+        json += thread == gui ? ",\"args\":{\"name\":\"gui\"}},\n" : ",\"args\":{\"name\":\"worker\"}},\n";
+    }
+    if (json.endsWith(",\n")) {
+        json.chop(2);
+    }
+    json += "\n]}\n";
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        throw std::runtime_error("Kann nicht speichern: " + file.errorString().toStdString());
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+
+struct LatencyStats {
+    int count = 0;
+    double p50 = 0; // milliseconds
+    double p99 = 0;
+    double max = 0;
+};
+
+// built-in profiler, scoped timers feed rolling latency histograms and a trace that can be exported for chrome://tracing,
+// while it is disabled a timer costs one relaxed atomic load
+class Profiler {
+    public:
+        static constexpr int historySize = 1024; // percentiles are taken over the latest samples of every timer
+        static constexpr int maxTraceEvents = 1000000; // recording stops once the trace is full, about 40 mb
+
+        static bool isEnabled() {
+            return enabled.load(std::memory_order_relaxed);
+        }
+        static void setEnabled(bool value);
+        static qint64 now(); // nanoseconds since the start of the profiler
+        static void record(const char *name, qint64 start, qint64 duration);
+        static LatencyStats stats(const char *name);
+        static QStringList names();
+        static void clear();
+        static void exportTrace(const QString &fileName);
+
+    private:
+        static std::atomic<bool> enabled;
+};
+
+// measures its own lifetime, names must be string literals since only the pointer is kept
+class ScopedTimer {
+    public:
+        explicit ScopedTimer(const char *label): name(Profiler::isEnabled() ? label : nullptr), start(name ? Profiler::now() : 0) {} // constructor
+        ~ScopedTimer() {
+            if (name) {
+                Profiler::record(name, start, Profiler::now() - start);
+            }
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        const char *name;
+        qint64 start;
+};
+
+#endif // PROFILER_H
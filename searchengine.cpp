@@ -0,0 +1,284 @@
+#include "searchengine.h"
+#include <QtConcurrent>
+#include <QRegularExpressionMatch>
+
+namespace {
+constexpr qsizetype previousWindow = 64 * 1024; // backward regex search looks at growing windows before the cursor
+
+QRegularExpressionMatch matchView(const QRegularExpression &expression, QStringView view, qsizetype offset, QRegularExpression::MatchOptions options = QRegularExpression::NoMatchOption) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
+    return expression.matchView(view, offset, QRegularExpression::NormalMatch, options);
+#else
+    return expression.match(view, offset, QRegularExpression::NormalMatch, options);
+#endif
+}
+
+qsizetype lineBegin(QStringView text, qsizetype position) { // start of the line containing position
+    return position > 0 ? text.first(position).lastIndexOf(QLatin1Char('\n')) + 1 : 0;
+}
+
+qsizetype lineFinish(QStringView text, qsizetype position) { // position behind the newline ending the line, or the end of the text
+    qsizetype newline = text.indexOf(QLatin1Char('\n'), position);
+    return newline < 0 ? text.size() : newline + 1;
+}
+}
+
+SearchEngine::SearchEngine(const SearchOptions &options): options(options) { // constructor, prepares the shift table or the expression once
+    if (options.regex) {
+        QRegularExpression::PatternOptions patternOptions = QRegularExpression::MultilineOption; // ^ and $ match at every line like in other editors
+        if (!options.caseSensitive) {
+            patternOptions |= QRegularExpression::CaseInsensitiveOption;
+        }
+        expression = QRegularExpression(options.pattern, patternOptions);
+        expression.optimize(); // the expression is used from several threads, so it is compiled up front
+    }
+
+    folded.reserve(options.pattern.size());
+    for (QChar c : options.pattern) {
+        folded.append(QChar(fold(c.unicode())));
+    }
+    qsizetype length = folded.size();
+    for (qsizetype &shift : shifts) { // horspool table on the low byte, characters sharing a byte get the smallest shift
+        shift = length;
+    }
+    for (qsizetype i = 0; i + 1 < length; ++i) {
+        shifts[folded.at(i).unicode() & 0xFF] = length - 1 - i;
+    }
+}
+
+bool SearchEngine::isValid() const {
+    return !options.pattern.isEmpty() && (!options.regex || expression.isValid());
+}
+
+QString SearchEngine::errorString() const {
+    if (options.pattern.isEmpty()) {
+        return QObject::tr("Kein Suchbegriff");
+    }
+    return options.regex && !expression.isValid() ? expression.errorString() : QString();
+}
+
+SearchMatch SearchEngine::findNext(QStringView text, qsizetype from) const { // first match starting at or after from
+    return find(text, qBound<qsizetype>(0, from, text.size()), text.size());
+}
+
+SearchMatch SearchEngine::findPrevious(QStringView text, qsizetype before) const { // last match starting before the given position
+    before = qBound<qsizetype>(0, before, text.size());
+    for (qsizetype window = previousWindow; ; window *= 4) { // most matches are close, so the whole text is rarely searched
+        qsizetype begin = lineBegin(text, qMax<qsizetype>(0, before - window));
+        QVector<SearchMatch> matches = findAll(text, begin, before);
+        if (!matches.isEmpty()) {
+            return matches.last();
+        }
+        if (begin == 0) {
+            return SearchMatch();
+        }
+    }
+}
+
+QVector<SearchMatch> SearchEngine::findAll(QStringView text, qsizetype begin, qsizetype end) const { // matches starting in [begin, end), used for the visible range
+    QVector<SearchMatch> matches;
+    if (!isValid()) {
+        return matches;
+    }
+    end = qBound<qsizetype>(0, end, text.size());
+    for (SearchMatch match = find(text, qMax<qsizetype>(0, begin), end); match.isValid(); match = find(text, match.end(), end)) {
+        matches.append(match);
+    }
+    return matches;
+}
+
+QVector<SearchMatch> SearchEngine::findAllParallel(const QString &text, const std::atomic<bool> *canceled) const { // every match of the text, chunks are searched on the thread pool
+    QVector<SearchMatch> matches;
+    if (!isValid()) {
+        return matches;
+    }
+    QList<QVector<SearchMatch>> parts = QtConcurrent::blockingMapped<QList<QVector<SearchMatch>>>(chunks(text), [this, &text, canceled](const Chunk &chunk) {
+        QVector<SearchMatch> part;
+        for (SearchMatch match = find(text, chunk.begin, chunk.end); match.isValid(); match = find(text, match.end(), chunk.end)) {
+            if (canceled && *canceled) {
+                break;
+            }
+            part.append(match);
+        }
+        return part;
+    });
+    if (canceled && *canceled) {
+        return QVector<SearchMatch>();
+    }
+    for (const QVector<SearchMatch> &part : parts) { // a literal match may reach into the next chunk, overlapping matches there are dropped
+        for (const SearchMatch &match : part) {
+            if (matches.isEmpty() || match.position >= matches.last().end()) {
+                matches.append(match);
+            }
+        }
+    }
+    return matches;
+}
+
+qsizetype SearchEngine::countParallel(const QString &text, const std::atomic<bool> *canceled) const { // like findAllParallel, but nothing is stored
+    if (!isValid()) {
+        return 0;
+    }
+    struct Count {
+        qsizetype count = 0;
+        SearchMatch first;
+        SearchMatch last;
+    };
+    QList<Count> parts = QtConcurrent::blockingMapped<QList<Count>>(chunks(text), [this, &text, canceled](const Chunk &chunk) {
+        Count part;
+        for (SearchMatch match = find(text, chunk.begin, chunk.end); match.isValid() && !(canceled && *canceled); match = find(text, match.end(), chunk.end)) {
+            if (part.count++ == 0) {
+                part.first = match;
+            }
+            part.last = match;
+        }
+        return part;
+    });
+    if (canceled && *canceled) {
+        return 0;
+    }
+    qsizetype count = 0;
+    qsizetype previousEnd = 0;
+    for (const Count &part : parts) { // same overlap rule as findAllParallel, only the first match of a chunk can reach back into the previous one
+        if (part.count == 0) {
+            continue;
+        }
+        count += part.first.position < previousEnd ? part.count - 1 : part.count;
+        previousEnd = part.last.end();
+    }
+    return count;
+}
+
+QString SearchEngine::replacement(QStringView text, const SearchMatch &match, const QString &replaceWith) const { // replacement for one match, \0 to \9 insert the captured groups of a regex
+    if (!options.regex || !replaceWith.contains(QLatin1Char('\\'))) {
+        return replaceWith;
+    }
+    qsizetype begin = lineBegin(text, match.position);
+    QStringView view = text.sliced(begin, lineFinish(text, qMax(match.position, match.end() - 1)) - begin);
+    QRegularExpressionMatch captures = matchView(expression, view, match.position - begin, QRegularExpression::AnchorAtOffsetMatchOption);
+
+    QString result;
+    result.reserve(replaceWith.size());
+    for (qsizetype i = 0; i < replaceWith.size(); ++i) {
+        QChar c = replaceWith.at(i);
+        if (c == QLatin1Char('\\') && i + 1 < replaceWith.size()) {
+            QChar next = replaceWith.at(++i);
+            if (next.isDigit()) {
+                result += captures.captured(next.digitValue());
+            } else if (next == QLatin1Char('n')) {
+                result += QLatin1Char('\n');
+            } else if (next == QLatin1Char('t')) {
+                result += QLatin1Char('\t');
+            } else {
+                result += next; // \\ and unknown escapes stand for the character itself
+            }
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+QString SearchEngine::replaceAllParallel(const QString &text, const QVector<SearchMatch> &matches, const QString &replaceWith) const { // new text for the range from the first to the end of the last match
+    if (matches.isEmpty()) {
+        return QString();
+    }
+    QVector<QPair<qsizetype, qsizetype>> groups; // ranges of matches that are assembled on one thread each
+    qsizetype first = 0;
+    for (qsizetype i = 1; i <= matches.size(); ++i) {
+        if (i == matches.size() || matches.at(i).position - matches.at(first).position >= parallelChunkSize) {
+            groups.append(qMakePair(first, i));
+            first = i;
+        }
+    }
+    QList<QString> parts = QtConcurrent::blockingMapped<QList<QString>>(groups, [this, &text, &matches, &replaceWith](const QPair<qsizetype, qsizetype> &group) {
+        qsizetype stop = group.second < matches.size() ? matches.at(group.second).position : matches.last().end(); // text up to the next group belongs to this part
+        QString part;
+        part.reserve(stop - matches.at(group.first).position);
+        for (qsizetype i = group.first; i < group.second; ++i) {
+            const SearchMatch &match = matches.at(i);
+            part += replacement(text, match, replaceWith);
+            qsizetype next = i + 1 < matches.size() ? matches.at(i + 1).position : stop;
+            part += QStringView(text).sliced(match.end(), qMin(next, stop) - match.end());
+        }
+        return part;
+    });
+
+    qsizetype length = 0;
+    for (const QString &part : parts) {
+        length += part.size();
+    }
+    QString result;
+    result.reserve(length);
+    for (const QString &part : parts) {
+        result += part;
+    }
+    return result;
+}
+
+SearchMatch SearchEngine::findLiteral(QStringView text, qsizetype from, qsizetype end) const { // boyer-moore-horspool, compares from the last character of the pattern
+    const qsizetype length = folded.size();
+    const char16_t *data = reinterpret_cast<const char16_t *>(text.utf16());
+    const char16_t *pattern = reinterpret_cast<const char16_t *>(folded.utf16());
+    const qsizetype size = text.size();
+
+    if (length == 1 && options.caseSensitive) { // a single character is found by the vectorized search of qt
+        qsizetype position = text.first(qMin(size, end)).indexOf(QChar(pattern[0]), from);
+        return position < 0 ? SearchMatch() : SearchMatch{position, 1};
+    }
+    for (qsizetype position = from; position < end && position + length <= size; ) {
+        qsizetype i = length - 1;
+        while (i >= 0 && fold(data[position + i]) == pattern[i]) {
+            --i;
+        }
+        if (i < 0) {
+            return SearchMatch{position, length};
+        }
+        position += shifts[fold(data[position + length - 1]) & 0xFF];
+    }
+    return SearchMatch();
+}
+
+SearchMatch SearchEngine::findRegex(QStringView text, qsizetype from, qsizetype end) const { // the expression only sees the lines around the range, so a chunk never scans the whole text
+    qsizetype begin = lineBegin(text, from);
+    QStringView view = text.sliced(begin, lineFinish(text, qMax(from, end - 1)) - begin);
+    for (qsizetype offset = from - begin; offset < end - begin; ) {
+        QRegularExpressionMatch match = matchView(expression, view, offset);
+        if (!match.hasMatch() || match.capturedStart() + begin >= end) {
+            break;
+        }
+        if (match.capturedLength() > 0) {
+            return SearchMatch{match.capturedStart() + begin, match.capturedLength()};
+        }
+        offset = match.capturedStart() + 1; // empty matches (e.g. a lone ^) are skipped, they could neither be highlighted nor selected
+    }
+    return SearchMatch();
+}
+
+SearchMatch SearchEngine::find(QStringView text, qsizetype from, qsizetype end) const { // first match starting in [from, end)
+    if (!isValid() || from >= end) {
+        return SearchMatch();
+    }
+    return options.regex ? findRegex(text, from, end) : findLiteral(text, from, end);
+}
+
+QVector<SearchEngine::Chunk> SearchEngine::chunks(QStringView text) const { // splits the text at line starts, regex matches are found within a chunk's lines
+    QVector<Chunk> result;
+    for (qsizetype begin = 0; begin < text.size(); ) {
+        qsizetype end = begin + parallelChunkSize < text.size() ? lineFinish(text, begin + parallelChunkSize) : text.size();
+        result.append(Chunk{begin, end});
+        begin = end;
+    }
+    return result;
+}
+
+char16_t SearchEngine::fold(char16_t c) const { // case folding for case-insensitive search, ascii is handled without a table lookup
+    if (options.caseSensitive) {
+        return c;
+    }
+    if (c < 0x80) {
+        return c >= u'A' && c <= u'Z' ? char16_t(c + 32) : c;
+    }
+    char32_t result = QChar::toCaseFolded(char32_t(c));
+    return result <= 0xFFFF ? char16_t(result) : c;
+}
@@ -0,0 +1,59 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QString>
+#include <QStringView>
+#include <QRegularExpression>
+#include <QVector>
+#include <atomic>
+
+struct SearchOptions {
+    QString pattern;
+    bool regex = false;
+    bool caseSensitive = false;
+};
+
+struct SearchMatch {
+    qsizetype position = -1;
+    qsizetype length = 0;
+
+    bool isValid() const { return position >= 0; }
+    qsizetype end() const { return position + length; }
+};
+
+// literal (boyer-moore-horspool) and regex search over utf-16 text, big texts are searched in parallel chunks
+class SearchEngine {
+    public:
+        explicit SearchEngine(const SearchOptions &options);
+
+        static constexpr qsizetype parallelChunkSize = 4 * 1024 * 1024; // characters per chunk on the thread pool
+
+        bool isValid() const;
+        QString errorString() const;
+        SearchMatch findNext(QStringView text, qsizetype from) const;
+        SearchMatch findPrevious(QStringView text, qsizetype before) const;
+        QVector<SearchMatch> findAll(QStringView text, qsizetype begin, qsizetype end) const;
+        QVector<SearchMatch> findAllParallel(const QString &text, const std::atomic<bool> *canceled = nullptr) const;
+        qsizetype countParallel(const QString &text, const std::atomic<bool> *canceled = nullptr) const;
+        QString replacement(QStringView text, const SearchMatch &match, const QString &replaceWith) const;
+        QString replaceAllParallel(const QString &text, const QVector<SearchMatch> &matches, const QString &replaceWith) const;
+
+    private:
+        struct Chunk {
+            qsizetype begin;
+            qsizetype end;
+        };
+
+        SearchMatch findLiteral(QStringView text, qsizetype from, qsizetype end) const;
+        SearchMatch findRegex(QStringView text, qsizetype from, qsizetype end) const;
+        SearchMatch find(QStringView text, qsizetype from, qsizetype end) const;
+        QVector<Chunk> chunks(QStringView text) const;
+        char16_t fold(char16_t c) const;
+
+        SearchOptions options;
+        QRegularExpression expression;
+        QString folded;
+        qsizetype shifts[256];
+};
+
+#endif // SEARCHENGINE_H
@@ -0,0 +1,63 @@
+#include "singleinstance.h"
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+SingleInstance::SingleInstance(const QString &name, QObject *parent): QObject(parent) { // constructor
+    // one server per user, the socket name must not contain the user name itself since it may hold characters a pipe name can't
+    QByteArray user = qgetenv("USER") + qgetenv("USERNAME");
+    serverName = name + QLatin1Char('-') + QString::fromLatin1(QCryptographicHash::hash(user, QCryptographicHash::Sha1).toHex().left(12));
+    connect(&server, &QLocalServer::newConnection, this, &SingleInstance::newConnection);
+}
+
+bool SingleInstance::forward(const QStringList &files) { // true once the running instance confirmed it got the files
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(timeout)) {
+        return false;
+    }
+    QByteArray block;
+    QDataStream out(&block, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << files;
+    socket.write(block);
+    if (!socket.waitForBytesWritten(timeout)) {
+        return false;
+    }
+    return socket.waitForReadyRead(timeout) && socket.read(1) == "1"; // without the answer an instance that is just quitting would swallow the files
+}
+
+bool SingleInstance::listen() { // false if another instance is listening already
+    if (server.listen(serverName)) {
+        return true;
+    }
+    if (server.serverError() != QAbstractSocket::AddressInUseError) {
+        return false;
+    }
+    QLocalSocket probe;
+    probe.connectToServer(serverName);
+    if (probe.waitForConnected(timeout)) { // another start won the race
+        return false;
+    }
+    QLocalServer::removeServer(serverName); // a crashed instance left its socket file behind
+    return server.listen(serverName);
+}
+
+void SingleInstance::newConnection() {
+    while (QLocalSocket *socket = server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            QDataStream in(socket);
+            in.setVersion(QDataStream::Qt_6_0);
+            in.startTransaction();
+            QStringList files;
+            in >> files;
+            if (!in.commitTransaction()) { // the rest of the list is still on its way
+                return;
+            }
+            socket->write("1");
+            socket->flush();
+            emit filesReceived(files);
+        });
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QLocalServer>
+
+// hands the files of a second start over to the editor that is already running, so only the first start pays for qt and the style
+class SingleInstance : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit SingleInstance(const QString &name, QObject *parent = nullptr);
+
+        static constexpr int timeout = 1000; // ms a running instance gets to answer before it counts as gone
+
+        bool forward(const QStringList &files);
+        bool listen();
+
+    signals:
+        void filesReceived(const QStringList &files);
+
+    private slots:
+        void newConnection();
+
+    private:
+        QString serverName;
+        QLocalServer server;
+};
+
+#endif // SINGLEINSTANCE_H
@@ -6,57 +6,193 @@
 #include <QString>
 #include <QFileDialog>
 #include <QMessageBox>
-#include <QTextStream>
 #include <QAbstractButton>
 #include <exception>
-#include <stack>
 #include <QClipboard>
+#include <QMimeData>
 #include <QKeySequence>
 #include <QStatusBar>
 #include <QStyleFactory>
 #include <QActionGroup>
+#include <QKeyEvent>
+#include <QTextCursor>
+#include <QFileInfo>
+#include <QInputDialog>
+#include <QLineEdit>
+#include <QTextBlock>
+#include <climits>
+#include <QTimer>
+#include <QScrollBar>
+#include <QCloseEvent>
+#include <QDir>
+#include "grammar.h"
+#include "lazymimedata.h"
 
-TextEditor::TextEditor(QWidget *parent): QMainWindow(parent), textEdit(new QTextEdit(this)), modified(false), charCountLabel(new QLabel(this)) { // constructor
-    setCentralWidget(textEdit);
+namespace {
+
+const TextCodec::Format spillFormat = {TextCodec::Encoding::Utf16LE, true, TextCodec::LineEnding::Lf}; // nothing to transcode, and the mark tells the loader for sure
+
+}
+
+TextEditor::TextEditor(QWidget *parent): QMainWindow(parent), centralStack(new QStackedWidget(this)), textEdit(new TextViewport(this)), mappedView(new MappedFileView(this)), scheduler(new IdleScheduler(this)), modified(false), changeTracker(new ChangeTracker(textEdit->document(), this)), undoEngine(new UndoEngine(textEdit->document(), changeTracker, this)), statistics(new DocumentStatistics(textEdit, changeTracker, scheduler, this)), highlighter(new HighlightEngine(textEdit, changeTracker, scheduler, this)), journal(new EditJournal(changeTracker, this)), charCountLabel(new QLabel(this)), positionLabel(new QLabel(this)), formatLabel(new QLabel(this)), editMenu(nullptr), fileLoader(new FileLoader(this)), loadProgress(new QProgressBar(this)), cancelLoadButton(new QToolButton(this)), fileSaver(new FileSaver(this)), follower(new FileFollower(this)), followAction(nullptr), encodingGroup(nullptr), lineEndingGroup(nullptr), reloader(new FileReloader(this)), findDialog(new FindDialog(textEdit, changeTracker, undoEngine, this)), compareDialog(nullptr), chunkedReplace(new ChunkedReplace(textEdit->document(), undoEngine, scheduler, this)), lineTransformer(new LineTransformer(this)), transformStart(0), transformLength(0), transformRevision(-1), savingRevision(-1), savingFormat(Compression::Format::None), documentGeneration(0), currentFormat(Compression::Format::None), invalidBytes(false), fileBytes(-1), followAfterLoading(false), evicted(false), evictedPosition(-1), pendingLine(-1), autoScroll(true), latencyLabel(new QLabel(this)), latencyTimer(new QTimer(this)), keyPressed(-1), painting(false), startupPending(true) { // constructor
+    centralStack->addWidget(textEdit); // the stack switches between the normal editor and the viewer for huge files
+    centralStack->addWidget(mappedView);
+    setCentralWidget(centralStack);
 
     auto *status = new QStatusBar(this); // initialization of footer, where character counter will be displayed
     setStatusBar(status);
     status->addWidget(charCountLabel);
+    status->addWidget(positionLabel); // current line and column next to the counts
+    status->addWidget(latencyLabel); // only shown while the latency is measured
+    latencyLabel->hide();
 
-    // constructor calls the following methods
-    createMenus();
+    loadProgress->setRange(0, 100); // progress and cancel button are only shown while a file is loading
+    loadProgress->setMaximumWidth(200);
+    loadProgress->hide();
+    cancelLoadButton->setText(tr("Abbrechen"));
+    cancelLoadButton->setShortcut(Qt::Key_Escape); // escape cancels loading as well
+    cancelLoadButton->hide();
+    status->addPermanentWidget(loadProgress);
+    status->addPermanentWidget(cancelLoadButton);
+    status->addPermanentWidget(formatLabel); // encoding and line ends of the file on the right
+
+    // constructor calls the following methods, menus and style follow after the first paint
     setupConnections();
     updateCharCount();
+    updatePosition();
+    updateFormat();
+    setModified(false); // sets the title
 
 
     resize(800, 600); // resizes window to 800 by 600 px
 
-    toggleDarkMode(false);
+    journal->begin(QString()); // every edit of the empty document is journaled as well
 }
 
 void TextEditor::setupConnections() {
-    connect(textEdit, &QTextEdit::textChanged, this, &TextEditor::textModified); // connects textEdit changes to textModified method
+    connect(textEdit, &QPlainTextEdit::textChanged, this, &TextEditor::textModified); // connects textEdit changes to textModified method
+    textEdit->installEventFilter(this); // lets undo/redo shortcuts through to our own undo engine
+    textEdit->viewport()->installEventFilter(this); // paints are timed while profiling
+    mappedView->viewport()->installEventFilter(this); // the first paint of either view finishes the startup
+    connect(latencyTimer, &QTimer::timeout, this, &TextEditor::updateLatency);
+    connect(statistics, &DocumentStatistics::changed, this, &TextEditor::scheduleStatusUpdate); // selection changes also update the footer
+    connect(fileLoader, &FileLoader::chunkLoaded, this, &TextEditor::appendLoadedText); // chunks of a file being loaded arrive one by one
+    connect(fileLoader, &FileLoader::progress, this, &TextEditor::showLoadProgress);
+    connect(fileLoader, &FileLoader::formatDetected, this, [this](const TextCodec::Format &format, bool invalid) {
+        if (spill) { // the spill is always utf-16, the document keeps the format it had
+            return;
+        }
+        textFormat = format; // saving writes the file back the way it was found
+        invalidBytes = invalid;
+        updateFormat();
+    });
+    connect(fileLoader, &FileLoader::finished, this, &TextEditor::finishLoading);
+    connect(fileLoader, &FileLoader::failed, this, &TextEditor::abortLoading);
+    connect(fileLoader, &FileLoader::canceled, this, [this]() {
+        abortLoading(QString()); // canceling is no error, so no message box
+    });
+    connect(cancelLoadButton, &QToolButton::clicked, fileLoader, &FileLoader::cancel);
+    connect(textEdit, &QPlainTextEdit::cursorPositionChanged, this, &TextEditor::scheduleStatusUpdate); // line and column follow the cursor
+    connect(mappedView, &MappedFileView::positionChanged, this, &TextEditor::updatePosition);
+    connect(mappedView, &MappedFileView::lineIndexReady, this, &TextEditor::updateCharCount); // the line count shows up once the viewer has counted
+    connect(fileSaver, &FileSaver::progress, this, [this](qint64 done, qint64 total) {
+        statusBar()->showMessage(tr("Speichern... %1%").arg(total > 0 ? done * 100 / total : 100));
+    });
+    connect(fileSaver, &FileSaver::finished, this, &TextEditor::saveFinished);
+    connect(fileSaver, &FileSaver::failed, this, &TextEditor::saveFailed);
+    connect(follower, &FileFollower::appended, this, &TextEditor::appendFollowedText);
+    connect(follower, &FileFollower::restarted, this, [this]() { // the log was rotated or truncated, the document starts over with the new file
+        textEdit->clear();
+        updateCharCount();
+        statusBar()->showMessage(tr("Datei wurde ersetzt, sie wird von vorne gelesen"), 3000);
+    });
+    connect(follower, &FileFollower::failed, this, [this](const QString &error) {
+        setFollowing(false);
+        QMessageBox::warning(this, tr("Fehler"), error);
+    });
+    connect(reloader, &FileReloader::changedOnDisk, this, &TextEditor::reloadFromDisk);
+    connect(reloader, &FileReloader::reloaded, this, &TextEditor::applyReload);
+    connect(reloader, &FileReloader::removedFromDisk, this, [this]() { // the document is the only copy now
+        fileBytes = -1;
+        setModified(true);
+        statusBar()->showMessage(tr("Die Datei wurde gelöscht oder umbenannt"), 5000);
+    });
+    connect(reloader, &FileReloader::failed, this, [this](const QString &error) {
+        statusBar()->clearMessage();
+        QMessageBox::warning(this, tr("Fehler"), error);
+    });
+    connect(chunkedReplace, &ChunkedReplace::progress, this, [this](qint64 done, qint64 total) {
+        statusBar()->showMessage(tr("Einfügen... %1%").arg(total > 0 ? done * 100 / total : 100));
+    });
+    connect(chunkedReplace, &ChunkedReplace::finished, this, &TextEditor::finishReplacing);
+    connect(lineTransformer, &LineTransformer::finished, this, &TextEditor::finishTransform);
+    connect(lineTransformer, &LineTransformer::failed, this, [this](const QString &error) {
+        stopReplacing(); // only gives the document back, nothing was replaced
+        statusBar()->clearMessage();
+        QMessageBox::warning(this, tr("Fehler"), error);
+    });
+    connect(journal, &EditJournal::failed, this, [this](const QString &error) {
+        statusBar()->showMessage(error, 5000); // editing goes on, only the crash recovery is missing
+    });
 }
 
 void TextEditor::textModified() { // method is called when text in the file is changed
-    undoStack.push(textEdit->toPlainText()); // the latest update is pushed to the undoStack
+    ScopedTimer timer("textModified");
+    if (fileLoader->isRunning() || follower->isActive()) { // chunks of a loading or followed file are no modification
+        return;
+    }
+    fileBytes = -1; // the document doesn't match the file anymore
     setModified(true); // set modified to true when text is modified
-    updateCharCount(); // char count at the footer / statusbar is updated on text change
+    scheduleStatusUpdate(); // char count at the footer / statusbar is updated on text change
 }
 
 void TextEditor::setModified(bool value) { // method that accepts boolean value and sets modified variable to just that
     modified = value;
+    setWindowTitle(displayName() + QLatin1String("[*]")); // the window or the tab shows the mark in place of [*]
+    setWindowModified(value);
+}
+
+QString TextEditor::displayName() const {
+    return currentFile.isEmpty() ? tr("Unbenannt") : QFileInfo(currentFile).fileName();
 }
 
 void TextEditor::updateCharCount() {
-    int count = textEdit->toPlainText().length(); // count variable holds current character count
-    charCountLabel->setText(tr("Zeichen: %1").arg(count)); // sets the label displayed in the footer to the character count
+    ScopedTimer timer("updateCharCount");
+    if (viewerMode()) { // the mapped file is never counted character by character, only its size and lines are shown
+        QString lines = mappedView->lineCount() < 0 ? tr("werden gezählt") : QString::number(mappedView->lineCount());
+        charCountLabel->setText(tr("Nur lesen: %1 MB  Zeilen: %2").arg(mappedView->fileSize() / (1024 * 1024)).arg(lines));
+        return;
+    }
+    QString words = statistics->wordsPending() ? tr("…") : QString::number(statistics->words()); // big edits are counted in idle time
+    QString text = tr("Zeichen: %1  Wörter: %2  Zeilen: %3").arg(statistics->characters()).arg(words).arg(statistics->lines()); // counts are kept up to date by the statistics, no need to read the text
+    if (statistics->selectedCharacters() > 0) { // selection counts are only shown while something is selected
+        text += tr("  Auswahl: %1 Zeichen, %2 Zeilen").arg(statistics->selectedCharacters()).arg(statistics->selectedLines());
+    }
+    charCountLabel->setText(text); // sets the label displayed in the footer to the counts
+}
+
+void TextEditor::scheduleStatusUpdate() { // a paste or a loaded chunk changes the counts many times in one turn of the event loop, the labels are set once
+    scheduler->schedule(QStringLiteral("statusBar"), IdleScheduler::Urgent, [this](const IdleScheduler::Budget &) {
+        updateCharCount();
+        updatePosition();
+        return true;
+    });
+}
+
+void TextEditor::updatePosition() { // shows the line and column of the cursor, or the top line in the viewer
+    if (viewerMode()) {
+        qint64 line = mappedView->currentLine();
+        positionLabel->setText(line < 0 ? QString() : tr("Zeile %1").arg(line));
+        return;
+    }
+    QTextCursor cursor = textEdit->textCursor();
+    positionLabel->setText(tr("Zeile %1, Spalte %2").arg(cursor.blockNumber() + 1).arg(cursor.positionInBlock() + 1)); // blocks are the lines of the plain text
 }
 
 void TextEditor::createMenus() { // method that handles the creation of the navbar
     QMenuBar *bar = menuBar(); // creates the general navbar
     QMenu *fileMenu = bar->addMenu(tr("&Datei")); // adds a "datei" option to the nav
-    QMenu *editMenu = bar->addMenu(tr("&Bearbeiten")); // adds "bearbeiten" option to the nav
+    editMenu = bar->addMenu(tr("&Bearbeiten")); // adds "bearbeiten" option to the nav, kept to disable it in viewer mode
     QMenu *viewMenu = bar->addMenu(tr("&Ansicht")); // adds "ansicht" option to the nav
 
     QAction *newAction = new QAction(tr("Neues Fenster"), this); // Dropdown option to create a new text file
@@ -64,17 +200,65 @@ void TextEditor::createMenus() { // method that handles the creation of the navb
     fileMenu->addAction(newAction); // appends the action to the fileMenu
 
     QAction *openAction = new QAction(tr("Öffnen"), this); // Dropdown option to open a text file
-    connect(openAction, &QAction::triggered, this, &TextEditor::openFile); // connects the event action to the openFile method
+    connect(openAction, &QAction::triggered, this, qOverload<>(&TextEditor::openFile)); // connects the event action to the openFile method
     fileMenu->addAction(openAction); // appends the action to the fileMenu
 
+    QAction *findInFolderAction = new QAction(tr("In Ordner suchen..."), this); // searches all files below a folder, a hit is opened in its tab
+    findInFolderAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    connect(findInFolderAction, &QAction::triggered, this, &TextEditor::findInFolder);
+    fileMenu->addAction(findInFolderAction);
+
+    QAction *compareAction = new QAction(tr("Mit Datei vergleichen..."), this); // lists the lines in which the document and a file differ
+    connect(compareAction, &QAction::triggered, this, &TextEditor::compareWithFile);
+    fileMenu->addAction(compareAction);
+
     QAction *saveAction = new QAction(tr("Speichern"), this); // Dropdown option to exit the text editor
     connect(saveAction, &QAction::triggered, this, &TextEditor::saveFile); // connects the event action to the beenden function
     fileMenu->addAction(saveAction); // appends the action to the fileMenu
 
     QAction *saveAsAction = new QAction(tr("Speichern unter"), this); // Dropdown option to save a text file
-    connect(saveAsAction, &QAction::triggered, this, &TextEditor::saveAsFile); // connects the event action to the saveFile method
+    connect(saveAsAction, &QAction::triggered, this, qOverload<>(&TextEditor::saveAsFile)); // connects the event action to the saveFile method
     fileMenu->addAction(saveAsAction); // appends the action to the fileMenu
 
+    fileMenu->addSeparator();
+    QMenu *encodingMenu = fileMenu->addMenu(tr("Kodierung")); // how the file is written by the next save
+    encodingGroup = new QActionGroup(this);
+    auto addEncoding = [this, encodingMenu](const QString &label, TextCodec::Encoding encoding, bool bom) {
+        QAction *action = encodingMenu->addAction(label);
+        action->setCheckable(true);
+        action->setData(int(encoding) * 2 + int(bom)); // updateFormat finds the action again by it
+        encodingGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, encoding, bom]() {
+            TextCodec::Format format = textFormat;
+            format.encoding = encoding;
+            format.bom = bom;
+            setTextFormat(format);
+        });
+    };
+    addEncoding(tr("UTF-8"), TextCodec::Encoding::Utf8, false);
+    addEncoding(tr("UTF-8 mit BOM"), TextCodec::Encoding::Utf8, true);
+    addEncoding(tr("UTF-16 LE"), TextCodec::Encoding::Utf16LE, true);
+    addEncoding(tr("UTF-16 BE"), TextCodec::Encoding::Utf16BE, true);
+    addEncoding(tr("Latin-1"), TextCodec::Encoding::Latin1, false);
+
+    QMenu *lineEndingMenu = fileMenu->addMenu(tr("Zeilenende"));
+    lineEndingGroup = new QActionGroup(this);
+    auto addLineEnding = [this, lineEndingMenu](const QString &label, TextCodec::LineEnding lineEnding) {
+        QAction *action = lineEndingMenu->addAction(label);
+        action->setCheckable(true);
+        action->setData(int(lineEnding));
+        lineEndingGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, lineEnding]() {
+            TextCodec::Format format = textFormat;
+            format.lineEnding = lineEnding;
+            setTextFormat(format);
+        });
+    };
+    addLineEnding(tr("LF (Linux, macOS)"), TextCodec::LineEnding::Lf);
+    addLineEnding(tr("CRLF (Windows)"), TextCodec::LineEnding::CrLf);
+    updateFormat(); // checks the format of a file that was opened before the menus were there
+    fileMenu->addSeparator();
+
     QAction *exitAction = new QAction(tr("Beenden"), this); // Dropdown Option to exit File
     connect(exitAction, &QAction::triggered, this, &TextEditor::exitFile); // connects the event action to the saveFile method
     fileMenu->addAction(exitAction); // appends the action to the fileMenu
@@ -84,6 +268,16 @@ void TextEditor::createMenus() { // method that handles the creation of the navb
     connect(undoAction, &QAction::triggered, this, &TextEditor::undo); // connects the event action to the undo method
     editMenu->addAction(undoAction); // appends the action to the editMenu
 
+    QAction *redoAction = new QAction(tr("Wiederherstellen"), this); // redo option to apply the latest undone change again
+    redoAction->setShortcut(QKeySequence::Redo); // sets shortcut for redo to basic qt redo shortcut, also displays label on the button
+    connect(redoAction, &QAction::triggered, this, &TextEditor::redo); // connects the event action to the redo method
+    editMenu->addAction(redoAction); // appends the action to the editMenu
+
+    undoAction->setEnabled(undoEngine->canUndo()); // undo and redo are only clickable when there is something to undo or redo
+    redoAction->setEnabled(undoEngine->canRedo());
+    connect(undoEngine, &UndoEngine::canUndoChanged, undoAction, &QAction::setEnabled);
+    connect(undoEngine, &UndoEngine::canRedoChanged, redoAction, &QAction::setEnabled);
+
     QAction *cutAction = new QAction(tr("Ausschneiden"), this); // cut option to cut the selected text
     cutAction->setShortcut(QKeySequence::Cut); // sets shortcut for cut to basic qt cut shortcut, also displays label on the button
     connect(cutAction, &QAction::triggered, this, &TextEditor::cut); // connects the event action to the cut method
@@ -104,6 +298,59 @@ void TextEditor::createMenus() { // method that handles the creation of the navb
     connect(deleteAction, &QAction::triggered, this, &TextEditor::deleteText); // connects the event action to the delete method
     editMenu->addAction(deleteAction); // appends the action to the editMenu
 
+    editMenu->addSeparator();
+    QAction *findAction = new QAction(tr("Suchen/Ersetzen..."), this); // opens the find/replace dialog
+    findAction->setShortcuts({QKeySequence::Find, QKeySequence::Replace});
+    connect(findAction, &QAction::triggered, this, &TextEditor::find); // connects the event action to the find method
+    editMenu->addAction(findAction); // appends the action to the editMenu
+
+    QAction *findNextAction = new QAction(tr("Weitersuchen"), this); // searches the last term again without the dialog
+    findNextAction->setShortcut(QKeySequence::FindNext);
+    connect(findNextAction, &QAction::triggered, findDialog, &FindDialog::findNext);
+    editMenu->addAction(findNextAction);
+
+    QAction *findPreviousAction = new QAction(tr("Rückwärts suchen"), this);
+    findPreviousAction->setShortcut(QKeySequence::FindPrevious);
+    connect(findPreviousAction, &QAction::triggered, findDialog, &FindDialog::findPrevious);
+    editMenu->addAction(findPreviousAction);
+
+    editMenu->addSeparator();
+    QMenu *linesMenu = editMenu->addMenu(tr("Zeilen")); // works on the selected lines, or on all of them without a selection
+    linesMenu->addAction(tr("Sortieren (A-Z)"), this, [this]() {
+        transformLines(LineOperation());
+    });
+    linesMenu->addAction(tr("Sortieren (Z-A)"), this, [this]() {
+        LineOperation operation;
+        operation.descending = true;
+        transformLines(operation);
+    });
+    linesMenu->addAction(tr("Numerisch sortieren"), this, [this]() {
+        LineOperation operation;
+        operation.kind = LineOperation::SortNumeric;
+        transformLines(operation);
+    });
+    linesMenu->addAction(tr("Doppelte entfernen"), this, [this]() {
+        LineOperation operation;
+        operation.kind = LineOperation::Unique;
+        transformLines(operation);
+    });
+    linesMenu->addAction(tr("Zeilen behalten..."), this, [this]() {
+        filterLines(true);
+    });
+    linesMenu->addAction(tr("Zeilen entfernen..."), this, [this]() {
+        filterLines(false);
+    });
+    linesMenu->addAction(tr("Umkehren"), this, [this]() {
+        LineOperation operation;
+        operation.kind = LineOperation::Reverse;
+        transformLines(operation);
+    });
+    linesMenu->addAction(tr("Leerzeichen am Zeilenende entfernen"), this, [this]() {
+        LineOperation operation;
+        operation.kind = LineOperation::Trim;
+        transformLines(operation);
+    });
+
     QActionGroup *backgroundGroup = new QActionGroup(this); // groups qactions so only one can be active at a time
 
     QAction *lightAction = new QAction(tr("Hell"), this); // lightMode option
@@ -126,20 +373,98 @@ void TextEditor::createMenus() { // method that handles the creation of the navb
     QMenu *backgroundMenu = viewMenu->addMenu(tr("Hintergrund")); // adds the background option to viewmenu navbar option
     backgroundMenu->addAction(lightAction);
     backgroundMenu->addAction(darkAction);
+
+    QAction *goToLineAction = new QAction(tr("Gehe zu Zeile..."), this); // jumps to a line number, also works in the viewer for huge files
+    goToLineAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_G));
+    connect(goToLineAction, &QAction::triggered, this, &TextEditor::goToLine); // connects the event action to the goToLine method
+    viewMenu->addAction(goToLineAction); // appends the action to the viewMenu
+
+    viewMenu->addSeparator();
+    QAction *profilingAction = new QAction(tr("Latenz messen"), this); // shows the rolling latencies in the status bar
+    profilingAction->setCheckable(true);
+    connect(profilingAction, &QAction::toggled, this, &TextEditor::setProfiling);
+    viewMenu->addAction(profilingAction);
+
+    QAction *exportTraceAction = new QAction(tr("Trace exportieren..."), this); // the measured session as chrome trace
+    connect(exportTraceAction, &QAction::triggered, this, &TextEditor::exportTrace);
+    viewMenu->addAction(exportTraceAction);
+
+    viewMenu->addSeparator();
+    followAction = new QAction(tr("Datei verfolgen"), this); // appends whatever other programs write to the file, like tail -f
+    followAction->setCheckable(true);
+    followAction->setChecked(follower->isActive() || followAfterLoading);
+    connect(followAction, &QAction::triggered, this, &TextEditor::setFollowing); // triggered, not toggled, the check mark is also set from code
+    viewMenu->addAction(followAction);
+
+    QAction *autoScrollAction = new QAction(tr("Automatisch scrollen"), this); // keeps the end of a followed file in view
+    autoScrollAction->setCheckable(true);
+    autoScrollAction->setChecked(autoScroll);
+    connect(autoScrollAction, &QAction::toggled, this, [this](bool checked) {
+        autoScroll = checked;
+    });
+    viewMenu->addAction(autoScrollAction);
+
+    editMenu->setEnabled(!viewerMode()); // a huge file may have been opened before the menus were there
+    encodingGroup->setEnabled(!viewerMode());
+    lineEndingGroup->setEnabled(!viewerMode());
+    emit menusCreated();
+}
+
+void TextEditor::finishStartup() { // the window is painted first, menus and the style come right after
+    const qint64 painted = Profiler::now(); // the clock started at the top of main
+    createMenus();
+    static bool styled = false; // the style belongs to the whole application, later windows keep what was picked
+    if (!styled) {
+        styled = true;
+        toggleDarkMode(false);
+        qInfo("startup: first paint after %.1f ms, menus and style took %.1f ms", painted / 1e6, (Profiler::now() - painted) / 1e6);
+    }
+}
+
+bool TextEditor::isUntouched() const { // an empty unnamed document, files from another start can be opened in it
+    return !modified && currentFile.isEmpty() && statistics->characters() == 0 && !fileLoader->isRunning() && !viewerMode() && !evicted;
+}
+
+QString TextEditor::fileName() const {
+    return currentFile;
 }
 
 void TextEditor::newFile() {
     if (askForSave()) { // calls askForSave method which returns true only when no changes were made, or previous has been saved
+        setViewerMode(false); // a new file is always edited in the normal editor
+        stopFollowing();
+        stopReplacing();
+        spill.reset();
+        evicted = false;
+        reloader->stop();
+        reloader->unwatch();
+        if (fileLoader->isRunning()) { // a file that is still loading is dropped
+            fileLoader->stop();
+            endLoading();
+        }
+        ++documentGeneration;
+        journal->discard(); // the changes were saved or dropped on purpose
+        undoEngine->setRecording(false); // clearing the file is not an undoable step
         textEdit->clear(); // clears current file, acts as new file
-        modified = false;
+        highlighter->setGrammar(nullptr); // an unnamed file has no language
+        journal->begin(QString());
+        undoEngine->setRecording(true);
+        undoEngine->clear(); // the history of the previous file is not needed anymore
+        currentFile.clear(); // a new file has no name until it is saved
+        currentFormat = Compression::Format::None;
+        textFormat = TextCodec::Format();
+        invalidBytes = false;
+        updateFormat();
+        fileBytes = -1;
+        setModified(false);
     }
 }
 
 bool TextEditor::askForSave() {
-    if (modified && !textEdit->toPlainText().isEmpty()) { // asks for modified value and for the file to have at least some characters
+    if (modified && (evicted || statistics->characters() > 0)) { // asks for modified value and for the file to have at least some characters, an evicted one has them in its spill
         QMessageBox msgBox(this); // message box is created that acts as a dialog
         msgBox.setWindowTitle(tr("Editor")); // title of messagebox is editor
-        msgBox.setText(tr("Möchten Sie die Änderungen speichern?")); // label of the messagebox
+        msgBox.setText(tr("Möchten Sie die Änderungen an \"%1\" speichern?").arg(displayName())); // label of the messagebox, with several tabs it has to say which document
         msgBox.setStandardButtons(QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel); // default messagebox values
 
         QAbstractButton *saveButton = msgBox.button(QMessageBox::Save);
@@ -158,8 +483,10 @@ bool TextEditor::askForSave() {
         int ans = msgBox.exec(); // blocks the event loop until option is chosen and put into the variable
 
         if (ans == QMessageBox::Save) {
-            saveAsFile(); // calls saveAs method
-            modified = false; // sets modified to false again
+            if (!saveDocument() || !fileSaver->waitForFinished()) { // the document is only replaced once it is safely on disk
+                return false;
+            }
+            setModified(false); // sets modified to false again
         } else if (ans == QMessageBox::Cancel) {
             return false; // returns false
         }
@@ -175,19 +502,48 @@ void TextEditor::openFile() {
         if (fileName.isEmpty()) { // the method is returned from when filename is empty
             return;
         }
-        QFile file(fileName); // new qfile object with the filename is created
-        try {
-            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) { // tries to open the file in read mode; provides functions to read from and write to the device
-                throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+        openFile(fileName);
+    }
+}
+
+void TextEditor::openFile(const QString &fileName) { // opens without asking, the current document is dropped
+    QFile file(fileName); // new qfile object with the filename is created
+    spill.reset(); // an evicted text is dropped along with the document
+    evicted = false;
+    try {
+        if (QFileInfo(fileName).size() >= MappedFileView::threshold && Compression::detect(fileName) == Compression::Format::None && MappedFileView::canShow(fileName)) { // huge files are mapped and only shown read-only instead of being read completely, compressed and utf-16 ones are always streamed
+            mappedView->open(fileName);
+            stopFollowing();
+            stopReplacing();
+            reloader->stop();
+            reloader->unwatch(); // the viewer maps the file, changes on disk aren't followed there
+            if (fileLoader->isRunning()) { // a file that is still loading is dropped
+                fileLoader->stop();
+                endLoading();
             }
-            QTextStream in(&file); // creation of a qtextstream object that points to the file
-            textEdit->setPlainText(in.readAll()); // text stream reads the entire content
-            file.close(); // closes the file
-            modified = false;
+            ++documentGeneration;
+            journal->discard(); // nothing is edited in the viewer
+            undoEngine->setRecording(false);
+            textEdit->clear(); // frees the memory of the previous document
+            highlighter->setGrammar(nullptr);
+            undoEngine->setRecording(true);
+            undoEngine->clear();
+            setViewerMode(true);
+            currentFile = fileName;
+            currentFormat = Compression::Format::None;
+            invalidBytes = false; // saving copies the mapped bytes as they are
+            setModified(false);
             updateCharCount();
-        } catch (const std::exception& e) {
-            QMessageBox::warning(this, tr("Fehler"), tr(e.what())); // handles the exception
+            return;
+        }
+        setViewerMode(false); // smaller files are edited as usual
+        if (!file.open(QIODevice::ReadOnly)) { // tries to open the file in read mode, so errors show up before loading starts
+            throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
         }
+        file.close(); // closes the file, the loader opens it again on its own thread
+        startLoading(fileName);
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, tr("Fehler"), tr(e.what())); // handles the exception
     }
 }
 
@@ -196,70 +552,828 @@ void TextEditor::saveAsFile() {
     if (fileName.isEmpty()) { // the method is returned from when no filename is selected
         return;
     }
-    QFile file(fileName); // creates a qfile object with the filename
-    try {
-        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) { // tries to open the file in write mode
-            throw std::runtime_error("Kann nicht speichern: " + file.errorString().toStdString());
+    saveAsFile(fileName);
+}
+
+void TextEditor::saveAsFile(const QString &fileName) { // saves without a dialog, the file becomes the current one once it is written
+    saveTo(fileName);
+}
+
+bool TextEditor::isBusy() const { // true while a file is loaded, saved, reloaded or still counted by the viewer
+    return fileLoader->isRunning() || fileSaver->isRunning() || reloader->isRunning() || chunkedReplace->isRunning() || lineTransformer->isRunning() || (viewerMode() && mappedView->lineCount() < 0);
+}
+
+void TextEditor::saveFile() { // saves into the current file directly, asks for a name only if there is none yet
+    if (currentFile.isEmpty() || viewerMode()) {
+        saveAsFile();
+        return;
+    }
+    saveTo(currentFile);
+}
+
+bool TextEditor::saveDocument() { // used before the document is replaced, returns false if no file was chosen
+    QString fileName = viewerMode() ? QString() : currentFile;
+    if (fileName.isEmpty()) {
+        fileName = QFileDialog::getSaveFileName(this, tr("Speichern"), "", tr("Text Files (*.txt);;All Files (*)"));
+        if (fileName.isEmpty()) {
+            return false;
         }
-        QTextStream out(&file); // creates a textstream to write into the file
-        out << textEdit->toPlainText(); // writes the text of the textedit into the file
-        file.close(); // closes the file
-        modified = false;
-    } catch (const std::exception& e) {
-        QMessageBox::warning(this, tr("Fehler"), tr(e.what()));
     }
+    return saveTo(fileName);
 }
 
-void TextEditor::saveFile() { // saves the file instantly if nothing was changed, else calls askforsave
-    if (askForSave()) {
+bool TextEditor::saveTo(const QString &fileName) { // the actual writing happens on the saver thread, typing goes on meanwhile
+    if (fileLoader->isRunning()) { // half a document would overwrite the whole file
+        statusBar()->showMessage(tr("Die Datei wird noch geladen"), 3000);
+        return false;
+    }
+    if (chunkedReplace->isRunning()) { // a paste that is only partly applied would be written as it is
+        statusBar()->showMessage(tr("Es wird noch eingefügt"), 3000);
+        return false;
+    }
+    if (invalidBytes && !viewerMode() && QFileInfo(fileName) == QFileInfo(currentFile)) { // another file loses nothing, the original stays as it is
+        QMessageBox::StandardButton answer = QMessageBox::warning(this, tr("Ungültige Bytes"), tr("\"%1\" enthält Bytes, die in ihrer Kodierung ungültig sind. Sie wurden als U+FFFD geladen und gehen beim Speichern verloren. Trotzdem speichern?").arg(QFileInfo(fileName).fileName()), QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+        if (answer != QMessageBox::Yes) {
+            return false;
+        }
+    }
+    // the open file keeps its compression even without the extension, a new name picks it by the extension
+    Compression::Format format = !viewerMode() && QFileInfo(fileName) == QFileInfo(currentFile) ? currentFormat : Compression::fromFileName(fileName);
+    if (!Compression::isAvailable(format)) {
+        QMessageBox::warning(this, tr("Fehler"), tr("%1 wird nicht unterstützt").arg(Compression::name(format)));
+        return false;
+    }
+    if (viewerMode()) { // the viewer never changes the mapped file, so saving it means copying it
+        if (QFileInfo(fileName) == QFileInfo(mappedView->fileName())) {
+            return true;
+        }
+        fileSaver->copy(mappedView->fileName(), fileName, format);
+    } else {
+        PieceTable text;
+        try {
+            text = documentText();
+        } catch (const std::exception& e) {
+            QMessageBox::warning(this, tr("Fehler"), tr(e.what())); // handles the exception
+            return false;
+        }
+        savingRevision = changeTracker->revision(); // edits after this point keep the document modified
+        savingFormat = format;
+        fileSaver->save(fileName, text, textFormat, format); // the saver gets an o(1) snapshot, typing goes on in the original
+    }
+    savingGenerations.append(documentGeneration); // askForSave waits for the saver, but its signal still comes later, maybe after the document was replaced
+    statusBar()->showMessage(tr("Speichern..."));
+    return true;
+}
+
+PieceTable TextEditor::documentText() const { // the text of an evicted document is read back from its spill, the document itself stays empty
+    if (!evicted || !spill) {
+        return changeTracker->table();
+    }
+    QFile file(spill->fileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    TextDecoder decoder(spillFormat);
+    QString text = decoder.decode(file.readAll());
+    text += decoder.finish();
+    return PieceTable(text);
+}
+
+void TextEditor::saveFinished(const QString &fileName) {
+    const bool sameDocument = !savingGenerations.isEmpty() && savingGenerations.takeFirst() == documentGeneration;
+    statusBar()->showMessage(tr("Gespeichert"), 2000);
+    if (!sameDocument) { // another file was opened meanwhile, it is neither renamed nor journaled
         return;
     }
-    saveAsFile();
+    if (follower->isActive()) { // a copy of the followed file, the document keeps following and is neither renamed nor journaled
+        return;
+    }
+    if (!viewerMode() && changeTracker->revision() == savingRevision) { // only unchanged documents count as saved
+        currentFile = fileName;
+        currentFormat = savingFormat;
+        invalidBytes = false; // the file holds the U+FFFD now, nothing more can be lost
+        fileBytes = QFileInfo(fileName).size(); // the file holds exactly the document now
+        setModified(false);
+        spill.reset(); // an evicted document is loaded from the file from now on
+        highlighter->setGrammar(Grammar::forFile(fileName)); // saving under a new name may change the language
+        journal->begin(fileName, currentFormat, textFormat); // the saved file is the new base, the older edits are not needed anymore
+    } else if (!viewerMode()) {
+        journal->begin(currentFile, currentFormat, textFormat); // the file on disk changed, so the journal can't build on the old one anymore
+        journal->snapshot(); // edits made while saving are kept as a snapshot
+    }
+    if (!viewerMode() && !evicted && QFileInfo(fileName) == QFileInfo(currentFile)) {
+        reloader->watch(currentFile); // the file as we wrote it is the known state, our own save is no change from outside
+    }
 }
 
-void TextEditor::exitFile() {    // quits the application without saving
-    if (askForSave())
-    {
-        QApplication::quit(); // quits the application
+void TextEditor::saveFailed(const QString &error) { // the target file is untouched, the document stays modified
+    if (!savingGenerations.isEmpty()) {
+        savingGenerations.removeFirst(); // nothing of the document is touched here, so even an older one is still reported
     }
+    statusBar()->clearMessage();
+    QMessageBox::warning(this, tr("Fehler"), error);
 }
 
-void TextEditor::undo() {
-    if (!undoStack.empty()) {
-        undoStack.pop(); // Remove current state as we are reverting to the previous
-        if (!undoStack.empty()) { // this double check is for the case where there is only 1 character left, otherwise resulting in termination as more is undone than done
-            QString lastText = undoStack.top(); // get the previous state of the text content
-            textEdit->blockSignals(true); // block signals to avoid unintended infinite loops
-            textEdit->setPlainText(lastText); // set the text content to the previous state
-            textEdit->blockSignals(false); // release signal blocking
-            setModified(true); // mark as modified
-        } else {
-            textEdit->clear(); // clear the text if there's only one character left (undo to an empty state)
-            setModified(false); // no longer modified if content is cleared
+void TextEditor::recoverSession() { // offers the unsaved work of editors that crashed or were closed without saving
+    const QStringList journals = EditJournal::recoverable();
+    for (const QString &journalFile : journals) {
+        try {
+            JournalRecovery recovery = EditJournal::recover(journalFile); // replays into a gap buffer, fast even for long sessions
+            if (recovery.edits == 0) { // nothing was changed in that session
+                EditJournal::remove(journalFile);
+                continue;
+            }
+            QString name = recovery.fileName.isEmpty() ? tr("Unbenannt") : QFileInfo(recovery.fileName).fileName();
+            QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Wiederherstellen"), tr("Es gibt nicht gespeicherte Änderungen an \"%1\" aus einer früheren Sitzung. Wiederherstellen?").arg(name), QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+            if (answer == QMessageBox::Cancel) { // asked again at the next start
+                return;
+            }
+            EditJournal::remove(journalFile);
+            if (answer == QMessageBox::Yes) {
+                restore(recovery);
+                return; // one document per window, further journals are offered at the next start
+            }
+        } catch (const std::exception& e) {
+            QMessageBox::warning(this, tr("Fehler"), tr(e.what())); // handles the exception
+            EditJournal::remove(journalFile); // a journal that can't be replayed is of no use
+        }
+    }
+}
+
+void TextEditor::restore(const JournalRecovery &recovery) { // the recovered text replaces the empty document and stays modified
+    stopFollowing();
+    stopReplacing();
+    spill.reset();
+    evicted = false;
+    ++documentGeneration;
+    journal->discard();
+    undoEngine->setRecording(false); // the recovered text is the start of the history
+    textEdit->setPlainText(recovery.text);
+    undoEngine->setRecording(true);
+    undoEngine->clear();
+    currentFile = recovery.fileName;
+    currentFormat = recovery.compression; // the journal knows how the file was stored
+    textFormat = recovery.format; // saved the way the file was found, not as utf-8
+    invalidBytes = recovery.invalidBytes;
+    updateFormat();
+    fileBytes = -1;
+    highlighter->setGrammar(Grammar::forFile(currentFile));
+    journal->begin(currentFile, currentFormat, textFormat);
+    journal->snapshot(); // the recovered text differs from the file, so it is the base of the new journal
+    if (!currentFile.isEmpty()) {
+        reloader->watch(currentFile);
+    }
+    setModified(true);
+    updateCharCount();
+    statusBar()->showMessage(tr("%1 Änderungen wiederhergestellt").arg(recovery.edits), 3000);
+}
+
+void TextEditor::startLoading(const QString &fileName) { // the file is read on a worker thread and appended chunk by chunk
+    ++documentGeneration; // a save of the previous document that reports back later leaves this one alone
+    stopFollowing();
+    stopReplacing();
+    reloader->stop(); // a reload of the previous file would apply its edits to the new one
+    reloader->unwatch();
+    if (!spill) { // an evicted document keeps its journal until the spilled text is back
+        journal->discard(); // loading is no edit, the journal starts once the file is complete
+    }
+    undoEngine->setRecording(false); // loading the file is not an undoable step
+    textEdit->clear();
+    highlighter->setGrammar(nullptr); // the chunks are not highlighted one by one, the whole file is lexed once it is loaded
+    textEdit->setReadOnly(true); // no typing into a half loaded file
+    loadProgress->setValue(0);
+    loadProgress->show();
+    cancelLoadButton->show();
+    currentFile = fileName; // save writes back into the opened file
+    setModified(false);
+    currentFormat = Compression::detect(fileName); // the loader finds the same on its own
+    textFormat = TextCodec::Format(); // until the loader reports what it found
+    invalidBytes = false;
+    updateFormat();
+    fileBytes = 0; // counted up by the progress of the loader
+    fileLoader->start(fileName);
+}
+
+void TextEditor::appendLoadedText(const QString &text) { // appends one chunk at the end without moving the visible cursor
+    QTextCursor cursor(textEdit->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+}
+
+void TextEditor::showLoadProgress(qint64 bytesRead, qint64 bytesTotal) {
+    fileBytes = bytesRead; // following goes on from the last byte the loader read, even if the file grew meanwhile
+    loadProgress->setValue(bytesTotal > 0 ? int(bytesRead * 100 / bytesTotal) : 0);
+}
+
+void TextEditor::finishLoading() {
+    endLoading();
+    highlighter->setGrammar(Grammar::forFile(currentFile)); // the grammar is picked by the file name
+    journal->begin(currentFile, currentFormat, textFormat); // later edits are journaled on top of the file as it is on disk, this also drops the journal kept while evicted
+    if (spill) { // the text came back from the spill, it still differs from the file
+        spill.reset();
+        journal->snapshot();
+        fileBytes = -1;
+        setModified(true);
+    } else {
+        setModified(false); // the loaded file is unchanged
+    }
+    if (!currentFile.isEmpty()) {
+        reloader->watch(currentFile);
+    }
+    if (evictedPosition >= 0) { // where the cursor was before the document was evicted
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(int(qMin<qsizetype>(evictedPosition, changeTracker->size())));
+        textEdit->setTextCursor(cursor);
+        textEdit->ensureCursorVisible();
+        evictedPosition = -1;
+    }
+    if (pendingLine > 0) { // the file was opened from a folder search hit
+        showLine(pendingLine);
+        pendingLine = -1;
+    }
+    updateCharCount();
+    if (followAfterLoading) {
+        followAfterLoading = false;
+        setFollowing(true);
+    }
+    emit documentLoaded();
+}
+
+void TextEditor::abortLoading(const QString &message) { // a failed or canceled load leaves an empty document
+    QString error = message;
+    if (spill) { // the spill is the only copy of the text now, so it stays on disk
+        spill->setAutoRemove(false);
+        error = tr("Der ausgelagerte Text liegt noch in %1\n%2").arg(QDir::toNativeSeparators(spill->fileName()), message);
+        spill.reset();
+    }
+    evictedPosition = -1;
+    pendingLine = -1;
+    stopFollowing(); // a load for following that didn't finish has nothing to follow
+    reloader->unwatch();
+    textEdit->clear();
+    currentFile.clear();
+    currentFormat = Compression::Format::None;
+    textFormat = TextCodec::Format();
+    invalidBytes = false;
+    updateFormat();
+    fileBytes = -1;
+    endLoading();
+    journal->begin(QString());
+    setModified(false);
+    updateCharCount();
+    if (error.isEmpty()) {
+        statusBar()->showMessage(tr("Laden abgebrochen"), 3000);
+    } else {
+        QMessageBox::warning(this, tr("Fehler"), error);
+    }
+}
+
+void TextEditor::endLoading() {
+    loadProgress->hide();
+    cancelLoadButton->hide();
+    textEdit->setReadOnly(false);
+    undoEngine->setRecording(true);
+    undoEngine->clear(); // the history of the previous file is not needed anymore
+}
+
+void TextEditor::goToLine() {
+    qint64 lines = viewerMode() ? mappedView->lineCount() : statistics->lines(); // both counts are kept up to date, nothing is scanned here
+    if (lines < 0) {
+        statusBar()->showMessage(tr("Zeilen werden noch gezählt"), 2000);
+        return;
+    }
+    int current = int(qMax<qint64>(1, viewerMode() ? mappedView->currentLine() : textEdit->textCursor().blockNumber() + 1));
+    bool ok = false;
+    int line = QInputDialog::getInt(this, tr("Gehe zu Zeile"), tr("Zeile (1 - %1):").arg(lines), current, 1, int(qMin<qint64>(lines, INT_MAX)), 1, &ok);
+    if (!ok) { // dialog was canceled
+        return;
+    }
+    if (viewerMode()) {
+        mappedView->goToLine(line); // uses the line index of the viewer
+    } else {
+        showLine(line);
+    }
+}
+
+void TextEditor::showLine(qint64 line) { // 1-based, the block tree of the document finds the line in o(log n)
+    QTextCursor cursor(textEdit->document()->findBlockByNumber(int(qMin<qint64>(line, INT_MAX)) - 1));
+    textEdit->setTextCursor(cursor);
+    textEdit->ensureCursorVisible();
+    textEdit->setFocus();
+}
+
+void TextEditor::find() { // the dialog searches the mirror of the change tracker, the document itself is never converted to a string
+    findDialog->activate();
+}
+
+void TextEditor::findInFolder() { // starts in the folder of the current file, the index of a folder is kept on disk between sessions
+    emit folderSearchRequested(currentFile.isEmpty() ? QString() : QFileInfo(currentFile).absolutePath());
+}
+
+void TextEditor::compareWithFile() { // the document as it is now, saved or not, against a file on disk
+    if (viewerMode() || fileLoader->isRunning()) {
+        statusBar()->showMessage(viewerMode() ? tr("Im Betrachter kann nicht verglichen werden") : tr("Die Datei wird noch geladen"), 3000);
+        return;
+    }
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Vergleichen mit"), currentFile.isEmpty() ? QString() : QFileInfo(currentFile).absolutePath(), tr("Text Files (*.txt);;All Files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (!compareDialog) {
+        compareDialog = new CompareDialog(this);
+        connect(compareDialog, &CompareDialog::lineActivated, this, &TextEditor::showLine); // a double-clicked hunk is shown in the document too
+    }
+    compareDialog->compare(changeTracker->table(), displayName(), fileName);
+}
+
+void TextEditor::showLineWhenLoaded(qint64 line) { // a folder search hit, its tab may only have started loading the file
+    if (fileLoader->isRunning() || evicted) {
+        pendingLine = line; // shown by finishLoading
+        return;
+    }
+    if (!viewerMode()) { // the viewer has no cursor to move
+        showLine(line);
+    }
+}
+
+void TextEditor::setProfiling(bool enabled) { // every start is a new session, stopping keeps it for the export
+    if (enabled) {
+        Profiler::clear();
+        keyPressed = -1;
+        latencyTimer->start(1000);
+    } else {
+        latencyTimer->stop();
+    }
+    Profiler::setEnabled(enabled);
+    latencyLabel->setVisible(enabled);
+    updateLatency();
+}
+
+void TextEditor::updateLatency() { // keystroke to paint in the label, every other timer in its tooltip
+    LatencyStats keys = Profiler::stats("keyToPaint");
+    latencyLabel->setText(keys.count == 0 ? tr("Latenz: -") : tr("Latenz p50 %1 ms, p99 %2 ms").arg(keys.p50, 0, 'f', 1).arg(keys.p99, 0, 'f', 1));
+    QStringList lines;
+    const QStringList names = Profiler::names();
+    for (const QString &name : names) {
+        LatencyStats stats = Profiler::stats(name.toLatin1().constData());
+        lines.append(tr("%1: p50 %2 ms, p99 %3 ms, max %4 ms (%5)").arg(name).arg(stats.p50, 0, 'f', 2).arg(stats.p99, 0, 'f', 2).arg(stats.max, 0, 'f', 2).arg(stats.count));
+    }
+    latencyLabel->setToolTip(lines.join(QLatin1Char('\n')));
+}
+
+void TextEditor::exportTrace() {
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Trace exportieren"), "", tr("Trace Files (*.json);;All Files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+    try {
+        Profiler::exportTrace(fileName);
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, tr("Fehler"), tr(e.what())); // handles the exception
+    }
+}
+
+void TextEditor::setFollowing(bool enabled) { // the followed file is read-only, its end is appended as it grows
+    if (!enabled) {
+        if (follower->isActive()) {
+            fileBytes = follower->position();
+            undoEngine->setRecording(true);
+            undoEngine->clear(); // the appends were never recorded
+            journal->begin(currentFile, currentFormat, textFormat);
+            journal->snapshot(); // the file may have grown past the document meanwhile, so the journal can't build on it
+            reloader->watch(currentFile);
         }
-        updateCharCount(); // update character count label
+        stopFollowing();
+        return;
+    }
+    if (currentFile.isEmpty() || viewerMode() || fileLoader->isRunning() || currentFormat != Compression::Format::None) { // only a loaded plain file can be followed, compressed data can't be continued
+        statusBar()->showMessage(tr("Nur eine geladene Datei kann verfolgt werden"), 3000);
+        stopFollowing();
+        return;
+    }
+    if (modified || fileBytes < 0) { // the document has to match the file up to a known byte, so it is loaded again first
+        if (!askForSave()) {
+            stopFollowing();
+            return;
+        }
+        startLoading(currentFile);
+        followAfterLoading = true; // finishLoading starts following
+        if (followAction) {
+            followAction->setChecked(true);
+        }
+        return;
+    }
+    journal->discard(); // nothing is edited while following
+    reloader->stop();
+    reloader->unwatch(); // the follower takes care of changes on disk
+    undoEngine->setRecording(false);
+    textEdit->setReadOnly(true);
+    follower->start(currentFile, fileBytes, textFormat); // the appended bytes are decoded like the rest of the file
+    if (followAction) {
+        followAction->setChecked(follower->isActive());
     }
 }
 
-void TextEditor::cut() { // works with textedit method
-    textEdit->cut();
+void TextEditor::stopFollowing() { // the callers reset the journal and the undo history themselves
+    follower->stop();
+    followAfterLoading = false;
+    if (!fileLoader->isRunning()) {
+        textEdit->setReadOnly(false);
+    }
+    if (followAction) {
+        followAction->setChecked(false);
+    }
+}
+
+void TextEditor::appendFollowedText(const QString &text) { // one batch of the follower, at most a few mb per turn of the event loop
+    appendLoadedText(text);
     updateCharCount();
+    if (autoScroll) {
+        textEdit->verticalScrollBar()->setValue(textEdit->verticalScrollBar()->maximum());
+    }
 }
 
-void TextEditor::copy() { // works with textedit method
-    textEdit->copy();
+void TextEditor::reloadFromDisk() { // another program changed the file, only the ranges that differ are replaced
+    if (fileLoader->isRunning() || fileSaver->isRunning() || follower->isActive() || chunkedReplace->isRunning() || lineTransformer->isRunning() || viewerMode() || evicted) {
+        return;
+    }
+    if (modified) {
+        QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Datei geändert"), tr("\"%1\" wurde außerhalb des Editors geändert. Neu laden und die eigenen Änderungen verwerfen?").arg(QFileInfo(currentFile).fileName()));
+        if (answer != QMessageBox::Yes) { // the document stays as it is, saving it overwrites the other version
+            return;
+        }
+    }
+    statusBar()->showMessage(tr("Neu laden..."));
+    reloader->reload(changeTracker->table(), changeTracker->revision()); // compared on the worker, typing goes on meanwhile
 }
 
-void TextEditor::paste() { // works with textedit method
-    textEdit->paste();
+void TextEditor::applyReload(const QList<TextDiff::Edit> &edits, qint64 revision, const TextCodec::Format &format, bool invalid) {
+    if (revision != changeTracker->revision()) { // the document changed while it was compared, so the positions don't fit anymore
+        reloader->reload(changeTracker->table(), changeTracker->revision());
+        return;
+    }
+    ScopedTimer timer("applyReload");
+    QScrollBar *vertical = textEdit->verticalScrollBar();
+    QScrollBar *horizontal = textEdit->horizontalScrollBar();
+    const int top = vertical->value();
+    const int left = horizontal->value();
+    undoEngine->breakGroup();
+    undoEngine->beginTransaction(); // the whole reload is one undo step
+    QTextCursor cursor(textEdit->document()); // no edit block, it would merge all edits into one change from the first to the last
+    for (auto edit = edits.crbegin(); edit != edits.crend(); ++edit) { // from the back, so the positions in front stay valid
+        cursor.setPosition(int(edit->position));
+        cursor.setPosition(int(edit->position + edit->removed), QTextCursor::KeepAnchor);
+        cursor.insertText(edit->inserted);
+    }
+    undoEngine->endTransaction();
+    vertical->setValue(top); // the visible cursor was moved along by the document itself
+    horizontal->setValue(left);
+    textFormat = format; // the other program may have written another encoding
+    invalidBytes = invalid;
+    journal->begin(currentFile, currentFormat, textFormat); // the new file on disk is the base now
+    fileBytes = QFileInfo(currentFile).size();
+    updateFormat();
+    setModified(false);
     updateCharCount();
+    statusBar()->showMessage(tr("Neu geladen, %1 Stellen geändert").arg(edits.size()), 3000);
+}
+
+void TextEditor::setTextFormat(const TextCodec::Format &format) { // picked in the menu, the document itself stays as it is
+    if (format == textFormat) {
+        return;
+    }
+    textFormat = format;
+    setModified(true); // the file on disk differs from what saving writes now
+    updateFormat();
+}
+
+void TextEditor::updateFormat() { // the label in the status bar and the check marks in the menu
+    formatLabel->setText(TextCodec::name(textFormat));
+    formatLabel->setVisible(!viewerMode()); // the viewer decodes the file on its own, the menu doesn't apply there
+    if (encodingGroup) { // the menus may not exist yet right after the start
+        const bool utf16 = textFormat.encoding == TextCodec::Encoding::Utf16LE || textFormat.encoding == TextCodec::Encoding::Utf16BE;
+        const int encoding = int(textFormat.encoding) * 2 + int(textFormat.bom || utf16); // utf-16 found without a mark still checks its entry
+        for (QAction *action : encodingGroup->actions()) {
+            action->setChecked(action->data().toInt() == encoding);
+        }
+    }
+    if (lineEndingGroup) {
+        for (QAction *action : lineEndingGroup->actions()) {
+            action->setChecked(action->data().toInt() == int(textFormat.lineEnding));
+        }
+    }
+}
+
+void TextEditor::setViewerMode(bool enabled) { // switches between the editor and the read-only viewer for huge files
+    if (!enabled && mappedView->isOpen()) {
+        mappedView->close(); // unmaps the previous huge file
+    }
+    centralStack->setCurrentWidget(enabled ? static_cast<QWidget *>(mappedView) : textEdit);
+    if (editMenu) { // the menus may not exist yet right after the start
+        editMenu->setEnabled(!enabled); // nothing can be edited in the viewer
+        encodingGroup->setEnabled(!enabled); // the viewer copies the file as it is
+        lineEndingGroup->setEnabled(!enabled);
+    }
+    if (enabled) {
+        findDialog->hide(); // the dialog only works on the editor
+        if (compareDialog) {
+            compareDialog->hide();
+        }
+    }
+    updatePosition();
+    updateFormat();
+}
+
+bool TextEditor::viewerMode() const {
+    return centralStack->currentWidget() == mappedView;
+}
+
+void TextEditor::exitFile() {    // quits the application, every window asks for its own unsaved documents
+    QApplication::closeAllWindows(); // stops at the first window that is kept open, the application ends with the last one
+}
+
+void TextEditor::closeEvent(QCloseEvent *event) { // only a window of its own gets here, the documents in tabs are asked by their window
+    if (!askForSave()) {
+        event->ignore();
+        return;
+    }
+    closeDocument();
+    event->accept();
+}
+
+void TextEditor::closeDocument() { // the changes were saved or dropped on purpose, nothing to recover
+    ++documentGeneration;
+    fileLoader->stop();
+    journal->discard();
+    spill.reset();
+}
+
+void TextEditor::openLater(const QString &fileName) { // for a tab in the background, nothing is read before activate()
+    currentFile = fileName;
+    evicted = true;
+    setModified(false);
+}
+
+qint64 TextEditor::memoryUsage() const { // an estimate of what evict() frees, the document and the mirror of the change tracker hold every character once each
+    if (evicted || viewerMode()) { // the viewer maps the file, the os drops its pages on its own
+        return 0;
+    }
+    return qint64(changeTracker->size()) * 2 * qint64(sizeof(QChar)) + statistics->lines() * lineOverhead + undoEngine->memoryUsage();
+}
+
+bool TextEditor::evict() { // drops the text, its layout and its history, activate() loads the text again from the file or the spill
+    if (evicted || viewerMode() || isBusy() || follower->isActive() || followAfterLoading || (currentFile.isEmpty() && !modified)) {
+        return false;
+    }
+    ScopedTimer timer("evict");
+    const bool wasModified = modified;
+    const qint64 bytes = fileBytes;
+    if (modified || fileBytes < 0) { // the file doesn't hold this text
+        try {
+            writeSpill();
+        } catch (const std::exception& e) {
+            statusBar()->showMessage(tr(e.what()), 5000); // the document simply stays in memory
+            return false;
+        }
+        journal->suspend(); // stays on disk and locked, a crash while evicted still recovers the text
+    } else {
+        journal->discard();
+    }
+    evictedPosition = textEdit->textCursor().position();
+    reloader->stop();
+    reloader->unwatch(); // a change on disk is picked up by loading the file again
+    undoEngine->setRecording(false);
+    textEdit->clear(); // frees the blocks and their layouts
+    statistics->recount(); // the removed text would wait for the word count otherwise
+    highlighter->setGrammar(nullptr);
+    undoEngine->setRecording(true);
+    undoEngine->clear(); // the history can't be undone on a text that isn't there
+    fileBytes = bytes; // clearing counts as an edit, the state of the document is what it was
+    setModified(wasModified);
+    evicted = true;
+    return true;
+}
+
+bool TextEditor::isEvicted() const {
+    return evicted;
+}
+
+void TextEditor::activate() { // the tab is shown, a document that was evicted or opened in the background is loaded now
+    if (!evicted) {
+        return;
+    }
+    evicted = false;
+    if (!spill) { // the file holds the text, it is opened like any other file, so a huge one ends up in the viewer again
+        if (!currentFile.isEmpty()) {
+            openFile(currentFile);
+        }
+        if (!fileLoader->isRunning()) { // the viewer or a failed open, there is no text to put the cursor in
+            evictedPosition = -1;
+        }
+        return;
+    }
+    const QString file = currentFile; // the spill only replaces the file while it is read
+    const Compression::Format compression = currentFormat;
+    const TextCodec::Format format = textFormat;
+    const bool invalid = invalidBytes;
+    startLoading(spill->fileName());
+    cancelLoadButton->hide(); // the spill holds the only copy of the text, canceling would lose it
+    currentFile = file;
+    currentFormat = compression;
+    textFormat = format;
+    invalidBytes = invalid;
+    updateFormat();
+    setModified(true);
+}
+
+void TextEditor::writeSpill() { // the temporary file is removed with the document or once the text is loaded from it
+    auto file = std::make_unique<QTemporaryFile>(QDir::tempPath() + QLatin1String("/schlichting_texteditor-XXXXXX.spill"));
+    if (!file->open()) {
+        throw std::runtime_error("Kann nicht auslagern: " + file->errorString().toStdString());
+    }
+    const PieceTable text = changeTracker->table();
+    TextEncoder encoder(spillFormat);
+    for (qsizetype position = 0; position < text.size(); position += FileSaver::chunkSize) {
+        const QByteArray bytes = encoder.encode(text.mid(position, FileSaver::chunkSize)); // only one chunk is copied out at a time
+        if (file->write(bytes) != bytes.size()) {
+            throw std::runtime_error("Kann nicht auslagern: " + file->errorString().toStdString());
+        }
+    }
+    const QByteArray rest = encoder.finish();
+    if (file->write(rest) != rest.size() || !file->flush()) {
+        throw std::runtime_error("Kann nicht auslagern: " + file->errorString().toStdString());
+    }
+    file->close(); // the name stays valid, the loader opens it again on its own thread
+    spill = std::move(file);
+}
+
+void TextEditor::undo() {
+    if (chunkedReplace->isRunning() || lineTransformer->isRunning()) { // the running paste is not a complete step yet
+        return;
+    }
+    ScopedTimer timer("undo");
+    int position = undoEngine->undo(); // reverts only the ranges of the latest step, independent of the document size
+    if (position >= 0) {
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(position); // the cursor jumps to where the change was reverted
+        textEdit->setTextCursor(cursor);
+    }
+}
+
+void TextEditor::redo() {
+    if (chunkedReplace->isRunning() || lineTransformer->isRunning()) {
+        return;
+    }
+    int position = undoEngine->redo(); // applies the latest undone step again
+    if (position >= 0) {
+        QTextCursor cursor = textEdit->textCursor();
+        cursor.setPosition(position); // the cursor jumps behind the restored change
+        textEdit->setTextCursor(cursor);
+    }
+}
+
+void TextEditor::cut() { // the clipboard gets a snapshot, so removing the selection needs no copy of it
+    if (textEdit->isReadOnly() || !textEdit->textCursor().hasSelection()) {
+        return;
+    }
+    copy();
+    replaceSelection(PieceTable(), 0, 0);
+}
+
+void TextEditor::copy() { // the text is only built when something is pasted, a huge selection costs nothing until then
+    QTextCursor cursor = textEdit->textCursor();
+    if (!cursor.hasSelection()) {
+        return;
+    }
+    QGuiApplication::clipboard()->setMimeData(new LazyMimeData(changeTracker->table(), cursor.selectionStart(), cursor.selectionEnd() - cursor.selectionStart()));
+}
+
+void TextEditor::paste() { // copies from this editor are read straight from their snapshot
+    if (textEdit->isReadOnly()) {
+        return;
+    }
+    const QMimeData *mimeData = QGuiApplication::clipboard()->mimeData();
+    if (!mimeData) {
+        return;
+    }
+    if (const auto *own = qobject_cast<const LazyMimeData *>(mimeData)) {
+        replaceSelection(own->source(), own->position(), own->length());
+        return;
+    }
+    if (!mimeData->hasText()) {
+        return;
+    }
+    QString text = mimeData->text();
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n")); // qt would turn \r into a line break of its own
+    const qsizetype length = text.size();
+    replaceSelection(PieceTable(text), 0, length); // shares the string, no second copy
 }
 
 void TextEditor::deleteText() { // works with textedit methods and deletes selected text
-    textEdit->textCursor().removeSelectedText();
+    if (textEdit->isReadOnly() || !textEdit->textCursor().hasSelection()) {
+        return;
+    }
+    replaceSelection(PieceTable(), 0, 0);
+}
+
+void TextEditor::replaceSelection(const PieceTable &text, qsizetype position, qsizetype length) { // is its own undo step, big ones are done chunk by chunk in idle time
+    QTextCursor cursor = textEdit->textCursor();
+    const qsizetype start = cursor.selectionStart();
+    const qsizetype removed = cursor.selectionEnd() - start;
+    if (removed + length <= ChunkedReplace::threshold) {
+        undoEngine->breakGroup();
+        if (length > 0) {
+            cursor.insertText(text.mid(position, length)); // replaces the selection in the same edit
+        } else {
+            cursor.removeSelectedText();
+        }
+        undoEngine->breakGroup(); // typing right behind doesn't merge into the paste
+        textEdit->setTextCursor(cursor);
+        updateCharCount();
+        return;
+    }
+    textEdit->setReadOnly(true); // no typing in between, the chunks are one undo step
+    chunkedReplace->start(start, removed, text, position, length);
+}
+
+void TextEditor::finishReplacing(qsizetype end) {
+    stopReplacing();
+    QTextCursor cursor = textEdit->textCursor();
+    cursor.setPosition(int(end));
+    textEdit->setTextCursor(cursor);
+    textEdit->ensureCursorVisible();
+    statusBar()->clearMessage();
     updateCharCount();
 }
 
+void TextEditor::stopReplacing() { // what was done so far stays as one undo step, a line operation that didn't finish is dropped
+    chunkedReplace->stop();
+    lineTransformer->stop();
+    if (!fileLoader->isRunning() && !follower->isActive()) {
+        textEdit->setReadOnly(false);
+    }
+}
+
+void TextEditor::filterLines(bool keepMatches) { // the lines are filtered by a regular expression, like grep in place
+    bool ok = false;
+    const QString pattern = QInputDialog::getText(this, keepMatches ? tr("Zeilen behalten") : tr("Zeilen entfernen"), tr("Regulärer Ausdruck:"), QLineEdit::Normal, QString(), &ok);
+    if (!ok || pattern.isEmpty()) {
+        return;
+    }
+    LineOperation operation;
+    operation.kind = LineOperation::Filter;
+    operation.filter.pattern = pattern;
+    operation.filter.regex = true;
+    operation.filter.caseSensitive = true;
+    operation.keepMatches = keepMatches;
+    transformLines(operation);
+}
+
+void TextEditor::transformLines(const LineOperation &operation) { // the lines touched by the selection, or the whole document, are transformed on the thread pool
+    if (viewerMode() || textEdit->isReadOnly() || isBusy()) {
+        statusBar()->showMessage(viewerMode() ? tr("Im Betrachter kann nicht bearbeitet werden") : tr("Das Dokument wird gerade bearbeitet"), 3000);
+        return;
+    }
+    QTextCursor cursor = textEdit->textCursor();
+    qsizetype start = 0;
+    qsizetype end = changeTracker->size();
+    if (cursor.hasSelection()) {
+        QTextDocument *document = textEdit->document();
+        QTextBlock first = document->findBlock(cursor.selectionStart());
+        QTextBlock last = document->findBlock(cursor.selectionEnd());
+        if (last != first && cursor.selectionEnd() == last.position()) { // a selection up to the start of a line doesn't include that line
+            last = last.previous();
+        }
+        start = first.position();
+        end = last.position() + last.length() - 1; // without the line end, the line behind stays apart
+    } else if (end > 0 && changeTracker->table().at(end - 1) == QLatin1Char('\n')) { // the final line end stays at the end
+        --end;
+    }
+    if (end <= start) {
+        return;
+    }
+    transformStart = start;
+    transformLength = end - start;
+    transformRevision = changeTracker->revision();
+    textEdit->setReadOnly(true); // the range must not move until the result is there
+    statusBar()->showMessage(tr("Zeilen werden bearbeitet..."));
+    lineTransformer->start(changeTracker->table(), start, end - start, operation);
+}
+
+void TextEditor::finishTransform(const QString &result, qint64 lines, qint64 resultLines, qint64 elapsed) { // the result replaces the range as one undo step
+    stopReplacing(); // gives the document back
+    if (changeTracker->revision() != transformRevision) { // reloaded in the meantime, the range is not the one that was transformed
+        statusBar()->showMessage(tr("Das Dokument wurde inzwischen geändert"), 3000);
+        return;
+    }
+    QTextCursor cursor = textEdit->textCursor();
+    cursor.setPosition(int(transformStart));
+    cursor.setPosition(int(transformStart + transformLength), QTextCursor::KeepAnchor);
+    textEdit->setTextCursor(cursor);
+    replaceSelection(PieceTable(result), 0, result.size()); // shares the string, big results go chunk by chunk
+    statusBar()->showMessage(tr("%1 Zeilen, danach %2 (%3 ms)").arg(lines).arg(resultLines).arg(elapsed), 5000);
+}
+
 void TextEditor::toggleDarkMode(bool dark) // https://stackoverflow.com/questions/15035767/is-the-qt-5-dark-fusion-theme-available-for-windows
 {
     if (dark)
@@ -302,3 +1416,36 @@ void TextEditor::toggleDarkMode(bool dark) // https://stackoverflow.com/question
     }
 }
 
+bool TextEditor::eventFilter(QObject *watched, QEvent *event) {
+    if (startupPending && event->type() == QEvent::Paint) {
+        startupPending = false;
+        QTimer::singleShot(0, this, &TextEditor::finishStartup); // runs once the first frame is on screen
+    }
+    if (Profiler::isEnabled()) {
+        if (watched == textEdit && event->type() == QEvent::KeyPress && keyPressed < 0) { // the latency runs until the key shows up on screen
+            keyPressed = Profiler::now();
+        } else if (watched == textEdit->viewport() && event->type() == QEvent::Paint && !painting) {
+            painting = true;
+            {
+                ScopedTimer timer("paint"); // includes the layout of blocks that just scrolled into view
+                QCoreApplication::sendEvent(watched, event); // paints inside the timer, the original event is dropped below
+            }
+            painting = false;
+            if (keyPressed >= 0) {
+                Profiler::record("keyToPaint", keyPressed, Profiler::now() - keyPressed);
+                keyPressed = -1;
+            }
+            return true;
+        }
+    }
+    if (watched == textEdit && event->type() == QEvent::ShortcutOverride) { // qtextedit would handle undo/redo keys on its own
+        auto *keyEvent = static_cast<QKeyEvent *>(event);
+        if (keyEvent->matches(QKeySequence::Undo) || keyEvent->matches(QKeySequence::Redo)) {
+            return true; // the event stays unaccepted, so the shortcut of our menu action fires instead
+        }
+        if (editMenu && (keyEvent->matches(QKeySequence::Copy) || keyEvent->matches(QKeySequence::Cut) || keyEvent->matches(QKeySequence::Paste))) { // our clipboard handling never builds the whole text, once the menu is there
+            return true;
+        }
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
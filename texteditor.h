@@ -2,9 +2,34 @@
 #define TEXTEDITOR_H
 
 #include <QMainWindow>
-#include <QTextEdit>
-#include <stack>
 #include <QLabel>
+#include <QMenu>
+#include <QStackedWidget>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QAction>
+#include <QActionGroup>
+#include <QTimer>
+#include <QTemporaryFile>
+#include <memory>
+#include "textviewport.h"
+#include "changetracker.h"
+#include "undoengine.h"
+#include "documentstatistics.h"
+#include "mappedfileview.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "filefollower.h"
+#include "filereloader.h"
+#include "textcodec.h"
+#include "finddialog.h"
+#include "comparedialog.h"
+#include "highlightengine.h"
+#include "editjournal.h"
+#include "profiler.h"
+#include "idlescheduler.h"
+#include "chunkedreplace.h"
+#include "linetransformer.h"
 
 class TextEditor : public QMainWindow {
     Q_OBJECT
@@ -13,6 +38,27 @@ class TextEditor : public QMainWindow {
         TextEditor(QWidget *parent = nullptr);
         ~TextEditor() = default;
 
+        static constexpr qint64 lineOverhead = 160; // estimated bytes of block, layout and format data per line of the document
+
+        void openFile(const QString &fileName);
+        void openLater(const QString &fileName);
+        void saveAsFile(const QString &fileName);
+        bool isBusy() const;
+        bool isUntouched() const;
+        QString fileName() const;
+        bool askForSave();
+        void closeDocument();
+        qint64 memoryUsage() const;
+        bool evict();
+        bool isEvicted() const;
+        void activate();
+        void showLineWhenLoaded(qint64 line);
+
+    signals:
+        void menusCreated(); // a tab host shows the menus of its current tab in its own menu bar
+        void documentLoaded();
+        void folderSearchRequested(const QString &startFolder); // the window owns the folder search, so one index is written at a time
+
     public slots:
         void newFile();
         void saveAsFile();
@@ -21,23 +67,114 @@ class TextEditor : public QMainWindow {
         void openFile();
         void textModified();
         void undo();
+        void redo();
         void cut();
         void copy();
         void paste();
         void deleteText();
         void toggleDarkMode(bool dark);
+        void goToLine();
+        void find();
+        void findInFolder();
+        void compareWithFile();
+        void updateCharCount();
+        void recoverSession();
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override;
+        void closeEvent(QCloseEvent *event) override;
 
     private:
         void createMenus();
-        bool askForSave();
         bool modified;
         void setupConnections();
         void setModified(bool value);
-        void updateCharCount();
+        void updatePosition();
+        void scheduleStatusUpdate();
+        void setViewerMode(bool enabled);
+        bool viewerMode() const;
+        void startLoading(const QString &fileName);
+        void appendLoadedText(const QString &text);
+        void showLoadProgress(qint64 bytesRead, qint64 bytesTotal);
+        void finishLoading();
+        void abortLoading(const QString &message);
+        void endLoading();
+        bool saveDocument();
+        bool saveTo(const QString &fileName);
+        PieceTable documentText() const;
+        void writeSpill();
+        QString displayName() const;
+        void saveFinished(const QString &fileName);
+        void saveFailed(const QString &error);
+        void finishStartup();
+        void restore(const JournalRecovery &recovery);
+        void setProfiling(bool enabled);
+        void updateLatency();
+        void exportTrace();
+        void setFollowing(bool enabled);
+        void stopFollowing();
+        void appendFollowedText(const QString &text);
+        void reloadFromDisk();
+        void replaceSelection(const PieceTable &text, qsizetype position, qsizetype length);
+        void finishReplacing(qsizetype end);
+        void stopReplacing();
+        void applyReload(const QList<TextDiff::Edit> &edits, qint64 revision, const TextCodec::Format &format, bool invalid);
+        void showLine(qint64 line);
+        void setTextFormat(const TextCodec::Format &format);
+        void updateFormat();
+        void transformLines(const LineOperation &operation);
+        void finishTransform(const QString &result, qint64 lines, qint64 resultLines, qint64 elapsed);
+        void filterLines(bool keepMatches);
 
-        QTextEdit *textEdit;
-        std::stack<QString> undoStack;
+        QStackedWidget *centralStack;
+        TextViewport *textEdit;
+        MappedFileView *mappedView;
+        IdleScheduler *scheduler; // side effects of edits that can wait for a pause in the input
+        ChangeTracker *changeTracker;
+        UndoEngine *undoEngine;
+        DocumentStatistics *statistics;
+        HighlightEngine *highlighter;
+        EditJournal *journal;
         QLabel *charCountLabel;
+        QLabel *positionLabel;
+        QLabel *formatLabel;
+        QMenu *editMenu;
+        FileLoader *fileLoader;
+        QProgressBar *loadProgress;
+        QToolButton *cancelLoadButton;
+        FileSaver *fileSaver;
+        FileFollower *follower;
+        QAction *followAction;
+        QActionGroup *encodingGroup;
+        QActionGroup *lineEndingGroup;
+        FileReloader *reloader;
+        FindDialog *findDialog;
+        CompareDialog *compareDialog; // built when it is first used
+        ChunkedReplace *chunkedReplace; // pastes, cuts and deletes that are too big for one go
+        LineTransformer *lineTransformer; // sorts, filters and the like of whole lines on the thread pool
+        qsizetype transformStart; // range of the running line operation
+        qsizetype transformLength;
+        qint64 transformRevision; // the result is dropped if the document changed meanwhile
+        qint64 savingRevision;
+        Compression::Format savingFormat;
+        quint64 documentGeneration; // counts the documents shown in this editor, a save that reports back after its document was replaced is ignored
+        QList<quint64> savingGenerations; // generation of every save that hasn't reported back yet, oldest first, the saver reports in order
+        QString currentFile;
+        Compression::Format currentFormat; // a compressed file is saved compressed again
+        TextCodec::Format textFormat; // encoding and line ends the file is written with, detected when it is loaded
+        bool invalidBytes; // the file has bytes that aren't valid in textFormat, they were loaded as U+FFFD and saving over it loses them
+        qint64 fileBytes; // bytes of the current file the unchanged document holds, -1 once it differs from the file
+        bool followAfterLoading; // following waits for the file to be loaded again
+        bool evicted; // the text was dropped to free memory or not loaded yet, activate() loads it
+        std::unique_ptr<QTemporaryFile> spill; // text of an evicted document that differs from its file
+        qsizetype evictedPosition; // cursor of the evicted document, set again once it is loaded, -1 if there is none
+        qint64 pendingLine; // line of a folder search hit, shown once its file is loaded, -1 if there is none
+        bool autoScroll;
+        QLabel *latencyLabel;
+        QTimer *latencyTimer;
+        qint64 keyPressed; // time of the latest key press that wasn't painted yet, -1 if there is none
+        bool painting;
+        bool startupPending; // menus and style are set up after the first paint
 };
 
 #endif // TEXTEDITOR_H
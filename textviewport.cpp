@@ -0,0 +1,97 @@
+#include "textviewport.h"
+#include <QTextDocument>
+#include <QTimer>
+#include "profiler.h"
+
+TextViewport::TextViewport(QWidget *parent): QPlainTextEdit(parent), retainedFirst(0), retainedLast(-1), knownBlockCount(document()->blockCount()) { // constructor
+    // the plain text layout of qplaintextedit lays out blocks on demand, so loading a file doesn't lay out anything
+    connect(document(), &QTextDocument::contentsChange, this, [this](int position) {
+        contentsChanged(position);
+    });
+    connect(this, &QPlainTextEdit::cursorPositionChanged, this, [this]() { // a jump that doesn't scroll still lays out the block of the cursor
+        addStray(textCursor().blockNumber());
+    });
+}
+
+int TextViewport::firstVisibleLine() const {
+    return firstVisibleBlock().blockNumber();
+}
+
+int TextViewport::lastVisibleLine() const {
+    return cursorForPosition(QPoint(0, viewport()->height() - 1)).blockNumber();
+}
+
+void TextViewport::scrollContentsBy(int dx, int dy) {
+    QPlainTextEdit::scrollContentsBy(dx, dy);
+    if (dy != 0) {
+        releaseLayouts();
+    }
+}
+
+void TextViewport::resizeEvent(QResizeEvent *event) {
+    QPlainTextEdit::resizeEvent(event);
+    releaseLayouts();
+}
+
+void TextViewport::releaseLayouts() { // drops the layouts of blocks that left the margin, they are laid out again when they come back
+    ScopedTimer timer("releaseLayouts");
+    const int first = qMax(0, firstVisibleLine() - layoutMargin);
+    const int last = qMin(document()->blockCount() - 1, lastVisibleLine() + layoutMargin);
+    if (retainedLast >= retainedFirst) {
+        QTextBlock block = document()->findBlockByNumber(retainedFirst); // o(log n) in the block tree, then only the old window is walked
+        for (int number = retainedFirst; number <= retainedLast && block.isValid(); ++number, block = block.next()) {
+            if (number < first || number > last) {
+                block.clearLayout(); // keeps the formats of the highlighting, only the lines are dropped
+            }
+        }
+    }
+    retainedFirst = first;
+    retainedLast = last;
+    releaseStrays();
+}
+
+void TextViewport::releaseStrays() {
+    for (int number : std::as_const(strays)) {
+        if (number < retainedFirst || number > retainedLast) {
+            document()->findBlockByNumber(number).clearLayout(); // an invalid block of a number that is gone does nothing
+        }
+    }
+    strays.clear();
+}
+
+void TextViewport::contentsChanged(int position) { // keeps the numbers on the same blocks when lines are inserted or removed in front of them
+    const int editBlock = document()->findBlock(position).blockNumber();
+    const int delta = document()->blockCount() - knownBlockCount;
+    knownBlockCount = document()->blockCount();
+    if (delta != 0) { // qt clears the layouts of every block an edit over several lines touched, only the numbers behind it move
+        retainedFirst = shifted(retainedFirst, editBlock, delta);
+        retainedLast = qMin(shifted(retainedLast, editBlock, delta), knownBlockCount - 1);
+        for (int &number : strays) {
+            number = shifted(number, editBlock, delta);
+        }
+    } else { // an edit within one line is laid out again right away, wherever it is
+        addStray(editBlock);
+    }
+}
+
+void TextViewport::addStray(int block) {
+    if (block >= retainedFirst && block <= retainedLast) {
+        return;
+    }
+    if (strays.isEmpty()) { // one release per turn of the event loop, a replace-all adds many
+        QTimer::singleShot(0, this, &TextViewport::releaseStrays);
+    }
+    if (strays.isEmpty() || strays.last() != block) {
+        strays.append(block);
+    }
+}
+
+int TextViewport::shifted(int block, int editBlock, int delta) const { // number of a block after an edit in editBlock that changed the block count by delta
+    if (block <= editBlock) {
+        return block;
+    }
+    if (delta < 0 && block <= editBlock - delta) { // the block was removed, its remains are part of the edited one
+        return editBlock;
+    }
+    return block + delta;
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTVIEWPORT_H
+#define TEXTVIEWPORT_H
+
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QVector>
+
+// editor view that only lays out the lines on screen and a margin around them, the scroll bar counts lines of the block tree
+// instead of pixels, and an edit only relayouts the blocks it touched
+class TextViewport : public QPlainTextEdit {
+    Q_OBJECT
+
+    public:
+        explicit TextViewport(QWidget *parent = nullptr);
+
+        static constexpr int layoutMargin = 100; // lines above and below the viewport that keep their layout, so scrolling a bit never lays out again
+
+        int firstVisibleLine() const;
+        int lastVisibleLine() const;
+
+    protected:
+        void scrollContentsBy(int dx, int dy) override;
+        void resizeEvent(QResizeEvent *event) override;
+
+    private:
+        void releaseLayouts();
+        void releaseStrays();
+        void contentsChanged(int position);
+        void addStray(int block);
+        int shifted(int block, int editBlock, int delta) const;
+
+        int retainedFirst; // blocks in this range may have a layout, everything else was never laid out or was released
+        int retainedLast;
+        int knownBlockCount; // block count before the latest edit, the numbers behind an edit move by the difference
+        QVector<int> strays; // blocks outside the range that qt laid out for an edit or the cursor, released once the event loop turns
+};
+
+#endif // TEXTVIEWPORT_H
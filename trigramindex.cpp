@@ -0,0 +1,521 @@
+#include "trigramindex.h"
+#include "linescanner.h"
+#include <QtConcurrent>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr quint32 indexMagic = 0x31494754; // "TGI1" in native byte order, an index from another machine fails the check and is built again
+constexpr quint32 indexVersion = 1;
+constexpr quint32 skippedFile = 1; // too big, unreadable or binary, listed so it isn't read again until it changes
+constexpr qint64 binaryProbe = 8192; // a zero byte in the first bytes marks a binary file
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    quint32 fileCount;
+    quint32 trigramCount;
+    quint64 filesOffset;
+    quint64 trigramsOffset;
+    quint64 postingsOffset;
+    quint64 postingsSize;
+};
+
+struct PostingList { // file numbers in ascending order, each stored as the varint of its distance to the previous one
+    QByteArray bytes;
+    quint32 last = 0;
+    quint32 count = 0;
+
+    void append(quint32 id) {
+        quint32 delta = id - last;
+        while (delta >= 0x80) {
+            bytes.append(char(delta | 0x80));
+            delta >>= 7;
+        }
+        bytes.append(char(delta));
+        last = id;
+        ++count;
+    }
+};
+
+struct Extracted {
+    QVector<quint32> keys; // every trigram of the file once, in the order of their first appearance
+    bool skipped = false;
+};
+
+inline uchar fold(uchar c) { // ascii only, other bytes are parts of utf-8 sequences or of unknown encodings
+    return c >= 'A' && c <= 'Z' ? uchar(c + ('a' - 'A')) : c;
+}
+
+struct FoldedHash {
+    std::size_t operator()(char c) const { return std::hash<char>()(char(fold(uchar(c)))); }
+};
+
+struct FoldedEqual {
+    bool operator()(char a, char b) const { return fold(uchar(a)) == fold(uchar(b)); }
+};
+
+template <typename T>
+void appendRaw(QByteArray &bytes, const T &value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+Extracted extractTrigrams(const QString &fileName) { // runs on the thread pool, trigrams across line ends are left out since a search term has none
+    Extracted result;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() > TrigramIndex::maxFileSize) {
+        result.skipped = true;
+        return result;
+    }
+    const qint64 size = file.size();
+    if (size == 0) {
+        return result;
+    }
+    const uchar *bytes = file.map(0, size);
+    if (!bytes || std::memchr(bytes, 0, size_t(qMin(size, binaryProbe)))) {
+        result.skipped = true;
+        return result;
+    }
+    thread_local std::vector<quint64> seen(std::size_t(1) << 18); // one bit for each of the 2^24 trigrams, cleared again after every file
+    quint32 key = 0;
+    int run = 0; // bytes since the last line end
+    for (qint64 i = 0; i < size; ++i) {
+        const uchar c = bytes[i];
+        if (c == '\n' || c == '\r') {
+            run = 0;
+            continue;
+        }
+        key = ((key << 8) | fold(c)) & 0xFFFFFF;
+        if (++run >= 3) {
+            quint64 &word = seen[key >> 6];
+            const quint64 bit = quint64(1) << (key & 63);
+            if (!(word & bit)) {
+                word |= bit;
+                result.keys.append(key);
+            }
+        }
+    }
+    for (quint32 found : std::as_const(result.keys)) {
+        seen[found >> 6] = 0;
+    }
+    file.unmap(const_cast<uchar *>(bytes));
+    return result;
+}
+
+template <typename Searcher>
+void collectHits(const char *begin, const char *end, const Searcher &searcher, const QString &fileName, QVector<FolderHit> &hits) { // one hit per line, line numbers are counted up to each match
+    qint64 line = 1;
+    const char *counted = begin;
+    const char *from = begin;
+    while (from < end && hits.size() < TrigramIndex::maxHitsPerFile) {
+        const char *match = searcher(from, end).first;
+        if (match == end) {
+            break;
+        }
+        line += qint64(LineScanner::countNewlines(counted, std::size_t(match - counted)));
+        counted = match;
+        const char *lineStart = match;
+        while (lineStart > begin && lineStart[-1] != '\n') {
+            --lineStart;
+        }
+        const char *lineEnd = static_cast<const char *>(std::memchr(match, '\n', std::size_t(end - match)));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        QString text = QString::fromUtf8(lineStart, qMin<qsizetype>(lineEnd - lineStart, 4 * TrigramIndex::maxLineLength)).trimmed(); // trimming also drops the \r of crlf files
+        hits.append({fileName, line, text.left(TrigramIndex::maxLineLength)});
+        from = lineEnd;
+    }
+}
+
+}
+
+TrigramIndex::TrigramIndex(): data(nullptr), trigrams(nullptr), trigramCount(0), postingData(nullptr), postingSize(0) { // constructor
+}
+
+TrigramIndex::~TrigramIndex() {
+    close();
+}
+
+QString TrigramIndex::indexFileName(const QString &root) { // one index per folder in the cache directory
+    const QByteArray key = QCryptographicHash::hash(QDir::cleanPath(root).toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/trigrams/") + QString::fromLatin1(key) + QLatin1String(".index");
+}
+
+void TrigramIndex::open(const QString &root, const QString &indexFile) { // a missing index leaves it closed, a broken one throws
+    close();
+    rootPath = root;
+    file.setFileName(indexFile);
+    if (!file.exists()) {
+        return;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    auto broken = [this]() {
+        close();
+        return std::runtime_error("Index ist beschädigt: " + file.fileName().toStdString());
+    };
+    const qint64 size = file.size();
+    if (size < qint64(sizeof(Header))) {
+        throw broken();
+    }
+    data = file.map(0, size);
+    if (!data) {
+        close();
+        throw std::runtime_error("Kann nicht öffnen: " + file.errorString().toStdString());
+    }
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != indexMagic || header.version != indexVersion || header.filesOffset > header.trigramsOffset || header.trigramsOffset % 8 != 0
+            || header.trigramsOffset + quint64(header.trigramCount) * sizeof(TrigramEntry) > header.postingsOffset || header.postingsOffset + header.postingsSize > quint64(size)) {
+        throw broken();
+    }
+
+    const uchar *entry = data + header.filesOffset;
+    const uchar *tableEnd = data + header.trigramsOffset;
+    files.reserve(header.fileCount);
+    for (quint32 i = 0; i < header.fileCount; ++i) {
+        FileEntry listed;
+        quint32 length;
+        if (tableEnd - entry < 24) {
+            throw broken();
+        }
+        std::memcpy(&listed.size, entry, 8);
+        std::memcpy(&listed.modified, entry + 8, 8);
+        std::memcpy(&listed.flags, entry + 16, 4);
+        std::memcpy(&length, entry + 20, 4);
+        entry += 24;
+        if (tableEnd - entry < qint64(length)) {
+            throw broken();
+        }
+        listed.path = QString::fromUtf8(reinterpret_cast<const char *>(entry), qsizetype(length));
+        entry += length;
+        files.append(listed);
+    }
+    trigrams = reinterpret_cast<const TrigramEntry *>(data + header.trigramsOffset); // the mapping starts on a page, the table on a multiple of 8
+    trigramCount = header.trigramCount;
+    postingData = data + header.postingsOffset;
+    postingSize = qint64(header.postingsSize);
+}
+
+void TrigramIndex::close() {
+    if (data) {
+        file.unmap(const_cast<uchar *>(data));
+    }
+    file.close();
+    data = nullptr;
+    files.clear();
+    trigrams = nullptr;
+    trigramCount = 0;
+    postingData = nullptr;
+    postingSize = 0;
+}
+
+bool TrigramIndex::isOpen() const {
+    return data != nullptr;
+}
+
+QString TrigramIndex::root() const {
+    return rootPath;
+}
+
+qsizetype TrigramIndex::fileCount() const {
+    return files.size();
+}
+
+bool TrigramIndex::build(const QString &root, const TrigramIndex *previous, const QString &target, const std::atomic<bool> *canceled, const Progress &progress) { // returns false if nothing changed or it was canceled, then nothing is written
+    const QVector<FileEntry> found = crawl(root, canceled);
+    if (canceled && *canceled) {
+        return false;
+    }
+
+    const bool incremental = previous && previous->isOpen() && previous->rootPath == root;
+    QHash<QString, quint32> known;
+    if (incremental) {
+        known.reserve(previous->files.size());
+        for (quint32 id = 0; id < quint32(previous->files.size()); ++id) {
+            known.insert(previous->files.at(id).path, id);
+        }
+    }
+    QVector<quint32> kept; // numbers in the previous index of the files with the same size and time as then
+    QVector<FileEntry> changed; // new or changed files, they are read
+    for (const FileEntry &entry : found) {
+        auto old = known.constFind(entry.path);
+        if (old != known.constEnd() && previous->files.at(*old).size == entry.size && previous->files.at(*old).modified == entry.modified) {
+            kept.append(*old);
+        } else {
+            changed.append(entry);
+        }
+    }
+    if (incremental && changed.isEmpty() && kept.size() == previous->files.size()) { // nothing was added, changed or removed
+        return false;
+    }
+
+    std::sort(kept.begin(), kept.end()); // in their previous order, so the renumbered posting lists stay sorted
+    QVector<FileEntry> table;
+    table.reserve(kept.size() + changed.size());
+    QVector<qint32> renumbered(incremental ? previous->files.size() : 0, -1);
+    for (quint32 id : std::as_const(kept)) {
+        renumbered[id] = qint32(table.size());
+        table.append(previous->files.at(id));
+    }
+    std::unordered_map<quint32, PostingList> lists;
+    if (!kept.isEmpty()) { // the lists of the kept files are taken over without reading the files again
+        for (quint32 i = 0; i < previous->trigramCount; ++i) {
+            const TrigramEntry &entry = previous->trigrams[i];
+            PostingList *list = nullptr;
+            for (quint32 id : previous->decode(entry)) {
+                if (renumbered.at(id) >= 0) {
+                    if (!list) {
+                        list = &lists[entry.key];
+                    }
+                    list->append(quint32(renumbered.at(id)));
+                }
+            }
+        }
+    }
+
+    for (qsizetype begin = 0; begin < changed.size(); begin += batchSize) { // files are read in parallel and merged in order, so the lists stay sorted
+        if (canceled && *canceled) {
+            return false;
+        }
+        const QVector<FileEntry> batch = changed.mid(begin, batchSize);
+        const QList<Extracted> extracted = QtConcurrent::blockingMapped<QList<Extracted>>(batch, [&root](const FileEntry &entry) {
+            return extractTrigrams(root + QLatin1Char('/') + entry.path);
+        });
+        for (qsizetype i = 0; i < batch.size(); ++i) {
+            FileEntry entry = batch.at(i);
+            entry.flags = extracted.at(i).skipped ? skippedFile : 0;
+            const quint32 id = quint32(table.size());
+            table.append(entry);
+            for (quint32 key : extracted.at(i).keys) {
+                lists[key].append(id);
+            }
+        }
+        if (progress) {
+            progress(begin + batch.size(), changed.size());
+        }
+    }
+
+    QByteArray fileTable;
+    for (const FileEntry &entry : std::as_const(table)) {
+        const QByteArray path = entry.path.toUtf8();
+        appendRaw(fileTable, quint64(entry.size));
+        appendRaw(fileTable, entry.modified);
+        appendRaw(fileTable, entry.flags);
+        appendRaw(fileTable, quint32(path.size()));
+        fileTable.append(path);
+    }
+    fileTable.append(QByteArray(qsizetype((8 - (sizeof(Header) + fileTable.size()) % 8) % 8), '\0')); // the trigram table is mapped as an array of 8 byte aligned entries
+
+    std::vector<quint32> keys;
+    keys.reserve(lists.size());
+    for (const auto &list : lists) {
+        keys.push_back(list.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    QByteArray trigramTable;
+    trigramTable.reserve(qsizetype(keys.size() * sizeof(TrigramEntry)));
+    quint64 offset = 0;
+    for (quint32 key : keys) {
+        const PostingList &list = lists.at(key);
+        appendRaw(trigramTable, TrigramEntry{key, list.count, offset});
+        offset += quint64(list.bytes.size());
+    }
+
+    Header header = {indexMagic, indexVersion, quint32(table.size()), quint32(keys.size()), sizeof(Header), 0, 0, offset};
+    header.trigramsOffset = sizeof(Header) + quint64(fileTable.size());
+    header.postingsOffset = header.trigramsOffset + quint64(trigramTable.size());
+
+    QFile out(target);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        throw std::runtime_error("Kann nicht schreiben: " + out.errorString().toStdString());
+    }
+    bool written = out.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header)) && out.write(fileTable) == fileTable.size() && out.write(trigramTable) == trigramTable.size();
+    for (auto key = keys.cbegin(); key != keys.cend() && written; ++key) {
+        const QByteArray &bytes = lists.at(*key).bytes;
+        written = out.write(bytes) == bytes.size();
+    }
+    if (!written || !out.flush()) {
+        const std::string error = out.errorString().toStdString();
+        out.remove();
+        throw std::runtime_error("Kann nicht schreiben: " + error);
+    }
+    return true;
+}
+
+QVector<TrigramIndex::FileEntry> TrigramIndex::crawl(const QString &root, const std::atomic<bool> *canceled) { // the folder is listed level by level, the directories of a level in parallel
+    struct Listing {
+        QVector<FileEntry> files;
+        QStringList directories;
+    };
+    QVector<FileEntry> found;
+    QStringList level = {QString()};
+    while (!level.isEmpty() && !(canceled && *canceled)) {
+        const QList<Listing> listed = QtConcurrent::blockingMapped<QList<Listing>>(level, [&root](const QString &directory) {
+            Listing listing;
+            const QDir dir(directory.isEmpty() ? root : root + QLatin1Char('/') + directory);
+            const QFileInfoList entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks); // hidden ones like .git are left out, links could lead in circles
+            for (const QFileInfo &info : entries) {
+                const QString path = directory.isEmpty() ? info.fileName() : directory + QLatin1Char('/') + info.fileName();
+                if (info.isDir()) {
+                    listing.directories.append(path);
+                } else {
+                    listing.files.append({path, info.size(), info.lastModified().toMSecsSinceEpoch(), 0});
+                }
+            }
+            return listing;
+        });
+        level.clear();
+        for (const Listing &listing : listed) {
+            found += listing.files;
+            level += listing.directories;
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const FileEntry &a, const FileEntry &b) {
+        return a.path < b.path;
+    });
+    return found;
+}
+
+QVector<quint32> TrigramIndex::postings(quint32 key) const { // binary search in the mapped table
+    const TrigramEntry *end = trigrams + trigramCount;
+    const TrigramEntry *entry = std::lower_bound(trigrams, end, key, [](const TrigramEntry &candidate, quint32 wanted) {
+        return candidate.key < wanted;
+    });
+    if (entry == end || entry->key != key) {
+        return {};
+    }
+    return decode(*entry);
+}
+
+QVector<quint32> TrigramIndex::decode(const TrigramEntry &entry) const { // a broken list ends early instead of reading outside the mapping
+    QVector<quint32> ids;
+    if (entry.offset >= quint64(postingSize)) {
+        return ids;
+    }
+    ids.reserve(entry.count);
+    const uchar *byte = postingData + entry.offset;
+    const uchar *end = postingData + postingSize;
+    quint32 id = 0;
+    for (quint32 i = 0; i < entry.count && byte < end; ++i) {
+        quint32 delta = 0;
+        for (int shift = 0; byte < end && shift < 35; shift += 7) {
+            delta |= quint32(*byte & 0x7F) << shift;
+            if (!(*byte++ & 0x80)) {
+                break;
+            }
+        }
+        id += delta;
+        if (id >= quint32(files.size())) {
+            break;
+        }
+        ids.append(id);
+    }
+    return ids;
+}
+
+QVector<FolderHit> TrigramIndex::search(const QString &term, bool caseSensitive, const std::atomic<bool> *canceled) const { // intersects the posting lists, then reads the remaining files in parallel
+    QVector<FolderHit> hits;
+    const QByteArray pattern = term.toUtf8();
+    if (pattern.isEmpty() || !isOpen()) {
+        return hits;
+    }
+
+    QVector<quint32> keys;
+    quint32 key = 0;
+    int run = 0;
+    for (char c : pattern) {
+        if (c == '\n' || c == '\r' || (!caseSensitive && uchar(c) >= 0x80)) { // other cases of non-ascii letters have other bytes, trigrams with them could miss a match
+            run = 0;
+            continue;
+        }
+        key = ((key << 8) | fold(uchar(c))) & 0xFFFFFF;
+        if (++run >= 3) {
+            keys.append(key);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    QVector<quint32> candidates;
+    if (keys.isEmpty()) { // too short for a trigram, every indexed file is read
+        for (quint32 id = 0; id < quint32(files.size()); ++id) {
+            if (!(files.at(id).flags & skippedFile)) {
+                candidates.append(id);
+            }
+        }
+    } else {
+        QVector<QVector<quint32>> lists;
+        for (quint32 wanted : std::as_const(keys)) {
+            lists.append(postings(wanted));
+            if (lists.last().isEmpty()) {
+                return hits;
+            }
+        }
+        std::sort(lists.begin(), lists.end(), [](const QVector<quint32> &a, const QVector<quint32> &b) { // the shortest first, the intersection only gets shorter
+            return a.size() < b.size();
+        });
+        candidates = lists.first();
+        for (qsizetype i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+            QVector<quint32> both;
+            std::set_intersection(candidates.cbegin(), candidates.cend(), lists.at(i).cbegin(), lists.at(i).cend(), std::back_inserter(both));
+            candidates.swap(both);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](quint32 a, quint32 b) { // hits come sorted by path, not in the order the files were indexed
+        return files.at(a).path < files.at(b).path;
+    });
+
+    std::atomic<int> total(0); // files are not read anymore once there are enough hits
+    const QList<QVector<FolderHit>> found = QtConcurrent::blockingMapped<QList<QVector<FolderHit>>>(candidates, [this, &pattern, caseSensitive, canceled, &total](quint32 id) {
+        if (total >= maxHits) {
+            return QVector<FolderHit>();
+        }
+        QVector<FolderHit> fileHits = searchFile(id, pattern, caseSensitive, canceled);
+        total += int(fileHits.size());
+        return fileHits;
+    });
+    for (const QVector<FolderHit> &fileHits : found) {
+        for (qsizetype i = 0; i < fileHits.size() && hits.size() < maxHits; ++i) {
+            hits.append(fileHits.at(i));
+        }
+    }
+    return hits;
+}
+
+QVector<FolderHit> TrigramIndex::searchFile(quint32 id, const QByteArray &pattern, bool caseSensitive, const std::atomic<bool> *canceled) const { // the file is mapped and searched as bytes, the index only said it might contain the term
+    QVector<FolderHit> hits;
+    if (canceled && *canceled) {
+        return hits;
+    }
+    const QString fileName = rootPath + QLatin1Char('/') + files.at(id).path;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < pattern.size() || file.size() > maxFileSize) {
+        return hits;
+    }
+    const uchar *bytes = file.map(0, file.size());
+    if (!bytes) {
+        return hits;
+    }
+    const char *begin = reinterpret_cast<const char *>(bytes);
+    const char *end = begin + file.size();
+    if (caseSensitive) {
+        collectHits(begin, end, std::boyer_moore_horspool_searcher(pattern.cbegin(), pattern.cend()), fileName, hits);
+    } else {
+        collectHits(begin, end, std::boyer_moore_horspool_searcher(pattern.cbegin(), pattern.cend(), FoldedHash(), FoldedEqual()), fileName, hits);
+    }
+    file.unmap(const_cast<uchar *>(bytes));
+    return hits;
+}
@@ -0,0 +1,74 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <atomic>
+#include <functional>
+
+struct FolderHit {
+    QString fileName; // absolute path
+    qint64 line = 0; // 1-based
+    QString text; // the matching line, cut to TrigramIndex::maxLineLength characters
+};
+
+// index of the byte trigrams of every text file below a folder, a search only reads the files that contain all trigrams of
+// the term. on disk: a header, the file table (path, size, modification time), the trigram table sorted by trigram and the
+// posting lists of file numbers as varint deltas. the index file is mapped, not read. trigrams are taken from the utf-8 or
+// ascii bytes with ascii letters folded to lower case, so other encodings are only found by their ascii parts
+class TrigramIndex {
+    public:
+        TrigramIndex();
+        ~TrigramIndex();
+        TrigramIndex(const TrigramIndex &) = delete;
+        TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+        static constexpr qint64 maxFileSize = 16 * 1024 * 1024; // bigger files are data or logs, they are listed but not indexed
+        static constexpr int batchSize = 512; // files read on the thread pool before their trigrams are merged into the lists
+        static constexpr int maxHitsPerFile = 100;
+        static constexpr int maxHits = 10000;
+        static constexpr int maxLineLength = 200;
+
+        using Progress = std::function<void(qint64 done, qint64 total)>;
+
+        static QString indexFileName(const QString &root);
+        static bool build(const QString &root, const TrigramIndex *previous, const QString &target, const std::atomic<bool> *canceled = nullptr, const Progress &progress = Progress());
+
+        void open(const QString &root, const QString &indexFile);
+        bool isOpen() const;
+        QString root() const;
+        qsizetype fileCount() const;
+        QVector<FolderHit> search(const QString &term, bool caseSensitive, const std::atomic<bool> *canceled = nullptr) const;
+
+    private:
+        struct FileEntry {
+            QString path; // relative to the root, with / as separator
+            qint64 size;
+            qint64 modified; // milliseconds since the epoch
+            quint32 flags;
+        };
+
+        struct TrigramEntry { // layout of the trigram table in the file
+            quint32 key;
+            quint32 count;
+            quint64 offset; // of the posting list, relative to the posting section
+        };
+
+        static QVector<FileEntry> crawl(const QString &root, const std::atomic<bool> *canceled);
+        void close();
+        QVector<quint32> postings(quint32 key) const;
+        QVector<quint32> decode(const TrigramEntry &entry) const;
+        QVector<FolderHit> searchFile(quint32 id, const QByteArray &pattern, bool caseSensitive, const std::atomic<bool> *canceled) const;
+
+        QFile file;
+        const uchar *data;
+        QString rootPath;
+        QVector<FileEntry> files;
+        const TrigramEntry *trigrams;
+        quint32 trigramCount;
+        const uchar *postingData;
+        qint64 postingSize;
+};
+
+#endif // TRIGRAMINDEX_H
@@ -0,0 +1,258 @@
+#include "undoengine.h"
+#include "profiler.h"
+#include <QTextCursor>
+
+namespace {
+constexpr qint64 groupInterval = 1000; // keystrokes within this many ms are merged into one undo step
+constexpr int maxTypedLength = 32; // longer insertions (e.g. input methods) are never merged
+}
+
+UndoEngine::UndoEngine(QTextDocument *document, ChangeTracker *tracker, QObject *parent): QObject(parent), document(document), tracker(tracker), current(tracker->table()), limit(defaultMemoryLimit), usage(0), transactionDepth(0), recording(true), applying(false), grouping(false) { // constructor
+    document->setUndoRedoEnabled(false); // the built-in undo stack of qt would keep a second copy of every change
+    connect(tracker, &ChangeTracker::textEdited, this, &UndoEngine::textEdited); // every real edit is recorded
+}
+
+void UndoEngine::setMemoryLimit(qint64 bytes) { // byte cap for the whole history, the oldest steps are dropped first
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    limit = qMax<qint64>(0, bytes);
+    enforceLimit();
+    notify(couldUndo, couldRedo);
+}
+
+qint64 UndoEngine::memoryLimit() const {
+    return limit;
+}
+
+qint64 UndoEngine::memoryUsage() const {
+    return usage;
+}
+
+bool UndoEngine::canUndo() const {
+    return !undoSteps.empty();
+}
+
+bool UndoEngine::canRedo() const {
+    return !redoSteps.empty();
+}
+
+void UndoEngine::setRecording(bool value) { // edits are ignored while recording is off, e.g. while a file is loaded
+    recording = value;
+    grouping = false;
+}
+
+void UndoEngine::beginTransaction() { // all edits until the matching endTransaction become one undo step
+    if (transactionDepth++ == 0) {
+        grouping = false;
+    }
+}
+
+void UndoEngine::endTransaction() {
+    if (transactionDepth > 0 && --transactionDepth == 0) {
+        bool couldUndo = canUndo();
+        bool couldRedo = canRedo();
+        grouping = false; // the next keystroke starts a new step
+        enforceLimit(); // the limit is only checked once the transaction is complete
+        notify(couldUndo, couldRedo);
+    }
+}
+
+void UndoEngine::breakGroup() { // the next edit starts a new step even if it continues the previous typing
+    grouping = false;
+}
+
+int UndoEngine::undo() { // reverts the latest step, returns the cursor position after it or -1
+    if (undoSteps.empty()) {
+        return -1;
+    }
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    UndoStep step = std::move(undoSteps.back());
+    undoSteps.pop_back();
+
+    applying = true; // our own changes must not be recorded again
+    for (int i = step.edits.size() - 1; i >= 0; --i) { // edits are reverted in reverse order
+        const UndoEdit &edit = step.edits.at(i);
+        replace(edit.position, edit.insertedLength, removedText(edit)); // a snapshot is read one edit at a time
+    }
+    applying = false;
+
+    int position = step.edits.first().position + step.edits.first().removedLength;
+    redoSteps.push_back(std::move(step));
+    grouping = false;
+    notify(couldUndo, couldRedo);
+    return position;
+}
+
+int UndoEngine::redo() { // applies the latest undone step again, returns the cursor position after it or -1
+    if (redoSteps.empty()) {
+        return -1;
+    }
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    UndoStep step = std::move(redoSteps.back());
+    redoSteps.pop_back();
+
+    applying = true;
+    for (const UndoEdit &edit : step.edits) {
+        replace(edit.position, edit.removedLength, insertedText(edit));
+    }
+    applying = false;
+
+    int position = step.edits.last().position + step.edits.last().insertedLength;
+    undoSteps.push_back(std::move(step));
+    grouping = false;
+    notify(couldUndo, couldRedo);
+    return position;
+}
+
+void UndoEngine::clear() { // forgets the whole history, e.g. after opening a file
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+    undoSteps.clear();
+    redoSteps.clear();
+    usage = 0;
+    grouping = false;
+    notify(couldUndo, couldRedo);
+}
+
+void UndoEngine::textEdited(int position, const QString &removed, const QString &inserted) {
+    const PieceTable before = current; // o(1), taken for every edit so the snapshot before the next one is at hand
+    current = tracker->table();
+    if (applying || !recording) {
+        return;
+    }
+    ScopedTimer timer("undoPush");
+    bool couldUndo = canUndo();
+    bool couldRedo = canRedo();
+
+    for (const UndoStep &step : redoSteps) { // a new edit makes the undone steps unreachable
+        usage -= step.bytes;
+    }
+    redoSteps.clear();
+
+    bool merged = grouping && lastEdit.isValid() && lastEdit.elapsed() < groupInterval && mergeIntoLast(position, removed, inserted);
+    if (!merged) {
+        UndoEdit edit;
+        edit.position = position;
+        edit.removedLength = int(removed.size());
+        edit.insertedLength = int(inserted.size());
+        if (removed.size() > snapshotLength) { // e.g. every 64k chunk of a chunked cut, only the snapshot is kept
+            edit.before = before;
+        } else {
+            edit.removed = removed;
+        }
+        if (inserted.size() > snapshotLength) {
+            edit.after = current;
+        } else {
+            edit.inserted = inserted;
+        }
+        const qint64 bytes = editBytes(edit);
+        if (transactionDepth > 0 && grouping && !undoSteps.empty()) { // further edits of a running transaction go into its step
+            undoSteps.back().edits.append(std::move(edit));
+            undoSteps.back().bytes += bytes;
+        } else {
+            UndoStep step;
+            step.edits.append(std::move(edit));
+            step.bytes = bytes;
+            undoSteps.push_back(std::move(step));
+        }
+        usage += bytes;
+    }
+    grouping = true;
+    lastEdit.start();
+
+    if (transactionDepth == 0) {
+        enforceLimit();
+    }
+    notify(couldUndo, couldRedo);
+}
+
+bool UndoEngine::mergeIntoLast(int position, const QString &removed, const QString &inserted) { // groups consecutive typing and deleting
+    if (transactionDepth > 0) { // inside a transaction everything is appended anyway
+        return false;
+    }
+    if (undoSteps.empty() || undoSteps.back().edits.size() != 1) {
+        return false;
+    }
+    UndoStep &step = undoSteps.back();
+    UndoEdit &last = step.edits.last();
+    if (last.removedLength != last.removed.size() || last.insertedLength != last.inserted.size()) { // a snapshot edit is never extended
+        return false;
+    }
+
+    if (removed.isEmpty() && !inserted.isEmpty() && inserted.length() <= maxTypedLength && !inserted.contains(QLatin1Char('\n'))) {
+        if (position != last.position + last.inserted.length()) { // typing continues right behind the previous insertion
+            return false;
+        }
+        last.inserted += inserted;
+    } else if (inserted.isEmpty() && !removed.isEmpty() && removed.length() <= maxTypedLength && last.inserted.isEmpty()) {
+        if (position + removed.length() == last.position) { // backspace
+            last.position = position;
+            last.removed.prepend(removed);
+        } else if (position == last.position) { // delete key
+            last.removed += removed;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    last.removedLength = int(last.removed.size());
+    last.insertedLength = int(last.inserted.size());
+
+    qint64 bytes = (removed.size() + inserted.size()) * qint64(sizeof(QChar));
+    step.bytes += bytes;
+    usage += bytes;
+    return true;
+}
+
+void UndoEngine::replace(int position, int length, const QString &text) { // replaces a range of the document without touching the rest
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    if (text.isEmpty()) {
+        cursor.removeSelectedText();
+    } else {
+        cursor.insertText(text);
+    }
+}
+
+void UndoEngine::enforceLimit() { // drops the oldest steps until the history fits into the byte cap again
+    while (usage > limit && undoSteps.size() > 1) { // the latest step is kept even if it alone is over the cap, e.g. a replace-all
+        usage -= undoSteps.front().bytes;
+        undoSteps.pop_front();
+    }
+    while (usage > limit && !redoSteps.empty()) { // the front of the redo history is the step farthest away
+        usage -= redoSteps.front().bytes;
+        redoSteps.pop_front();
+    }
+    if (limit == 0 && !undoSteps.empty()) { // a limit of zero turns the history off completely
+        usage -= undoSteps.front().bytes;
+        undoSteps.pop_front();
+    }
+    if (undoSteps.empty()) {
+        grouping = false;
+    }
+}
+
+void UndoEngine::notify(bool couldUndo, bool couldRedo) {
+    if (couldUndo != canUndo()) {
+        emit canUndoChanged(canUndo());
+    }
+    if (couldRedo != canRedo()) {
+        emit canRedoChanged(canRedo());
+    }
+}
+
+qint64 UndoEngine::editBytes(const UndoEdit &edit) { // rough memory footprint of one edit, snapshots share their text with the document
+    return (edit.removed.size() + edit.inserted.size()) * qint64(sizeof(QChar)) + qint64(sizeof(UndoEdit));
+}
+
+QString UndoEngine::removedText(const UndoEdit &edit) {
+    return edit.removedLength > edit.removed.size() ? edit.before.mid(edit.position, edit.removedLength) : edit.removed;
+}
+
+QString UndoEngine::insertedText(const UndoEdit &edit) {
+    return edit.insertedLength > edit.inserted.size() ? edit.after.mid(edit.position, edit.insertedLength) : edit.inserted;
+}
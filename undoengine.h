@@ -0,0 +1,81 @@
+#ifndef UNDOENGINE_H
+#define UNDOENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QTextDocument>
+#include <deque>
+#include "changetracker.h"
+
+struct UndoEdit { // long texts are not copied, they are read back from snapshots that share their pieces with the document
+    int position = 0;
+    int removedLength = 0;
+    int insertedLength = 0;
+    QString removed; // empty if the text is in before
+    QString inserted; // empty if the text is in after
+    PieceTable before; // the whole text before the edit, the removed range starts at position
+    PieceTable after; // the whole text after the edit, the inserted range starts at position
+};
+
+struct UndoStep {
+    QVector<UndoEdit> edits;
+    qint64 bytes = 0;
+};
+
+// undo/redo history that only stores the changed ranges, a range longer than snapshotLength is kept as an o(1)
+// piece table snapshot plus offset and length, so cutting or pasting a gigabyte doesn't copy it into the history
+class UndoEngine : public QObject {
+    Q_OBJECT
+
+    public:
+        explicit UndoEngine(QTextDocument *document, ChangeTracker *tracker, QObject *parent = nullptr);
+
+        static constexpr qint64 defaultMemoryLimit = 64 * 1024 * 1024;
+        static constexpr int snapshotLength = 4096; // longer removed or inserted texts are kept as snapshots
+
+        void setMemoryLimit(qint64 bytes);
+        qint64 memoryLimit() const;
+        qint64 memoryUsage() const;
+        bool canUndo() const;
+        bool canRedo() const;
+        void setRecording(bool value);
+        void beginTransaction();
+        void endTransaction();
+        void breakGroup();
+        int undo();
+        int redo();
+        void clear();
+
+    signals:
+        void canUndoChanged(bool available);
+        void canRedoChanged(bool available);
+
+    private slots:
+        void textEdited(int position, const QString &removed, const QString &inserted);
+
+    private:
+        bool mergeIntoLast(int position, const QString &removed, const QString &inserted);
+        void replace(int position, int length, const QString &text);
+        void enforceLimit();
+        void notify(bool couldUndo, bool couldRedo);
+        static qint64 editBytes(const UndoEdit &edit);
+        static QString removedText(const UndoEdit &edit);
+        static QString insertedText(const UndoEdit &edit);
+
+        QTextDocument *document;
+        ChangeTracker *tracker;
+        PieceTable current; // the text after the latest edit, the snapshot before the next one
+        std::deque<UndoStep> undoSteps;
+        std::deque<UndoStep> redoSteps;
+        qint64 limit;
+        qint64 usage;
+        int transactionDepth;
+        bool recording;
+        bool applying;
+        bool grouping;
+        QElapsedTimer lastEdit;
+};
+
+#endif // UNDOENGINE_H